@@ -71,6 +71,12 @@ namespace dd
     return vout();
   }
 
+  vout visitor_vad::operator()(const std::vector<float> &vf)
+  {
+    (void)vf;
+    return vout();
+  }
+
   vout visitor_vad::operator()(const std::vector<int> &vd)
   {
     (void)vd;
@@ -106,7 +112,26 @@ namespace dd
     return vout(vad);
   }
 
+  /*- visitor_obj -*/
+  const APIData *visitor_obj::operator()(const APIData &ad)
+  {
+    return &ad;
+  }
+
+  const APIData *visitor_obj::operator()(const std::vector<APIData> &vad)
+  {
+    if (vad.empty())
+      return nullptr;
+    return &vad.at(0);
+  }
+
   /*- APIData -*/
+  const APIData &APIData::empty_obj()
+  {
+    static const APIData empty;
+    return empty;
+  }
+
   void APIData::fromRapidJson(const JVal &jval)
   {
     for (rapidjson::Value::ConstMemberIterator cit = jval.MemberBegin();
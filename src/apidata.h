@@ -48,8 +48,8 @@ namespace dd
   // utils/recursive_wrapper.hpp
   typedef mapbox::util::variant<
       std::string, double, int, long int, long long int, bool,
-      std::vector<std::string>, std::vector<double>, std::vector<int>,
-      std::vector<bool>, std::vector<cv::Mat>,
+      std::vector<std::string>, std::vector<double>, std::vector<float>,
+      std::vector<int>, std::vector<bool>, std::vector<cv::Mat>,
       std::vector<std::pair<int, int>>,
       mapbox::util::recursive_wrapper<APIData>,
       mapbox::util::recursive_wrapper<std::vector<APIData>>>
@@ -116,6 +116,7 @@ namespace dd
     vout operator()(const long long int &i);
     vout operator()(const bool &b);
     vout operator()(const std::vector<double> &vd);
+    vout operator()(const std::vector<float> &vf);
     vout operator()(const std::vector<int> &vd);
     vout operator()(const std::vector<bool> &vd);
     vout operator()(const std::vector<std::string> &vs);
@@ -131,6 +132,26 @@ namespace dd
         }*/
   };
 
+  /**
+   * \brief visitor class for access to a variant data object, without copy
+   */
+  class visitor_obj
+  {
+  public:
+    visitor_obj()
+    {
+    }
+    ~visitor_obj(){};
+
+    template <typename T> const APIData *operator()(const T &t)
+    {
+      (void)t;
+      return nullptr;
+    }
+    const APIData *operator()(const APIData &ad);
+    const APIData *operator()(const std::vector<APIData> &vad);
+  };
+
   /**
    * \brief main deepdetect API data object, uses recursive variant types
    */
@@ -150,6 +171,20 @@ namespace dd
       _data.insert(std::pair<std::string, ad_variant_type>(key, val));
     }
 
+    /**
+     * \brief add key / object to data object, moving the value in
+     * @param key string unique key
+     * @param val variant value
+     */
+    inline void add(const std::string &key, ad_variant_type &&val)
+    {
+      auto hit = _data.find(key);
+      if (hit != _data.end())
+        (*hit).second = std::move(val);
+      else
+        _data.emplace(key, std::move(val));
+    }
+
     /**
      * \brief erase key / object from data object
      * @param key string unique key
@@ -166,15 +201,15 @@ namespace dd
      *        at this stage, type of value is unknown and the typed object
      *        must be later acquired with e.g. 'get<std::string>(val)
      * @param key string unique key
-     * @return variant value
+     * @return variant value, valid as long as this object and key are
      */
-    inline ad_variant_type get(const std::string &key) const
+    inline const ad_variant_type &get(const std::string &key) const
     {
       std::unordered_map<std::string, ad_variant_type>::const_iterator hit;
       if ((hit = _data.find(key)) != _data.end())
         return (*hit).second;
-      else
-        return std::string(); // beware
+      static const ad_variant_type empty = std::string(); // beware
+      return empty;
     }
 
     /**
@@ -192,15 +227,26 @@ namespace dd
     /**
      * \brief get data object value as variant value
      * @param key string unique value
-     * @return APIData as recursive variant value object
+     * @return APIData as recursive variant value object, valid as long as
+     *         this object and key are
      */
-    inline APIData getobj(const std::string &key) const
+    inline const APIData &getobj(const std::string &key) const
     {
-      visitor_vad vv;
-      vout v = mapbox::util::apply_visitor(vv, get(key));
-      if (v._vad.empty())
-        return APIData();
-      return v._vad.at(0);
+      const APIData *ad = getobj_ptr(key);
+      if (!ad)
+        return empty_obj();
+      return *ad;
+    }
+
+    /**
+     * \brief get data object value, without copy
+     * @param key string unique value
+     * @return pointer to APIData, nullptr if there is no such object
+     */
+    inline const APIData *getobj_ptr(const std::string &key) const
+    {
+      visitor_obj vo;
+      return mapbox::util::apply_visitor(vo, get(key));
     }
 
     /**
@@ -234,6 +280,11 @@ namespace dd
         return false;
     }
 
+    /**
+     * \brief shared empty object, for missing keys
+     */
+    static const APIData &empty_obj();
+
     std::vector<std::string> list_keys() const
     {
       std::vector<std::string> keys;
@@ -273,6 +324,13 @@ namespace dd
      */
     void toJVal(JDoc &jd, JVal &jv) const;
 
+    /**
+     * \brief writes APIData as a JSON object to a rapidjson writer, without
+     *        building an intermediate JSON document
+     * @param writer destination rapidjson writer
+     */
+    template <typename TWriter> void toJWriter(TWriter &writer) const;
+
     /**
      * \brief converts APIData to oat++ DTO
      */
@@ -434,6 +492,19 @@ namespace dd
       else
         _jv->AddMember(_jvkey, jarr, _jd->GetAllocator());
     }
+    void operator()(const std::vector<float> &vf)
+    {
+      JVal jarr(rapidjson::kArrayType);
+      for (size_t i = 0; i < vf.size(); i++)
+        {
+          jarr.PushBack(JVal(static_cast<double>(vf.at(i))),
+                        _jd->GetAllocator());
+        }
+      if (!_jv)
+        _jd->AddMember(_jvkey, jarr, _jd->GetAllocator());
+      else
+        _jv->AddMember(_jvkey, jarr, _jd->GetAllocator());
+    }
     void operator()(const std::vector<int> &vd)
     {
       JVal jarr(rapidjson::kArrayType);
@@ -521,6 +592,129 @@ namespace dd
     JVal *_jv = nullptr;
   };
 
+  /**
+   * \brief visitor class for writing variant values to a rapidjson writer,
+   *        renders values the same way as visitor_rjson
+   */
+  template <typename TWriter> class visitor_rwriter
+  {
+  public:
+    visitor_rwriter(TWriter &writer) : _writer(writer)
+    {
+    }
+    ~visitor_rwriter()
+    {
+    }
+
+    /**
+     * \brief whether a variant value is rendered to JSON
+     */
+    static bool writable(const ad_variant_type &val)
+    {
+      return !val.is<std::vector<cv::Mat>>()
+             && !val.is<std::vector<std::pair<int, int>>>();
+    }
+
+    void operator()(const std::string &str)
+    {
+      _writer.String(str.c_str(), str.size());
+    }
+    void operator()(const int &i)
+    {
+      _writer.Int(i);
+    }
+    void operator()(const long int &i)
+    {
+      _writer.Uint64(static_cast<uint64_t>(i));
+    }
+    void operator()(const long long int &i)
+    {
+      _writer.Uint64(static_cast<uint64_t>(i));
+    }
+    void operator()(const double &d)
+    {
+      _writer.Double(d);
+    }
+    void operator()(const bool &b)
+    {
+      _writer.Bool(b);
+    }
+    void operator()(const APIData &ad)
+    {
+      ad.toJWriter(_writer);
+    }
+    void operator()(const std::vector<double> &vd)
+    {
+      _writer.StartArray();
+      for (double d : vd)
+        _writer.Double(d);
+      _writer.EndArray();
+    }
+    void operator()(const std::vector<float> &vf)
+    {
+      _writer.StartArray();
+      for (float f : vf)
+        _writer.Double(f);
+      _writer.EndArray();
+    }
+    void operator()(const std::vector<int> &vd)
+    {
+      _writer.StartArray();
+      for (int i : vd)
+        _writer.Int(i);
+      _writer.EndArray();
+    }
+    void operator()(const std::vector<bool> &vd)
+    {
+      _writer.StartArray();
+      for (bool b : vd)
+        _writer.Bool(b);
+      _writer.EndArray();
+    }
+    void operator()(const std::vector<std::string> &vs)
+    {
+      _writer.StartArray();
+      for (const std::string &str : vs)
+        _writer.String(str.c_str(), str.size());
+      _writer.EndArray();
+    }
+    void operator()(const std::vector<cv::Mat> &vcv)
+    {
+      (void)vcv; // not rendered, see writable()
+    }
+    void operator()(const std::vector<std::pair<int, int>> &vpi)
+    {
+      (void)vpi; // not rendered, see writable()
+    }
+    void operator()(const std::vector<APIData> &vad)
+    {
+      _writer.StartArray();
+      for (const APIData &ad : vad)
+        ad.toJWriter(_writer);
+      _writer.EndArray();
+    }
+
+    TWriter &_writer;
+  };
+
+  template <typename TWriter>
+  void APIData::toJWriter(TWriter &writer) const
+  {
+    visitor_rwriter<TWriter> vrw(writer);
+    writer.StartObject();
+    auto hit = _data.begin();
+    while (hit != _data.end())
+      {
+        if (visitor_rwriter<TWriter>::writable((*hit).second))
+          {
+            writer.Key((*hit).first.c_str(), (*hit).first.size());
+            mapbox::util::apply_visitor(vrw, (*hit).second);
+          }
+        ++hit;
+      }
+    writer.EndObject();
+  }
+
 }
 
 #endif
@@ -3604,6 +3604,7 @@ namespace dd
     out.add("bbox", bbox);
     out.add("roi", rois);
     out.add("multibox_rois", multibox_rois);
+    this->_stats.output_start();
     if (!inputc._segmentation)
       tout.finalize(ad.getobj("parameters").getobj("output"), out,
                     static_cast<MLModel *>(&this->_mlmodel));
@@ -3615,6 +3616,7 @@ namespace dd
         unsupo.finalize(ad.getobj("parameters").getobj("output"), out,
                         static_cast<MLModel *>(&this->_mlmodel));
       }
+    this->_stats.output_end();
     if (ad.has("chain") && ad.get("chain").get<bool>())
       {
         if (typeid(inputc) == typeid(ImgCaffeInputFileConn))
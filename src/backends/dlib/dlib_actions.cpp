@@ -148,7 +148,7 @@ namespace dd
     APIData action_out;
     action_out.add("data_raw_img", cropped_imgs);
     action_out.add("cids", bbox_ids);
-    cdata.add_action_data(_action_id, action_out);
+    cdata.add_action_data(_action_id, std::move(action_out));
 
     // updated model data with chain ids
     model_out.add("predictions", cvad);
@@ -33,17 +33,6 @@
 
 namespace dd
 {
-  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
-            class TMLModel>
-  ncnn::UnlockedPoolAllocator
-      NCNNLib<TInputConnectorStrategy, TOutputConnectorStrategy,
-              TMLModel>::_blob_pool_allocator;
-  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
-            class TMLModel>
-  ncnn::PoolAllocator
-      NCNNLib<TInputConnectorStrategy, TOutputConnectorStrategy,
-              TMLModel>::_workspace_pool_allocator;
-
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
             class TMLModel>
   NCNNLib<TInputConnectorStrategy, TOutputConnectorStrategy,
@@ -54,8 +43,6 @@ namespace dd
     this->_libname = "ncnn";
     _net = new ncnn::Net();
     _net->opt.num_threads = _threads;
-    _net->opt.blob_allocator = &_blob_pool_allocator;
-    _net->opt.workspace_allocator = &_workspace_pool_allocator;
     _net->opt.lightmode = _lightmode;
   }
 
@@ -71,6 +58,9 @@ namespace dd
     tl._net = nullptr;
     _nclasses = tl._nclasses;
     _threads = tl._threads;
+    _workers = std::move(tl._workers);
+    _blob_pool_allocators = std::move(tl._blob_pool_allocators);
+    _workspace_pool_allocators = std::move(tl._workspace_pool_allocators);
     _timeserie = tl._timeserie;
     _old_height = tl._old_height;
     _inputBlob = tl._inputBlob;
@@ -153,8 +143,20 @@ namespace dd
         _outputBlob = ad.get("outputblob").get<std::string>();
       }
 
-    _blob_pool_allocator.set_size_compare_ratio(0.0f);
-    _workspace_pool_allocator.set_size_compare_ratio(0.5f);
+    // one worker and one pair of pool allocators per thread, allocators are
+    // per service and are never shared in between concurrent extractors
+    _threads = std::max(1, _threads);
+    _net->opt.num_threads = _threads;
+    _blob_pool_allocators.clear();
+    _workspace_pool_allocators.clear();
+    for (int w = 0; w < _threads; w++)
+      {
+        _blob_pool_allocators.emplace_back(new ncnn::UnlockedPoolAllocator());
+        _blob_pool_allocators.back()->set_size_compare_ratio(0.0f);
+        _workspace_pool_allocators.emplace_back(new ncnn::PoolAllocator());
+        _workspace_pool_allocators.back()->set_size_compare_ratio(0.5f);
+      }
+    _workers.reset(new WorkerPool(_threads));
     model_type(this->_mlmodel._params, this->_mltype);
   }
 
@@ -166,6 +168,18 @@ namespace dd
     (void)ad;
   }
 
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
+            class TMLModel>
+  void NCNNLib<TInputConnectorStrategy, TOutputConnectorStrategy,
+               TMLModel>::schedule_threads(const int &nsamples, int &nworkers,
+                                           int &intra_threads) const
+  {
+    // samples first, as inter-sample parallelism scales better than
+    // parallelism within layers, then remaining threads go to each sample
+    nworkers = std::max(1, std::min(nsamples, _threads));
+    intra_threads = std::max(1, _threads / nworkers);
+  }
+
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
             class TMLModel>
   int NCNNLib<TInputConnectorStrategy, TOutputConnectorStrategy,
@@ -232,7 +246,6 @@ namespace dd
       }
 
     // Extract detection or classification
-    int ret = 0;
     std::string out_blob = _outputBlob;
     if (out_blob.empty())
       {
@@ -265,163 +278,186 @@ namespace dd
     if (best == -1 || best > _nclasses)
       best = _nclasses;
 
-      // for loop around batch size
-#pragma omp parallel for num_threads(_threads)
-    for (size_t b = 0; b < inputc._ids.size(); b++)
-      {
-        std::vector<double> probs;
-        std::vector<std::string> cats;
-        std::vector<APIData> bboxes;
-        std::vector<APIData> series;
-        APIData rad;
-
-        ncnn::Extractor ex = _net->create_extractor();
-        ex.set_num_threads(_threads);
-        ex.input(_inputBlob.c_str(), inputc._in.at(b));
-
-        ret = ex.extract(out_blob.c_str(), inputc._out.at(b));
-        if (ret == -1)
-          {
-            throw MLLibInternalException("NCNN internal error");
-          }
-
-        if (bbox == true)
-          {
-            std::string uri = inputc._ids.at(b);
-            auto bit = inputc._imgs_size.find(uri);
-            int rows = 1;
-            int cols = 1;
-            if (bit != inputc._imgs_size.end())
-              {
-                // original image size
-                rows = (*bit).second.first;
-                cols = (*bit).second.second;
-              }
-            else
-              {
-                throw MLLibInternalException(
-                    "Couldn't find original image size for " + uri);
-              }
-            for (int i = 0; i < inputc._out.at(b).h; i++)
-              {
-                const float *values = inputc._out.at(b).row(i);
-                if (values[1] < confidence_threshold)
-                  break; // output is sorted by confidence
-
-                cats.push_back(this->_mlmodel.get_hcorresp(values[0]));
-                probs.push_back(values[1]);
-
-                APIData ad_bbox;
-                ad_bbox.add("xmin",
-                            static_cast<double>(values[2] * (cols - 1)));
-                ad_bbox.add("ymin",
-                            static_cast<double>(values[3] * (rows - 1)));
-                ad_bbox.add("xmax",
-                            static_cast<double>(values[4] * (cols - 1)));
-                ad_bbox.add("ymax",
-                            static_cast<double>(values[5] * (rows - 1)));
-                bboxes.push_back(ad_bbox);
-              }
-          }
-        else if (ctc == true)
-          {
-            int alphabet = inputc._out.at(b).w;
-            int time_step = inputc._out.at(b).h;
-            std::vector<int> pred_label_seq_with_blank(time_step);
-            for (int t = 0; t < time_step; ++t)
-              {
-                const float *values = inputc._out.at(b).row(t);
-                pred_label_seq_with_blank[t] = std::distance(
-                    values, std::max_element(values, values + alphabet));
-              }
-
-            std::vector<int> pred_label_seq;
-            int prev = blank_label;
-            for (int t = 0; t < time_step; ++t)
-              {
-                int cur = pred_label_seq_with_blank[t];
-                if (cur != prev && cur != blank_label)
-                  pred_label_seq.push_back(cur);
-                prev = cur;
-              }
-            std::string outstr;
-            std::ostringstream oss;
-            for (auto l : pred_label_seq)
-              outstr
-                  += char(std::atoi(this->_mlmodel.get_hcorresp(l).c_str()));
-            cats.push_back(outstr);
-            probs.push_back(1.0);
-          }
-        else if (_timeserie)
-          {
-            std::vector<int> tsl = inputc._timeseries_lengths;
-            for (unsigned int tsi = 0; tsi < tsl.size(); ++tsi)
-              {
-                for (int ti = 0; ti < tsl[tsi]; ++ti)
-                  {
-                    std::vector<double> predictions;
-                    for (int k = 0; k < inputc._ntargets; ++k)
-                      {
-                        double res = inputc._out.at(b).row(ti)[k];
-                        predictions.push_back(inputc.unscale_res(res, k));
-                      }
-                    APIData ts;
-                    ts.add("out", predictions);
-                    series.push_back(ts);
-                  }
-              }
-          }
-        else
-          {
-            std::vector<float> cls_scores;
-
-            cls_scores.resize(inputc._out.at(b).w);
-            for (int j = 0; j < inputc._out.at(b).w; j++)
-              {
-                cls_scores[j] = inputc._out.at(b)[j];
-              }
-            int size = cls_scores.size();
-            std::vector<std::pair<float, int>> vec;
-            vec.resize(size);
-            for (int i = 0; i < size; i++)
-              {
-                vec[i] = std::make_pair(cls_scores[i], i);
-              }
-
-            std::partial_sort(vec.begin(), vec.begin() + best, vec.end(),
-                              std::greater<std::pair<float, int>>());
-
-            for (int i = 0; i < best; i++)
-              {
-                if (vec[i].first < confidence_threshold)
-                  continue;
-                cats.push_back(this->_mlmodel.get_hcorresp(vec[i].second));
-                probs.push_back(vec[i].first);
-              }
-          }
-
-        rad.add("uri", inputc._ids.at(b));
-        rad.add("loss", 0.0);
-        rad.add("cats", cats);
-        if (bbox == true)
-          rad.add("bboxes", bboxes);
-        if (_timeserie)
-          {
-            rad.add("series", series);
-            rad.add("probs", std::vector<double>(series.size(), 1.0));
-          }
-        else
-          rad.add("probs", probs);
+    // inference workers take samples in turn, each with its own extractor
+    // and pool allocators
+    int nsamples = inputc._ids.size();
+    int nworkers = 1;
+    int intra_threads = 1;
+    schedule_threads(nsamples, nworkers, intra_threads);
+    vrad.resize(nsamples);
+    auto predict_sample = [&](const int &b, const int &w)
+    {
+      std::vector<double> probs;
+      std::vector<std::string> cats;
+      std::vector<APIData> bboxes;
+      std::vector<APIData> series;
+      APIData rad;
+
+      ncnn::Extractor ex = _net->create_extractor();
+      ex.set_num_threads(intra_threads);
+      ex.set_blob_allocator(_blob_pool_allocators.at(w).get());
+      ex.set_workspace_allocator(_workspace_pool_allocators.at(w).get());
+      ex.input(_inputBlob.c_str(), inputc._in.at(b));
+
+      int ret = ex.extract(out_blob.c_str(), inputc._out.at(b));
+      if (ret == -1)
+        {
+          throw MLLibInternalException("NCNN internal error");
+        }
 
-        if (_timeserie)
-          out.add("timeseries", true);
+      if (bbox == true)
+        {
+          std::string uri = inputc._ids.at(b);
+          auto bit = inputc._imgs_size.find(uri);
+          int rows = 1;
+          int cols = 1;
+          if (bit != inputc._imgs_size.end())
+            {
+              // original image size
+              rows = (*bit).second.first;
+              cols = (*bit).second.second;
+            }
+          else
+            {
+              throw MLLibInternalException(
+                  "Couldn't find original image size for " + uri);
+            }
+          for (int i = 0; i < inputc._out.at(b).h; i++)
+            {
+              const float *values = inputc._out.at(b).row(i);
+              if (values[1] < confidence_threshold)
+                break; // output is sorted by confidence
+
+              cats.push_back(this->_mlmodel.get_hcorresp(values[0]));
+              probs.push_back(values[1]);
+
+              APIData ad_bbox;
+              ad_bbox.add("xmin",
+                          static_cast<double>(values[2] * (cols - 1)));
+              ad_bbox.add("ymin",
+                          static_cast<double>(values[3] * (rows - 1)));
+              ad_bbox.add("xmax",
+                          static_cast<double>(values[4] * (cols - 1)));
+              ad_bbox.add("ymax",
+                          static_cast<double>(values[5] * (rows - 1)));
+              bboxes.push_back(ad_bbox);
+            }
+        }
+      else if (ctc == true)
+        {
+          int alphabet = inputc._out.at(b).w;
+          int time_step = inputc._out.at(b).h;
+          std::vector<int> pred_label_seq_with_blank(time_step);
+          for (int t = 0; t < time_step; ++t)
+            {
+              const float *values = inputc._out.at(b).row(t);
+              pred_label_seq_with_blank[t] = std::distance(
+                  values, std::max_element(values, values + alphabet));
+            }
+
+          std::vector<int> pred_label_seq;
+          int prev = blank_label;
+          for (int t = 0; t < time_step; ++t)
+            {
+              int cur = pred_label_seq_with_blank[t];
+              if (cur != prev && cur != blank_label)
+                pred_label_seq.push_back(cur);
+              prev = cur;
+            }
+          std::string outstr;
+          std::ostringstream oss;
+          for (auto l : pred_label_seq)
+            outstr
+                += char(std::atoi(this->_mlmodel.get_hcorresp(l).c_str()));
+          cats.push_back(outstr);
+          probs.push_back(1.0);
+        }
+      else if (_timeserie)
+        {
+          std::vector<int> tsl = inputc._timeseries_lengths;
+          for (unsigned int tsi = 0; tsi < tsl.size(); ++tsi)
+            {
+              for (int ti = 0; ti < tsl[tsi]; ++ti)
+                {
+                  std::vector<double> predictions;
+                  for (int k = 0; k < inputc._ntargets; ++k)
+                    {
+                      double res = inputc._out.at(b).row(ti)[k];
+                      predictions.push_back(inputc.unscale_res(res, k));
+                    }
+                  APIData ts;
+                  ts.add("out", predictions);
+                  series.push_back(ts);
+                }
+            }
+        }
+      else
+        {
+          std::vector<float> cls_scores;
+
+          cls_scores.resize(inputc._out.at(b).w);
+          for (int j = 0; j < inputc._out.at(b).w; j++)
+            {
+              cls_scores[j] = inputc._out.at(b)[j];
+            }
+          int size = cls_scores.size();
+          std::vector<std::pair<float, int>> vec;
+          vec.resize(size);
+          for (int i = 0; i < size; i++)
+            {
+              vec[i] = std::make_pair(cls_scores[i], i);
+            }
+
+          std::partial_sort(vec.begin(), vec.begin() + best, vec.end(),
+                            std::greater<std::pair<float, int>>());
+
+          for (int i = 0; i < best; i++)
+            {
+              if (vec[i].first < confidence_threshold)
+                continue;
+              cats.push_back(this->_mlmodel.get_hcorresp(vec[i].second));
+              probs.push_back(vec[i].first);
+            }
+        }
 
-#pragma omp critical
+      rad.add("uri", inputc._ids.at(b));
+      rad.add("loss", 0.0);
+      rad.add("cats", cats);
+      if (bbox == true)
+        rad.add("bboxes", bboxes);
+      if (_timeserie)
         {
-          vrad.push_back(rad);
+          rad.add("series", series);
+          rad.add("probs", std::vector<double>(series.size(), 1.0));
         }
-      } // end for batch_size
+      else
+        rad.add("probs", probs);
+
+      vrad.at(b) = std::move(rad);
+    };
+    _workers->run(nworkers,
+                  [&](const int &w)
+                  {
+                    for (int b = w; b < nsamples; b += nworkers)
+                      {
+                        try
+                          {
+                            predict_sample(b, w);
+                          }
+                        catch (...)
+                          {
+                            inputc._out.at(b).release();
+                            throw;
+                          }
+                        // outputs go back to the worker's blob allocator from
+                        // the worker itself
+                        inputc._out.at(b).release();
+                      }
+                  });
+    if (_timeserie)
+      out.add("timeseries", true);
 
+    this->_stats.output_start();
     tout.add_results(vrad);
     out.add("nclasses", this->_nclasses);
     if (bbox == true)
@@ -430,6 +466,7 @@ namespace dd
     out.add("multibox_rois", false);
     tout.finalize(ad.getobj("parameters").getobj("output"), out,
                   static_cast<MLModel *>(&this->_mlmodel));
+    this->_stats.output_end();
 
     // chain compliance
     if (ad.has("chain") && ad.get("chain").get<bool>())
@@ -25,9 +25,12 @@
 // NCNN
 #include "net.h"
 #include "ncnnmodel.h"
+#include "workerpool.h"
 
 #include "apidata.h"
 
+#include <memory>
+
 namespace dd
 {
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
@@ -58,8 +61,22 @@ namespace dd
     bool _lightmode = true;
 
   private:
-    static ncnn::UnlockedPoolAllocator _blob_pool_allocator;
-    static ncnn::PoolAllocator _workspace_pool_allocator;
+    /**
+     * \brief splits threads in between batch samples and within each sample
+     *        inference
+     * @param nsamples batch size
+     * @param nworkers number of samples inferred concurrently
+     * @param intra_threads number of threads per sample inference
+     */
+    void schedule_threads(const int &nsamples, int &nworkers,
+                          int &intra_threads) const;
+
+    std::unique_ptr<WorkerPool>
+        _workers; /**< inference workers, one predict call at a time. */
+    std::vector<std::unique_ptr<ncnn::UnlockedPoolAllocator>>
+        _blob_pool_allocators; /**< blob allocator per worker. */
+    std::vector<std::unique_ptr<ncnn::PoolAllocator>>
+        _workspace_pool_allocators; /**< workspace allocator per worker. */
 
   protected:
     int _threads = 1;
@@ -868,6 +868,7 @@ namespace dd
 
     cudaStreamDestroy(cstream);
 
+    this->_stats.output_start();
     tout.add_results(vrad);
 
     out.add("nclasses", this->_nclasses);
@@ -879,6 +880,7 @@ namespace dd
     out.add("multibox_rois", false);
     tout.finalize(ad.getobj("parameters").getobj("output"), out,
                   static_cast<MLModel *>(&this->_mlmodel));
+    this->_stats.output_end();
 
     if (ad.has("chain") && ad.get("chain").get<bool>())
       {
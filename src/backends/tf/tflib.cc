@@ -510,10 +510,12 @@ namespace dd
             idoffset += dv.size();
           }
       } // end prediction loop over batches
+    this->_stats.output_start();
     tout.add_results(vrad);
     out.add("nclasses", _nclasses);
     tout.finalize(ad.getobj("parameters").getobj("output"), out,
                   static_cast<MLModel *>(&this->_mlmodel));
+    this->_stats.output_end();
     out.add("status", 0);
     return 0;
   }
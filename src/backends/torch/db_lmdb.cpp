@@ -87,11 +87,7 @@ namespace dd
       mdb_key.mv_size = key.size();
       mdb_key.mv_data = const_cast<char *>(key.data());
       mdb_get(mdb_txn, mdb_dbi, &mdb_key, &data);
-      char *data_raw = new char[data.mv_size + 1];
-      memcpy(data_raw, data.mv_data, data.mv_size);
-      data_raw[data.mv_size] = 0;
-      data_val = std::string(data_raw, data.mv_size);
-      delete[] data_raw;
+      data_val.assign(static_cast<const char *>(data.mv_data), data.mv_size);
       mdb_txn_commit(mdb_txn);
       mdb_dbi_close(mdb_env_, mdb_dbi);
     }
@@ -28,21 +28,19 @@ namespace dd
   void NBeats::BlockImpl::init_block()
   {
     _fc1 = register_module(
-        "fc1", torch::nn::Linear(_backcast_length * _data_size, _units));
-    _fc2 = register_module("fc2", torch::nn::Linear(_units, _units));
-    _fc3 = register_module("fc3", torch::nn::Linear(_units, _units));
-    _fc4 = register_module("fc4", torch::nn::Linear(_units, _units));
+        "fc1", QLinear(_backcast_length * _data_size, _units));
+    _fc2 = register_module("fc2", QLinear(_units, _units));
+    _fc3 = register_module("fc3", QLinear(_units, _units));
+    _fc4 = register_module("fc4", QLinear(_units, _units));
     _theta_f_fc = register_module(
         "theta_f_fc",
-        torch::nn::Linear(
-            torch::nn::LinearOptions(_units, _thetas_dim).bias(false)));
+        QLinear(torch::nn::LinearOptions(_units, _thetas_dim).bias(false)));
     if (_share_thetas)
       _theta_b_fc = _theta_f_fc;
     else
       _theta_b_fc = register_module(
           "theta_b_fc",
-          torch::nn::Linear(
-              torch::nn::LinearOptions(_units, _thetas_dim).bias(false)));
+          QLinear(torch::nn::LinearOptions(_units, _thetas_dim).bias(false)));
   }
 
   torch::Tensor NBeats::BlockImpl::first_forward(torch::Tensor x)
@@ -27,6 +27,7 @@
 #include "torch/torch.h"
 #pragma GCC diagnostic pop
 #include "../../torchinputconns.h"
+#include "../../torchquantize.h"
 #include "mllibstrategy.h"
 #include "../native_net.h"
 
@@ -95,12 +96,12 @@ namespace dd
       unsigned int _backcast_length;
       unsigned int _forecast_length;
       bool _share_thetas;
-      torch::nn::Linear _fc1{ nullptr };
-      torch::nn::Linear _fc2{ nullptr };
-      torch::nn::Linear _fc3{ nullptr };
-      torch::nn::Linear _fc4{ nullptr };
-      torch::nn::Linear _theta_b_fc{ nullptr };
-      torch::nn::Linear _theta_f_fc{ nullptr };
+      QLinear _fc1{ nullptr };
+      QLinear _fc2{ nullptr };
+      QLinear _fc3{ nullptr };
+      QLinear _fc4{ nullptr };
+      QLinear _theta_b_fc{ nullptr };
+      QLinear _theta_f_fc{ nullptr };
     };
 
     typedef torch::nn::ModuleHolder<BlockImpl> Block;
@@ -223,14 +224,14 @@ namespace dd
       {
         _backcast_fc = register_module(
             "backcast_fc",
-            torch::nn::Linear(_thetas_dim, _backcast_length * _data_size));
+            QLinear(_thetas_dim, _backcast_length * _data_size));
         _forecast_fc = register_module(
             "forecast_fc",
-            torch::nn::Linear(_thetas_dim, _forecast_length * _data_size));
+            QLinear(_thetas_dim, _forecast_length * _data_size));
       }
 
-      torch::nn::Linear _backcast_fc{ nullptr };
-      torch::nn::Linear _forecast_fc{ nullptr };
+      QLinear _backcast_fc{ nullptr };
+      QLinear _forecast_fc{ nullptr };
     };
 
     typedef torch::nn::ModuleHolder<GenericBlockImpl> GenericBlock;
@@ -397,7 +398,7 @@ namespace dd
     std::vector<int> _thetas_dims = NBEATS_DEFAULT_THETAS;
 
     std::vector<Stack> _stacks;
-    torch::nn::Linear _fcn{ nullptr };
+    QLinear _fcn{ nullptr };
     std::vector<float> _backcast_linspace;
     std::vector<float> _forecast_linspace;
     std::tuple<torch::Tensor, torch::Tensor> create_sin_basis(int thetas_dim);
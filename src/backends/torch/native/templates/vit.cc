@@ -32,8 +32,8 @@ namespace dd
     if (!_hidden_dim)
       _hidden_dim = _input_dim;
 
-    _fc1 = register_module("fc1", torch::nn::Linear(_input_dim, _hidden_dim));
-    _fc2 = register_module("fc2", torch::nn::Linear(_hidden_dim, _output_dim));
+    _fc1 = register_module("fc1", QLinear(_input_dim, _hidden_dim));
+    _fc2 = register_module("fc2", QLinear(_hidden_dim, _output_dim));
     _drop1 = register_module(
         "drop", torch::nn::Dropout(torch::nn::DropoutOptions(_drop)));
   }
@@ -58,12 +58,12 @@ namespace dd
       _scale = std::pow(_head_dim, -0.5);
 
     _qkv = register_module(
-        "qkv", torch::nn::Linear(
-                   torch::nn::LinearOptions(_dim, _dim * 3).bias(_qkv_bias)));
+        "qkv",
+        QLinear(torch::nn::LinearOptions(_dim, _dim * 3).bias(_qkv_bias)));
     _attn_drop = register_module(
         "attn_drop",
         torch::nn::Dropout(torch::nn::DropoutOptions(_attn_drop_val)));
-    _proj = register_module("proj", torch::nn::Linear(_dim, _dim));
+    _proj = register_module("proj", QLinear(_dim, _dim));
     _proj_drop = register_module(
         "proj_drop",
         torch::nn::Dropout(torch::nn::DropoutOptions(_proj_drop_val)));
@@ -280,8 +280,7 @@ namespace dd
         "norm",
         torch::nn::LayerNorm(torch::nn::LayerNormOptions({ embed_dim })));
 
-    _head
-        = register_module("head", torch::nn::Linear(embed_dim, _num_classes));
+    _head = register_module("head", QLinear(embed_dim, _num_classes));
   }
 
   torch::Tensor ViT::forward_features(torch::Tensor x)
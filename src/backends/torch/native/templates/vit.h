@@ -27,6 +27,7 @@
 #include "torch/torch.h"
 #pragma GCC diagnostic pop
 #include "../../torchinputconns.h"
+#include "../../torchquantize.h"
 #include "mllibstrategy.h"
 #include "../native_net.h"
 
@@ -75,8 +76,8 @@ namespace dd
       std::string _act = "gelu";
       double _drop = 0.0;
 
-      torch::nn::Linear _fc1{ nullptr };
-      torch::nn::Linear _fc2{ nullptr };
+      QLinear _fc1{ nullptr };
+      QLinear _fc2{ nullptr };
       torch::nn::Dropout _drop1{ nullptr };
     };
 
@@ -132,9 +133,9 @@ namespace dd
       double _scale = 1.0;
       unsigned int _head_dim = 0;
 
-      torch::nn::Linear _qkv{ nullptr };
+      QLinear _qkv{ nullptr };
       torch::nn::Dropout _attn_drop{ nullptr };
-      torch::nn::Linear _proj{ nullptr };
+      QLinear _proj{ nullptr };
       torch::nn::Dropout _proj_drop{ nullptr };
 
       bool _realformer = false;
@@ -364,7 +365,7 @@ namespace dd
     torch::nn::Dropout _pos_drop{ nullptr };
     torch::nn::ModuleList _blocks;
     torch::nn::LayerNorm _norm{ nullptr };
-    torch::nn::Linear _head{ nullptr };
+    QLinear _head{ nullptr };
   };
 
 }
@@ -64,6 +64,11 @@ namespace dd
 
     void augment(cv::Mat &src);
 
+    void seed(const unsigned int &s)
+    {
+      _rnd_gen.seed(s);
+    }
+
   protected:
     void applyMirror(cv::Mat &src);
     void applyRotate(cv::Mat &src);
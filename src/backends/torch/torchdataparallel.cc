@@ -0,0 +1,144 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2021 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "torchdataparallel.h"
+#include "torchutils.h"
+#include "mllibstrategy.h"
+
+namespace dd
+{
+  TorchDataParallel::TorchDataParallel(
+      const std::shared_ptr<NativeModule> &module, const int &nworkers,
+      const torch::Dtype &dtype)
+      : _module(module), _workers(nworkers), _dtype(dtype)
+  {
+    // workers share the cores that intra-op parallelism used
+    _saved_threads = at::get_num_threads();
+    _intra_threads = std::max(1, _saved_threads / _workers.size());
+
+    for (int w = 1; w < _workers.size(); ++w)
+      {
+        std::shared_ptr<NativeModule> replica
+            = std::dynamic_pointer_cast<NativeModule>(_module->clone());
+        if (!replica)
+          throw MLLibInternalException("unable to replicate native module");
+        replica->train();
+        _replicas.push_back(replica);
+      }
+  }
+
+  TorchDataParallel::~TorchDataParallel()
+  {
+    at::set_num_threads(_saved_threads);
+  }
+
+  double TorchDataParallel::forward_backward(
+      const std::vector<c10::IValue> &in_vals, const torch::Tensor &y,
+      const LossFunction &loss_fn, const bool &retain_graph)
+  {
+    // native modules take only one tensor as input for now
+    torch::Tensor x = torch_utils::to_tensor_safe(in_vals.at(0));
+    std::vector<torch::Tensor> xs = x.chunk(size(), 0);
+    std::vector<torch::Tensor> ys = y.chunk(size(), 0);
+    int nshards = static_cast<int>(std::min(xs.size(), ys.size()));
+    _nactive = std::max(_nactive, nshards);
+    double bsize = static_cast<double>(x.size(0));
+    std::vector<double> losses(nshards, 0.0);
+
+    _workers.run(nshards, [&](const int &w) {
+      if (at::get_num_threads() != _intra_threads)
+        at::set_num_threads(_intra_threads);
+      torch::AutoGradMode enable_grad(true);
+
+      NativeModule &module = w == 0 ? *_module : *_replicas.at(w - 1);
+      std::vector<c10::IValue> shard_in = { xs.at(w) };
+      torch::Tensor x_w = xs.at(w);
+      if (x_w.is_floating_point())
+        x_w = x_w.to(_dtype);
+      // losses are computed in fp32, as with TorchModule::forward
+      torch::Tensor y_pred = module.forward(x_w).to(torch::kFloat32);
+      // shard losses are batch means, weighted by their share of the batch
+      torch::Tensor loss = loss_fn(module, shard_in, y_pred, ys.at(w))
+                           * (xs.at(w).size(0) / bsize);
+      loss.backward({}, c10::optional<bool>(retain_graph), false);
+      losses.at(w) = loss.item<double>();
+    });
+
+    // all-reduce, gradients are summed in worker order for reproducibility
+    torch::NoGradGuard no_grad;
+    std::vector<torch::Tensor> params = _module->parameters();
+    for (int w = 1; w < nshards; ++w)
+      {
+        std::vector<torch::Tensor> rparams
+            = _replicas.at(w - 1)->parameters();
+        for (size_t p = 0; p < params.size(); ++p)
+          {
+            torch::Tensor rgrad = rparams.at(p).grad();
+            if (!rgrad.defined())
+              continue;
+            if (params.at(p).grad().defined())
+              params.at(p).mutable_grad().add_(rgrad);
+            else
+              params.at(p).mutable_grad() = rgrad.clone();
+            rgrad.zero_();
+          }
+      }
+
+    double loss = 0.0;
+    for (double l : losses)
+      loss += l;
+    return loss;
+  }
+
+  void TorchDataParallel::sync_replicas()
+  {
+    torch::NoGradGuard no_grad;
+    std::vector<torch::Tensor> params = _module->parameters();
+    std::vector<torch::Tensor> buffers = _module->buffers();
+
+    // running statistics, e.g. of batch norms, are averaged over the
+    // replicas that ran since the former sync, in worker order
+    if (_nactive > 1)
+      {
+        for (int w = 1; w < _nactive; ++w)
+          {
+            std::vector<torch::Tensor> rbuffers
+                = _replicas.at(w - 1)->buffers();
+            for (size_t b = 0; b < buffers.size(); ++b)
+              if (buffers.at(b).is_floating_point())
+                buffers.at(b).add_(rbuffers.at(b));
+          }
+        for (torch::Tensor &buffer : buffers)
+          if (buffer.is_floating_point())
+            buffer.div_(static_cast<double>(_nactive));
+      }
+    _nactive = 1;
+
+    for (const std::shared_ptr<NativeModule> &replica : _replicas)
+      {
+        std::vector<torch::Tensor> rparams = replica->parameters();
+        for (size_t p = 0; p < params.size(); ++p)
+          rparams.at(p).copy_(params.at(p));
+        std::vector<torch::Tensor> rbuffers = replica->buffers();
+        for (size_t b = 0; b < buffers.size(); ++b)
+          rbuffers.at(b).copy_(buffers.at(b));
+      }
+  }
+}
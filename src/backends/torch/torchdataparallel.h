@@ -0,0 +1,112 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2021 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TORCH_DATA_PARALLEL_H
+#define TORCH_DATA_PARALLEL_H
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#include <torch/torch.h>
+#pragma GCC diagnostic pop
+
+#include "native/native_net.h"
+#include "workerpool.h"
+
+#include <functional>
+#include <memory>
+
+namespace dd
+{
+  /**
+   * \brief CPU data-parallel training of a native module: each batch is
+   * split into shards, and each worker runs forward and backward passes of
+   * its shard on its own replica of the module. Replica gradients are then
+   * summed into the module ones in worker order, so that results only
+   * depend on the seed and the number of workers.
+   */
+  class TorchDataParallel
+  {
+  public:
+    /**
+     * \brief loss of a shard: module, shard inputs, output and target
+     */
+    typedef std::function<torch::Tensor(
+        NativeModule &, const std::vector<c10::IValue> &,
+        const torch::Tensor &, const torch::Tensor &)>
+        LossFunction;
+
+    /**
+     * \brief creates replicas of module and their workers
+     * @param module trained module, used by worker 0
+     * @param nworkers number of workers
+     * @param dtype datatype of module weights, shard inputs are cast to it
+     */
+    TorchDataParallel(const std::shared_ptr<NativeModule> &module,
+                      const int &nworkers,
+                      const torch::Dtype &dtype = torch::kFloat32);
+
+    /**
+     * \brief stops workers and restores the intra-op thread count
+     */
+    ~TorchDataParallel();
+
+    /**
+     * \brief forward and backward passes of a batch, gradients are
+     * accumulated into the module ones
+     * @param in_vals batch inputs
+     * @param y batch target
+     * @param loss_fn shard loss, as a batch mean
+     * @param retain_graph see torch::autograd::backward
+     * @return batch loss
+     */
+    double forward_backward(const std::vector<c10::IValue> &in_vals,
+                            const torch::Tensor &y,
+                            const LossFunction &loss_fn,
+                            const bool &retain_graph);
+
+    /**
+     * \brief copies module weights to replicas, once they were updated.
+     * Floating point buffers, e.g. batch norm running statistics, are first
+     * averaged over the workers that ran since the former sync, integer
+     * ones are taken from the module
+     */
+    void sync_replicas();
+
+    /**
+     * \brief number of workers
+     */
+    int size() const
+    {
+      return _workers.size();
+    }
+
+  private:
+    std::shared_ptr<NativeModule> _module; /**< trained module. */
+    std::vector<std::shared_ptr<NativeModule>>
+        _replicas;       /**< module replicas of workers 1 .. n-1. */
+    WorkerPool _workers; /**< one worker per shard. */
+    torch::Dtype _dtype; /**< datatype of module weights. */
+    int _intra_threads = 1; /**< intra-op threads per worker. */
+    int _saved_threads = 1; /**< intra-op threads before training. */
+    int _nactive = 1; /**< workers that ran since the last sync. */
+  };
+}
+
+#endif
@@ -39,6 +39,7 @@ namespace dd
         _txn.reset();
       }
     _dbData = nullptr;
+    _db_keys.clear(); // db content may have changed
     _current_index = 0;
   }
 
@@ -86,10 +87,10 @@ namespace dd
   void TorchDataset::write_tensors_to_db(const std::vector<at::Tensor> &data,
                                          const std::vector<at::Tensor> &target)
   {
-    std::ostringstream dstream;
-    torch::save(data, dstream);
-    std::ostringstream tstream;
-    torch::save(target, tstream);
+    std::string drecord;
+    torch_utils::write_tensor_record(data, drecord);
+    std::string trecord;
+    torch_utils::write_tensor_record(target, trecord);
 
     if (_dbData == nullptr)
       {
@@ -104,8 +105,8 @@ namespace dd
     data_key << std::to_string(_current_index) << "_data";
     target_key << std::to_string(_current_index) << "_target";
 
-    _txn->Put(data_key.str(), dstream.str());
-    _txn->Put(target_key.str(), tstream.str());
+    _txn->Put(data_key.str(), drecord);
+    _txn->Put(target_key.str(), trecord);
 
     // should not commit transactions every time;
     if (++_current_index % _batches_per_transaction == 0)
@@ -128,8 +129,8 @@ namespace dd
       dstream << c;
 
     // serialize target
-    std::ostringstream tstream;
-    torch::save(target, tstream);
+    std::string trecord;
+    torch_utils::write_tensor_record({ target }, trecord);
 
     // check on db
     if (_dbData == nullptr)
@@ -148,7 +149,7 @@ namespace dd
 
     // store into db
     _txn->Put(data_key.str(), dstream.str());
-    _txn->Put(target_key.str(), tstream.str());
+    _txn->Put(target_key.str(), trecord);
 
     // should not commit transactions every time;
     if (++_current_index % _batches_per_transaction == 0)
@@ -168,8 +169,15 @@ namespace dd
     bgr = cv::Mat(img_data, true);
     bgr = cv::imdecode(bgr,
                        bw ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR);
-    std::stringstream targetstream(targets);
-    torch::load(targett, targetstream);
+    if (torch_utils::is_tensor_record(targets))
+      {
+        targett = torch_utils::read_tensor_record(targets).at(0);
+      }
+    else // legacy target
+      {
+        std::stringstream targetstream(targets);
+        torch::load(targett, targetstream);
+      }
   }
 
   // add image batch
@@ -219,8 +227,32 @@ namespace dd
       write_tensors_to_db(data, target);
   }
 
+  int64_t TorchDataset::add_series(const at::Tensor &data,
+                                   const at::Tensor &target)
+  {
+    _series.push_back(std::make_pair(data, target));
+    return _series.size() - 1;
+  }
+
+  void TorchDataset::add_window(const TorchSeriesWindow &window)
+  {
+    if (!_db)
+      {
+        _windows.push_back(window);
+        return;
+      }
+    const auto &series = _series.at(window._series);
+    std::vector<at::Tensor> target;
+    if (window._target_len > 0)
+      target.push_back(series.second.narrow(0, window._target_start,
+                                            window._target_len));
+    add_batch({ series.first.narrow(0, window._data_start, window._data_len) },
+              target);
+  }
+
   void TorchDataset::reset(bool shuffle, db::Mode dbmode)
   {
+    _prefetcher.reset(); // stops reading ahead from the previous epoch
     _shuffle = shuffle;
     if (!_db)
       {
@@ -229,6 +261,11 @@ namespace dd
             _indices = std::vector<int64_t>(_lfiles.size());
             std::iota(std::begin(_indices), std::end(_indices), 0);
           }
+        else if (!_windows.empty())
+          {
+            _indices = std::vector<int64_t>(_windows.size());
+            std::iota(std::begin(_indices), std::end(_indices), 0);
+          }
         else if (!_batches.empty())
           {
             _indices = std::vector<int64_t>(_batches.size());
@@ -247,11 +284,34 @@ namespace dd
             _dbData->Open(_dbFullName, dbmode);
           }
 
-        if (!_dbCursor)
-          _dbCursor = _dbData->NewCursor();
+        if (_db_keys.empty())
+          build_db_keys();
 
-        _indices = std::vector<int64_t>(_dbData->Count());
+        _indices = std::vector<int64_t>(_db_keys.size());
         std::iota(std::begin(_indices), std::end(_indices), 0);
+
+        if (_shuffle && _shuffle_block > 1)
+          {
+            // shuffle blocks of neighbour keys, then within each block,
+            // so that reads stay local to a few db pages at a time
+            std::vector<int64_t> blocks((_indices.size() + _shuffle_block - 1)
+                                        / _shuffle_block);
+            std::iota(std::begin(blocks), std::end(blocks), 0);
+            std::shuffle(blocks.begin(), blocks.end(), _rng);
+            size_t i = 0;
+            for (int64_t b : blocks)
+              {
+                size_t start = i;
+                for (int64_t id = b * _shuffle_block;
+                     id < (b + 1) * _shuffle_block
+                     && id < static_cast<int64_t>(_db_keys.size());
+                     ++id)
+                  _indices[i++] = id;
+                std::shuffle(_indices.begin() + start, _indices.begin() + i,
+                             _rng);
+              }
+            return;
+          }
       }
 
     if (_shuffle)
@@ -260,23 +320,111 @@ namespace dd
       }
   }
 
+  void TorchDataset::build_db_keys()
+  {
+    _db_keys.clear();
+    db::Cursor *cursor = _dbData->NewCursor();
+    while (cursor->valid())
+      {
+        std::string key = cursor->key();
+        size_t pos = key.find("_data");
+        if (pos != std::string::npos) // skip targets
+          _db_keys.push_back(key.substr(0, pos));
+        cursor->Next();
+      }
+    delete cursor;
+    _logger->info("Indexed {} samples from db {}", _db_keys.size(),
+                  _dbFullName);
+  }
+
   std::vector<long int> TorchDataset::datasize(long int i) const
   {
+    if (!_db && !_windows.empty())
+      {
+        const TorchSeriesWindow &w = _windows[0];
+        return std::vector<long int>{
+          w._data_len, _series.at(w._series).first.size(1)
+        };
+      }
     if (!_db)
       return _batches[0].data[i].sizes().vec();
 
     auto id = _indices.back();
-    std::stringstream data_key;
-    data_key << id << "_data";
     std::string datas;
-    _dbData->Get(data_key.str(), datas);
-    std::stringstream datastream(datas);
-    std::vector<torch::Tensor> d;
-    torch::load(d, datastream);
+    _dbData->Get(_db_keys.at(id) + "_data", datas);
+    std::vector<torch::Tensor> d = torch_utils::read_tensor_record(datas);
 
     return d.at(i).sizes().vec();
   }
 
+  void TorchDataset::read_db_elt(const int64_t &id, std::string &datas,
+                                 std::string &targets)
+  {
+    const std::string &key = _db_keys.at(id);
+    _dbData->Get(key + "_data", datas);
+    _dbData->Get(key + "_target", targets);
+  }
+
+  TorchBatch
+  TorchDataset::decode_db_batch(const TorchDbRecords &records,
+                                TorchImgRandAugCV &img_rand_aug_cv)
+  {
+    std::vector<std::vector<torch::Tensor>> data, target;
+
+    for (const auto &rec : records)
+      {
+        std::vector<torch::Tensor> d;
+        std::vector<torch::Tensor> t;
+
+        if (!_image)
+          {
+            // views on records, copied once when stacking
+            d = torch_utils::read_tensor_record(rec.first);
+            t = torch_utils::read_tensor_record(rec.second);
+          }
+        else
+          {
+            ImgTorchInputFileConn *inputc
+                = reinterpret_cast<ImgTorchInputFileConn *>(_inputc);
+
+            cv::Mat bgr;
+            torch::Tensor targett;
+            read_image_from_db(rec.first, rec.second, bgr, targett,
+                               inputc->_bw);
+
+            // data augmentation can apply here, with OpenCV
+            img_rand_aug_cv.augment(bgr);
+
+            torch::Tensor imgt
+                = image_to_tensor(bgr, inputc->height(), inputc->width());
+
+            d.push_back(imgt);
+            t.push_back(targett);
+          }
+
+        for (unsigned int i = 0; i < d.size(); ++i)
+          {
+            while (i >= data.size())
+              data.emplace_back();
+            data[i].push_back(d.at(i));
+          }
+        for (unsigned int i = 0; i < t.size(); ++i)
+          {
+            while (i >= target.size())
+              target.emplace_back();
+            target[i].push_back(t.at(i));
+          }
+      }
+
+    std::vector<torch::Tensor> data_tensors;
+    std::vector<torch::Tensor> target_tensors;
+    for (const auto &vec : data)
+      data_tensors.push_back(torch::stack(vec));
+    for (const auto &vec : target)
+      target_tensors.push_back(torch::stack(vec));
+    return TorchBatch{ data_tensors, target_tensors };
+  }
+
   // `request` holds the size of the batch
   // Data selection and batch construction are done in this method
   c10::optional<TorchBatch> TorchDataset::get_batch(BatchRequestType request)
@@ -342,6 +490,30 @@ namespace dd
               }
             _batches.clear();
           }
+        else if (!_windows.empty()) // views on series, copied when stacking
+          {
+            while (count != 0)
+              {
+                const TorchSeriesWindow &w = _windows[_indices.back()];
+                const auto &series = _series[w._series];
+
+                if (first_iter)
+                  {
+                    data.resize(1);
+                    target.resize(w._target_len > 0 ? 1 : 0);
+                    first_iter = false;
+                  }
+
+                data[0].push_back(
+                    series.first.narrow(0, w._data_start, w._data_len));
+                if (w._target_len > 0 && !target.empty())
+                  target[0].push_back(series.second.narrow(
+                      0, w._target_start, w._target_len));
+
+                _indices.pop_back();
+                count--;
+              }
+          }
         else // batches
           {
             while (count != 0)
@@ -372,88 +544,26 @@ namespace dd
       }
     else // below db case
       {
-        while (count != 0)
+        if (_prefetch_workers > 0)
           {
-            std::stringstream data_key;
-            std::stringstream target_key;
-
-            if (!_dbCursor->valid())
-              {
-                delete _dbCursor;
-                _dbCursor = _dbData->NewCursor();
-              }
-            std::string key = _dbCursor->key();
-            size_t pos = key.find("_data");
-            if (pos != std::string::npos)
-              {
-                data_key << key;
-                std::string sid = key.substr(0, pos);
-                target_key << sid << "_target";
-              }
-            else // skip targets
-              {
-                _dbCursor->Next();
-                continue;
-              }
-
-            std::string targets;
-            std::string datas;
-            _dbData->Get(data_key.str(), datas);
-            _dbData->Get(target_key.str(), targets);
-            _dbCursor->Next();
-
-            std::vector<torch::Tensor> d;
-            std::vector<torch::Tensor> t;
-
-            if (first_iter)
-              {
-                data.resize(d.size());
-                target.resize(t.size());
-                first_iter = false;
-              }
-
-            if (!_image)
-              {
-                std::stringstream datastream(datas);
-                std::stringstream targetstream(targets);
-                torch::load(d, datastream);
-                torch::load(t, targetstream);
-              }
-            else
-              {
-                ImgTorchInputFileConn *inputc
-                    = reinterpret_cast<ImgTorchInputFileConn *>(_inputc);
-
-                cv::Mat bgr;
-                torch::Tensor targett;
-                read_image_from_db(datas, targets, bgr, targett, inputc->_bw);
-
-                // data augmentation can apply here, with OpenCV
-                _img_rand_aug_cv.augment(bgr);
-
-                torch::Tensor imgt
-                    = image_to_tensor(bgr, inputc->height(), inputc->width());
-
-                d.push_back(imgt);
-                t.push_back(targett);
-              }
-
-            for (unsigned int i = 0; i < d.size(); ++i)
-              {
-                while (i >= data.size())
-                  data.emplace_back();
-                data[i].push_back(d.at(i));
-              }
-            for (unsigned int i = 0; i < t.size(); ++i)
-              {
-                while (i >= target.size())
-                  target.emplace_back();
-                target[i].push_back(t.at(i));
-              }
+            if (!_prefetcher)
+              _prefetcher = std::make_shared<TorchDbPrefetcher>(
+                  this, request[0],
+                  std::vector<int64_t>(_indices.rbegin(), _indices.rend()),
+                  _prefetch_workers, _prefetch_batches, _seed);
+            c10::optional<TorchBatch> batch = _prefetcher->next();
+            if (batch)
+              _indices.resize(_indices.size() - batch->data.at(0).size(0));
+            return batch;
+          }
 
+        TorchDbRecords records(count);
+        for (auto &rec : records)
+          {
+            read_db_elt(_indices.back(), rec.first, rec.second);
             _indices.pop_back();
-            count--;
           }
+        return decode_db_batch(records, _img_rand_aug_cv);
       }
 
     for (const auto &vec : data)
@@ -465,6 +575,120 @@ namespace dd
     return TorchBatch{ data_tensors, target_tensors };
   }
 
+  /*- TorchDbPrefetcher -*/
+  TorchDbPrefetcher::TorchDbPrefetcher(TorchDataset *dataset,
+                                       const size_t &batch_size,
+                                       std::vector<int64_t> ids,
+                                       const int &workers, const int &capacity,
+                                       const long &seed)
+      : _dataset(dataset), _batch_size(batch_size), _ids(std::move(ids)),
+        _capacity(std::max(capacity, 1)), _seed(seed)
+  {
+    _nbatches = (_ids.size() + _batch_size - 1) / _batch_size;
+    _threads.emplace_back(&TorchDbPrefetcher::read_loop, this);
+    for (int w = 0; w < workers; ++w)
+      _threads.emplace_back(&TorchDbPrefetcher::decode_loop, this, w);
+  }
+
+  TorchDbPrefetcher::~TorchDbPrefetcher()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _cv.notify_all();
+    for (auto &th : _threads)
+      th.join();
+  }
+
+  c10::optional<TorchBatch> TorchDbPrefetcher::next()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_next_out >= _nbatches)
+      return torch::nullopt;
+    _cv.wait(lock, [this] { return _eptr || _ready.count(_next_out); });
+    if (_eptr)
+      std::rethrow_exception(_eptr);
+    auto it = _ready.find(_next_out);
+    TorchBatch batch = std::move(it->second);
+    _ready.erase(it);
+    ++_next_out;
+    lock.unlock();
+    _cv.notify_all(); // room for the reader
+    return batch;
+  }
+
+  void TorchDbPrefetcher::read_loop()
+  {
+    try
+      {
+        for (int64_t rank = 0; rank < _nbatches; ++rank)
+          {
+            {
+              std::unique_lock<std::mutex> lock(_mutex);
+              _cv.wait(lock, [this, rank] {
+                return _stop || rank - _next_out < _capacity;
+              });
+              if (_stop)
+                return;
+            }
+            size_t first = rank * _batch_size;
+            size_t n = std::min(_batch_size, _ids.size() - first);
+            TorchDbRecords records(n);
+            for (size_t i = 0; i < n; ++i)
+              _dataset->read_db_elt(_ids[first + i], records[i].first,
+                                    records[i].second);
+            {
+              std::lock_guard<std::mutex> lock(_mutex);
+              _raw.emplace_back(rank, std::move(records));
+            }
+            _cv.notify_all();
+          }
+      }
+    catch (...)
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_eptr)
+          _eptr = std::current_exception();
+        _cv.notify_all();
+      }
+  }
+
+  void TorchDbPrefetcher::decode_loop(const int &worker)
+  {
+    // augmentation draws random numbers, each worker owns its policy
+    TorchImgRandAugCV img_rand_aug_cv = _dataset->_img_rand_aug_cv;
+    img_rand_aug_cv.seed(_seed == -1 ? std::random_device()()
+                                     : _seed + worker + 1);
+
+    while (true)
+      {
+        std::pair<int64_t, TorchDbRecords> raw;
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _cv.wait(lock, [this] { return _stop || !_raw.empty(); });
+          if (_stop)
+            return;
+          raw = std::move(_raw.front());
+          _raw.pop_front();
+        }
+        try
+          {
+            TorchBatch batch
+                = _dataset->decode_db_batch(raw.second, img_rand_aug_cv);
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ready.emplace(raw.first, std::move(batch));
+          }
+        catch (...)
+          {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_eptr)
+              _eptr = std::current_exception();
+          }
+        _cv.notify_all();
+      }
+  }
+
   TorchBatch TorchDataset::get_cached()
   {
     reset();
@@ -483,6 +707,15 @@ namespace dd
 
     TorchDataset new_dataset;
     new_dataset._batches.insert(new_dataset._batches.end(), start_it, stop_it);
+    if (!_windows.empty())
+      {
+        auto nwindows = _windows.size();
+        new_dataset._series = _series;
+        new_dataset._windows.insert(
+            new_dataset._windows.end(),
+            _windows.begin() + static_cast<int64_t>(nwindows * start),
+            _windows.end() - static_cast<int64_t>(nwindows * (1 - stop)));
+      }
     return new_dataset;
   }
 
@@ -559,31 +792,44 @@ namespace dd
     ImgTorchInputFileConn *inputc
         = reinterpret_cast<ImgTorchInputFileConn *>(_inputc);
 
-    std::vector<int64_t> sizes{ height, width, bgr.channels() };
-    at::TensorOptions options(at::ScalarType::Byte);
-
-    at::Tensor imgt = torch::from_blob(bgr.data, at::IntList(sizes), options);
-    imgt = imgt.toType(at::kFloat).permute({ 2, 0, 1 });
-    size_t nchannels = imgt.size(0);
-
-    if (inputc->_scale != 1.0)
-      imgt = imgt.mul(inputc->_scale);
+    size_t nchannels = bgr.channels();
 
     if (!inputc->_mean.empty() && inputc->_mean.size() != nchannels)
       throw InputConnectorBadParamException(
           "mean vector be of size the number of channels ("
           + std::to_string(nchannels) + ")");
 
-    for (size_t m = 0; m < inputc->_mean.size(); m++)
-      imgt[m] = imgt[m].sub_(inputc->_mean.at(m));
-
     if (!inputc->_std.empty() && inputc->_std.size() != nchannels)
       throw InputConnectorBadParamException(
           "std vector be of size the number of channels ("
           + std::to_string(nchannels) + ")");
 
-    for (size_t s = 0; s < inputc->_std.size(); s++)
-      imgt[s] = imgt[s].div_(inputc->_std.at(s));
+    // input may be a ROI view, e.g. a chain crop, or not be at input size
+    cv::Mat img = bgr;
+    if (img.rows != height || img.cols != width)
+      cv::resize(bgr, img, cv::Size(width, height));
+
+    // scale, mean and std fold into one affine transform per channel, that
+    // writes each channel straight into its CHW tensor plane
+    at::Tensor imgt = torch::empty(
+        { static_cast<int64_t>(nchannels), height, width }, at::kFloat);
+    std::vector<cv::Mat> channels;
+    cv::split(img, channels);
+    for (size_t c = 0; c < nchannels; c++)
+      {
+        double alpha = inputc->_scale;
+        double beta = 0.0;
+        if (!inputc->_mean.empty())
+          beta = -inputc->_mean.at(c);
+        if (!inputc->_std.empty())
+          {
+            alpha /= inputc->_std.at(c);
+            beta /= inputc->_std.at(c);
+          }
+        cv::Mat plane(height, width, CV_32FC1,
+                      imgt.data_ptr<float>() + c * height * width);
+        channels.at(c).convertTo(plane, CV_32F, alpha, beta);
+      }
 
     return imgt;
   }
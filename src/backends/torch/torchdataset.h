@@ -37,7 +37,13 @@
 #include "torchutils.h"
 
 #include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
 #include <random>
+#include <thread>
 
 namespace dd
 {
@@ -46,6 +52,64 @@ namespace dd
                                std::vector<at::Tensor>>
       TorchBatch;
 
+  typedef std::vector<std::pair<std::string, std::string>>
+      TorchDbRecords; /**< raw data & target values read from db. */
+
+  class TorchDataset;
+
+  /**
+   * \brief window over a time series, as data and target views
+   */
+  struct TorchSeriesWindow
+  {
+    int64_t _series;       /**< series index in dataset. */
+    int64_t _data_start;   /**< first data timestep. */
+    int64_t _data_len;     /**< number of data timesteps. */
+    int64_t _target_start; /**< first target timestep. */
+    int64_t _target_len;   /**< number of target timesteps, 0 if none. */
+  };
+
+  /**
+   * \brief prepares db batches ahead of training: a reader thread fetches
+   * raw records from the db, worker threads decode, augment and
+   * stack them into a bounded ring of ready batches, served in order
+   */
+  class TorchDbPrefetcher
+  {
+  public:
+    TorchDbPrefetcher(TorchDataset *dataset, const size_t &batch_size,
+                      std::vector<int64_t> ids, const int &workers,
+                      const int &capacity, const long &seed);
+
+    ~TorchDbPrefetcher();
+
+    /**
+     * \brief next ready batch, waits for it if needed
+     */
+    c10::optional<TorchBatch> next();
+
+  private:
+    void read_loop();
+    void decode_loop(const int &worker);
+
+    TorchDataset *_dataset; /**< dataset owning the db. */
+    size_t _batch_size;
+    std::vector<int64_t> _ids; /**< db samples, in reading order. */
+    int64_t _nbatches;
+    int64_t _capacity; /**< max batches read ahead of the consumer. */
+    long _seed;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::pair<int64_t, TorchDbRecords>>
+        _raw; /**< batches read, not yet decoded. */
+    std::map<int64_t, TorchBatch> _ready; /**< decoded batches, by rank. */
+    int64_t _next_out = 0;                /**< rank of next served batch. */
+    bool _stop = false;
+    std::exception_ptr _eptr; /**< first reader or worker error. */
+    std::vector<std::thread> _threads;
+  };
+
   /**
    * \brief dede torch dataset wrapper
    * allows reading from db, controllable randomness ...
@@ -68,14 +132,20 @@ namespace dd
 
   public:
     bool _shuffle = false;           /**< shuffle dataset upon reset() */
+    int _shuffle_block = 0; /**< db samples shuffled as contiguous blocks */
     std::shared_ptr<db::DB> _dbData; /**< db data */
-    db::Cursor *_dbCursor = nullptr; /**< db cursor */
-    std::vector<int64_t> _indices;   /**< id/key  of data points */
+    std::vector<std::string>
+        _db_keys; /**< key prefix of every db sample, in db order */
+    std::vector<int64_t> _indices; /**< id/key  of data points */
     std::vector<std::pair<std::string, std::vector<double>>>
         _lfiles; /**< list of files */
 
     std::vector<TorchBatch> _batches; /**< Vector containing the whole dataset
                                          (the "cached data") */
+    std::vector<std::pair<at::Tensor, at::Tensor>>
+        _series; /**< data & target time series, may share storage */
+    std::vector<TorchSeriesWindow>
+        _windows; /**< windows over _series, built on demand as batches */
     std::string _dbFullName;          /**< db filename */
     InputConnectorStrategy *_inputc
         = nullptr;               /**< back ptr to input connector. */
@@ -84,6 +154,11 @@ namespace dd
     bool _image = false;                /**< whether an image dataset. */
     TorchImgRandAugCV _img_rand_aug_cv; /**< image data augmentation policy. */
 
+    int _prefetch_workers = 0; /**< db decoding threads, 0 reads serially. */
+    int _prefetch_batches = 2; /**< db batches prepared ahead. */
+    std::shared_ptr<TorchDbPrefetcher>
+        _prefetcher; /**< current epoch prefetcher, never shared by copies. */
+
     /**
      * \brief empty constructor
      */
@@ -98,11 +173,15 @@ namespace dd
         : _seed(d._seed), _rng(d._rng), _current_index(d._current_index),
           _backend(d._backend), _db(d._db),
           _batches_per_transaction(d._batches_per_transaction), _txn(d._txn),
-          _logger(d._logger), _shuffle(d._shuffle), _dbData(d._dbData),
-          _indices(d._indices), _lfiles(d._lfiles), _batches(d._batches),
+          _logger(d._logger), _shuffle(d._shuffle),
+          _shuffle_block(d._shuffle_block), _dbData(d._dbData),
+          _db_keys(d._db_keys), _indices(d._indices), _lfiles(d._lfiles),
+          _batches(d._batches), _series(d._series), _windows(d._windows),
           _dbFullName(d._dbFullName), _inputc(d._inputc),
           _classification(d._classification), _image(d._image),
-          _img_rand_aug_cv(d._img_rand_aug_cv)
+          _img_rand_aug_cv(d._img_rand_aug_cv),
+          _prefetch_workers(d._prefetch_workers),
+          _prefetch_batches(d._prefetch_batches)
     {
     }
 
@@ -110,8 +189,7 @@ namespace dd
 
     virtual ~TorchDataset()
     {
-      if (_dbCursor)
-        delete _dbCursor;
+      _prefetcher.reset(); // stops threads before the db goes away
     }
 
     /**
@@ -120,6 +198,18 @@ namespace dd
     void add_batch(const std::vector<at::Tensor> &data,
                    const std::vector<at::Tensor> &target = {});
 
+    /**
+     * \brief add a time series, stored once, timesteps along first dim
+     * @return series index, for add_window
+     */
+    int64_t add_series(const at::Tensor &data, const at::Tensor &target);
+
+    /**
+     * \brief add a window over series #series, as a sample. Windows are
+     * sliced when batched, or written at once to db.
+     */
+    void add_window(const TorchSeriesWindow &window);
+
     /**
      * \brief add an encoded image to a batch, with an int target
      */
@@ -138,6 +228,11 @@ namespace dd
      */
     void reset(bool shuffle = true, db::Mode dbmode = db::READ);
 
+    /**
+     * \brief indexes db sample keys, for random access reads
+     */
+    void build_db_keys();
+
     /**
      * \brief setter for _shuffle
      */
@@ -146,6 +241,14 @@ namespace dd
       _shuffle = shuf;
     }
 
+    /**
+     * \brief setter for _shuffle_block, 0 shuffles db samples individually
+     */
+    void set_shuffle_block(const int &block)
+    {
+      _shuffle_block = block;
+    }
+
     /**
      * \brief setter for _seed & reinitialize random number generator
      */
@@ -168,7 +271,7 @@ namespace dd
      */
     size_t cache_size() const
     {
-      return _batches.size();
+      return _windows.empty() ? _batches.size() : _windows.size();
     }
 
     /**
@@ -255,6 +358,27 @@ namespace dd
      */
     void add_db_elt(int64_t index, std::string data, std::string target);
 
+    /**
+     * \brief setter for db batches prefetching
+     */
+    void set_prefetch(const int &workers, const int &batches)
+    {
+      _prefetch_workers = workers;
+      _prefetch_batches = batches;
+    }
+
+    /**
+     * \brief reads data & target values of db sample #id (in key order)
+     */
+    void read_db_elt(const int64_t &id, std::string &datas,
+                     std::string &targets);
+
+    /**
+     * \brief decodes raw db values into a batch, possibly augmented
+     */
+    TorchBatch decode_db_batch(const TorchDbRecords &records,
+                               TorchImgRandAugCV &img_rand_aug_cv);
+
     /*-- list --*/
 
     /**
@@ -21,12 +21,12 @@
 
 #include "torchgraphbackend.h"
 #include "mllibstrategy.h"
+#include "torchquantize.h"
 
 namespace dd
 {
   using torch::Tensor;
   using torch::nn::AnyModule;
-  using torch::nn::Linear;
   using torch::nn::LinearOptions;
   using torch::nn::LSTM;
   using torch::nn::LSTMOptions;
@@ -255,9 +255,9 @@ namespace dd
           {
             // dim(v,0,2) is 2nd dimension of input 0 of v, ie datadim for
             // lstm output
-            Linear m = register_module(
-                opname,
-                Linear(LinearOptions(dim(v, 0, 2), num_output(v)).bias(true)));
+            QLinear m = register_module(
+                opname, QLinear(LinearOptions(dim(v, 0, 2), num_output(v))
+                                    .bias(true)));
             _modules[opname] = AnyModule(m);
             _graph[v].alloc_needed = false;
             _allocation_done = true;
@@ -44,7 +44,12 @@ namespace dd
       {
         std::uniform_int_distribution<int64_t> index_distrib(
             0, _dataset._indices.size() - 1);
-        int64_t index = _dataset._indices[index_distrib(rng)];
+        // ids are drawn without replacement, as popped samples leave the db
+        int64_t pos = index_distrib(rng);
+        int64_t index
+            = std::stoll(_dataset._db_keys.at(_dataset._indices[pos]));
+        _dataset._indices[pos] = _dataset._indices.back();
+        _dataset._indices.pop_back();
         std::string data;
         std::string target;
         _dataset.pop_db_elt(index, data, target);
@@ -866,50 +871,39 @@ namespace dd
       }
   }
 
+  at::Tensor
+  CSVTSTorchInputFileConn::seq_to_tensor(const std::vector<CSVline> &seq,
+                                         const std::vector<int> &columns)
+  {
+    at::Tensor series
+        = torch::empty({ static_cast<long int>(seq.size()),
+                         static_cast<long int>(columns.size()) },
+                       torch::kFloat32);
+    float *ptr = series.data_ptr<float>();
+    for (const CSVline &line : seq)
+      for (int c : columns)
+        *ptr++ = line._v[c];
+    return series;
+  }
+
   void CSVTSTorchInputFileConn::add_data_instance_forecast(
       const unsigned long int tstart, const int vecindex,
-      TorchDataset &dataset, const std::vector<CSVline> &seq)
+      TorchDataset &dataset, const int64_t series, const size_t seq_size)
   {
-    std::vector<at::Tensor> data_sequence;
     if (_fnames.size() > static_cast<unsigned int>(vecindex))
       _ids.push_back(_fnames[vecindex] + " #" + std::to_string(tstart) + "_"
                      + std::to_string(tstart + _forecast_timesteps
                                       + _backcast_timesteps - 1));
-    for (size_t ti = tstart; ti < tstart + _backcast_timesteps; ++ti)
-      {
-        std::vector<double> datavec;
-        for (int di = 0; di < this->_datadim; ++di)
-          datavec.push_back(seq[ti]._v[di]);
-        at::Tensor data
-            = torch::from_blob(&datavec[0], at::IntList{ _datadim },
-                               torch::kFloat64)
-                  .clone()
-                  .to(torch::kFloat32);
-        data_sequence.push_back(data);
-      }
-    at::Tensor dst = torch::stack(data_sequence);
 
-    if (seq.size() >= _backcast_timesteps + _forecast_timesteps + tstart)
-      {
-        std::vector<at::Tensor> pred_sequence;
-        for (size_t ti = tstart + _backcast_timesteps;
-             ti < tstart + _backcast_timesteps + _forecast_timesteps; ++ti)
-          {
-            std::vector<double> predvec;
-            for (int di = 0; di < this->_datadim; ++di)
-              predvec.push_back(seq[ti]._v[di]);
-            at::Tensor pred
-                = torch::from_blob(&predvec[0], at::IntList{ _datadim },
-                                   torch::kFloat64)
-                      .clone()
-                      .to(torch::kFloat32);
-            pred_sequence.push_back(pred);
-          }
-        at::Tensor pst = torch::stack(pred_sequence);
-        dataset.add_batch({ dst }, { pst });
-      }
-    else // we are in inference mode, not forecast available
-      dataset.add_batch({ dst }, {});
+    TorchSeriesWindow window{ series, static_cast<int64_t>(tstart),
+                              _backcast_timesteps,
+                              static_cast<int64_t>(tstart)
+                                  + _backcast_timesteps,
+                              0 };
+    // in inference mode, no forecast may be available
+    if (seq_size >= _backcast_timesteps + _forecast_timesteps + tstart)
+      window._target_len = _forecast_timesteps;
+    dataset.add_window(window);
   }
 
   void CSVTSTorchInputFileConn::discard_warn(int vecindex,
@@ -951,6 +945,8 @@ namespace dd
       int test_id)
   {
     int vecindex = -1;
+    std::vector<int> columns(_datadim);
+    std::iota(columns.begin(), columns.end(), 0);
 
     for (const std::vector<CSVline> &seq : data)
       {
@@ -967,55 +963,37 @@ namespace dd
           {
             _tilogger->info("Add sequence of size {}", seq.size());
           }
+        // series is stored once, as both data and target
+        at::Tensor st = seq_to_tensor(seq, columns);
+        int64_t series = dataset.add_series(st, st);
         for (; tstart + timesteps < static_cast<long int>(seq.size());
              tstart += _offset)
           {
-            add_data_instance_forecast(tstart, vecindex, dataset, seq);
+            add_data_instance_forecast(tstart, vecindex, dataset, series,
+                                       seq.size());
           }
         if (tstart < static_cast<long int>(seq.size()) - 1)
           add_data_instance_forecast(seq.size() - timesteps, vecindex, dataset,
-                                     seq);
+                                     series, seq.size());
       }
   }
 
-  void
-  CSVTSTorchInputFileConn::add_seq(const size_t ti,
-                                   const std::vector<CSVline> &seq,
-                                   std::vector<at::Tensor> &data_sequence,
-                                   std::vector<at::Tensor> &label_sequence)
+  void CSVTSTorchInputFileConn::add_data_instance_labels(
+      const unsigned long int tstart, const int vecindex,
+      TorchDataset &dataset, const int64_t series, const size_t seq_len)
   {
-    std::vector<double> datavec;
-    std::vector<double> labelvec;
-    size_t label_size = _label_pos.size();
-    size_t data_size = _datadim - label_size;
+    if (_fnames.size() > static_cast<unsigned int>(vecindex))
+      _ids.push_back(_fnames[vecindex] + " #" + std::to_string(tstart) + "_"
+                     + std::to_string(tstart + seq_len - 1));
 
-    for (size_t li = 0; li < label_size; ++li)
-      labelvec.push_back(seq[ti]._v[_label_pos[li]]);
-    for (int di = 0; di < this->_datadim; ++di)
-      if (std::find(_label_pos.begin(), _label_pos.end(), di)
-          == _label_pos.end())
-        datavec.push_back(seq[ti]._v[di]);
-
-    at::Tensor data
-        = torch::from_blob(&datavec[0],
-                           at::IntList{ static_cast<long int>(data_size) },
-                           torch::kFloat64)
-              .clone()
-              .to(torch::kFloat32);
-    at::Tensor label
-        = torch::from_blob(&labelvec[0],
-                           at::IntList{ static_cast<long int>(label_size) },
-                           torch::kFloat64)
-              .clone()
-              .to(torch::kFloat32);
-    data_sequence.push_back(data);
-    label_sequence.push_back(label);
+    int64_t len = static_cast<int64_t>(seq_len);
+    dataset.add_window({ series, static_cast<int64_t>(tstart), len,
+                         static_cast<int64_t>(tstart), len });
   }
 
-  void CSVTSTorchInputFileConn::add_data_instance_labels(
-      const unsigned long int tstart, const int vecindex,
-      TorchDataset &dataset, const std::vector<CSVline> &seq,
-      const size_t seq_len)
+  void CSVTSTorchInputFileConn::fill_dataset_labels(
+      TorchDataset &dataset, const std::vector<std::vector<CSVline>> &data,
+      int test_id)
   {
     unsigned int label_size = _label_pos.size();
     if (static_cast<int>(label_size) >= _datadim)
@@ -1027,54 +1005,43 @@ namespace dd
         this->_logger->error(errmsg);
         throw InputConnectorBadParamException(errmsg);
       }
-    std::vector<at::Tensor> data_sequence;
-    std::vector<at::Tensor> label_sequence;
-    if (_fnames.size() > static_cast<unsigned int>(vecindex))
-      _ids.push_back(_fnames[vecindex] + " #" + std::to_string(tstart) + "_"
-                     + std::to_string(tstart + seq_len - 1));
-
-    for (size_t ti = tstart;
-         ti < static_cast<unsigned long int>(tstart + seq_len); ++ti)
-      add_seq(ti, seq, data_sequence, label_sequence);
-
-    at::Tensor dst = torch::stack(data_sequence);
-    at::Tensor lst = torch::stack(label_sequence);
-    dataset.add_batch({ dst }, { lst });
-  }
+    std::vector<int> data_columns;
+    for (int di = 0; di < this->_datadim; ++di)
+      if (std::find(_label_pos.begin(), _label_pos.end(), di)
+          == _label_pos.end())
+        data_columns.push_back(di);
 
-  void CSVTSTorchInputFileConn::fill_dataset_labels(
-      TorchDataset &dataset, const std::vector<std::vector<CSVline>> &data,
-      int test_id)
-  {
     int vecindex = -1;
 
-    if (_train)
+    for (const std::vector<CSVline> &seq : data)
       {
-        for (const std::vector<CSVline> &seq : data)
+        vecindex++;
+        if (_train && static_cast<long int>(seq.size()) < _timesteps)
           {
-            vecindex++;
-            long int tstart = 0;
-            if (static_cast<long int>(seq.size()) < _timesteps)
-              {
-                discard_warn(vecindex, seq.size(), test_id);
-                continue;
-              }
-            for (; tstart + _timesteps < static_cast<long int>(seq.size());
-                 tstart += _offset)
-              add_data_instance_labels(tstart, vecindex, dataset, seq,
-                                       static_cast<unsigned int>(_timesteps));
-            if (tstart < static_cast<long int>(seq.size()) - 1)
-              add_data_instance_labels(seq.size() - _timesteps, vecindex,
-                                       dataset, seq,
-                                       static_cast<unsigned int>(_timesteps));
+            discard_warn(vecindex, seq.size(), test_id);
+            continue;
+          }
+
+        // inputs and labels are stored once, windows are views on them
+        int64_t series = dataset.add_series(seq_to_tensor(seq, data_columns),
+                                            seq_to_tensor(seq, _label_pos));
+
+        if (!_train) // do not split
+          {
+            add_data_instance_labels(0, vecindex, dataset, series, seq.size());
+            continue;
           }
+
+        long int tstart = 0;
+        for (; tstart + _timesteps < static_cast<long int>(seq.size());
+             tstart += _offset)
+          add_data_instance_labels(tstart, vecindex, dataset, series,
+                                   static_cast<unsigned int>(_timesteps));
+        if (tstart < static_cast<long int>(seq.size()) - 1)
+          add_data_instance_labels(seq.size() - _timesteps, vecindex, dataset,
+                                   series,
+                                   static_cast<unsigned int>(_timesteps));
       }
-    else // do not split
-      for (const std::vector<CSVline> &seq : data)
-        {
-          vecindex++;
-          add_data_instance_labels(0, vecindex, dataset, seq, seq.size());
-        }
   }
 
   void CSVTSTorchInputFileConn::fill_dataset(
@@ -596,18 +596,21 @@ namespace dd
                                int test_id);
     void add_data_instance_forecast(const unsigned long int tstart,
                                     const int vecindex, TorchDataset &dataset,
-                                    const std::vector<CSVline> &seq);
+                                    const int64_t series,
+                                    const size_t seq_size);
     void fill_dataset_labels(TorchDataset &dataset,
                              const std::vector<std::vector<CSVline>> &data,
                              int test_id);
     void add_data_instance_labels(const unsigned long int tstart,
                                   const int vecindex, TorchDataset &dataset,
-                                  const std::vector<CSVline> &seq,
-                                  size_t seq_len);
+                                  const int64_t series, size_t seq_len);
 
-    void add_seq(const size_t ti, const std::vector<CSVline> &seq,
-                 std::vector<at::Tensor> &data_sequence,
-                 std::vector<at::Tensor> &label_sequence);
+    /**
+     * \brief copy columns of a sequence into a [timesteps, columns]
+     * float32 tensor
+     */
+    at::Tensor seq_to_tensor(const std::vector<CSVline> &seq,
+                             const std::vector<int> &columns);
 
     void discard_warn(int vecindex, unsigned int seq_size, int test_id);
 
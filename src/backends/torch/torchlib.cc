@@ -37,6 +37,7 @@
 
 #include "native/native.h"
 #include "torchsolver.h"
+#include "torchdataparallel.h"
 #include "torchutils.h"
 
 using namespace torch;
@@ -145,6 +146,8 @@ namespace dd
     bool gpu = false;
     std::vector<int> gpuids;
     bool freeze_traced = false;
+    bool inference_only = false;
+    std::string quantize_mode;
     int embedding_size = 768;
     std::string self_supervised = "";
 
@@ -183,6 +186,34 @@ namespace dd
       _finetuning = lib_ad.get("finetuning").get<bool>();
     if (lib_ad.has("freeze_traced"))
       freeze_traced = lib_ad.get("freeze_traced").get<bool>();
+    if (lib_ad.has("inference_only"))
+      inference_only = lib_ad.get("inference_only").get<bool>();
+    if (lib_ad.has("quantize"))
+      {
+        quantize_mode = lib_ad.get("quantize").get<std::string>();
+        if (quantize_mode != "dynamic" && quantize_mode != "static")
+          throw MLLibBadParamException("unknown quantize mode "
+                                       + quantize_mode
+                                       + ", use dynamic or static");
+        if (gpu)
+          throw MLLibBadParamException(
+              "int8 quantization is available on CPU only");
+      }
+    if (lib_ad.has("datatype"))
+      {
+        std::string datatype = lib_ad.get("datatype").get<std::string>();
+        if (datatype == "bf16")
+          _module._dtype = torch::kBFloat16;
+        else if (datatype != "fp32")
+          throw MLLibBadParamException("unknown datatype " + datatype
+                                       + ", use fp32 or bf16");
+        if (_module._dtype != torch::kFloat32 && gpu)
+          throw MLLibBadParamException(
+              "bf16 datatype is available on CPU only");
+        if (_module._dtype != torch::kFloat32 && !quantize_mode.empty())
+          throw MLLibBadParamException(
+              "bf16 datatype cannot be combined with int8 quantization");
+      }
     if (lib_ad.has("loss"))
       _loss = lib_ad.get("loss").get<std::string>();
     if (lib_ad.has("template_params"))
@@ -342,19 +373,191 @@ namespace dd
     // Load weights
     _module.load(this->_mlmodel);
     _module.freeze_traced(freeze_traced);
+    if (_module._dtype != torch::kFloat32)
+      {
+        // nets allocated at first train or predict call are cast then
+        _module.to(_module._dtype);
+        this->_logger->info("weights and inputs in {}",
+                            c10::toString(_module._dtype));
+      }
+
+    // predict calls share the module read-only, so that they can run
+    // concurrently: it is only switched to train mode by training calls
+    _module.eval();
+
+    if (!quantize_mode.empty())
+      quantize(quantize_mode, lib_ad);
+    if (inference_only)
+      _module.freeze_for_inference();
+    if (lib_ad.has("warmup"))
+      warmup(lib_ad.getobj("warmup"));
 
     _best_metrics = { "map", "meaniou",  "mlacc", "delta_score_0.1", "bacc",
                       "f1",  "net_meas", "acc",   "L1_mean_error",   "eucll" };
     _best_metric_values.resize(1, std::numeric_limits<double>::infinity());
   }
 
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
+            class TMLModel>
+  void TorchLib<TInputConnectorStrategy, TOutputConnectorStrategy,
+                TMLModel>::warmup(const APIData &ad_warmup)
+  {
+    int iterations = 2; // profiling run, then optimized run
+    if (ad_warmup.has("iterations"))
+      iterations = ad_warmup.get("iterations").get<int>();
+    std::vector<int> batch_sizes = { 1 };
+    if (ad_warmup.has("batch_size"))
+      {
+        if (ad_warmup.get("batch_size").is<int>())
+          batch_sizes = { ad_warmup.get("batch_size").get<int>() };
+        else
+          batch_sizes = ad_warmup.get("batch_size").get<std::vector<int>>();
+      }
+
+    std::vector<std::vector<Tensor>> samples
+        = sample_inputs(ad_warmup, "warmup");
+
+    torch_utils::InferenceGuard inference_guard;
+    for (int bs : batch_sizes)
+      {
+        std::vector<c10::IValue> in_vals = batch_inputs(samples, 0, bs);
+        for (int i = 0; i < iterations; ++i)
+          {
+            try
+              {
+                _module.forward(in_vals);
+              }
+            catch (std::exception &e)
+              {
+                throw MLLibInternalException(std::string("Libtorch error:")
+                                             + e.what());
+              }
+          }
+        this->_logger->info("warmup done with batch size {}", bs);
+      }
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
+            class TMLModel>
+  void TorchLib<TInputConnectorStrategy, TOutputConnectorStrategy,
+                TMLModel>::quantize(const std::string &mode,
+                                    const APIData &lib_ad)
+  {
+    if (mode == "dynamic")
+      {
+        _module.quantize_dynamic();
+        return;
+      }
+    if (!_module._traced)
+      throw MLLibBadParamException(
+          "static quantization requires a traced model");
+
+    // calibrated model from a previous service creation, unless the float
+    // model was updated in between
+    const std::string &quantized = this->_mlmodel._quantized;
+    if (!quantized.empty()
+        && (this->_mlmodel._traced.empty()
+            || fileops::file_last_modif(quantized)
+                   >= fileops::file_last_modif(this->_mlmodel._traced)))
+      {
+        _module.load_quantized(quantized);
+        return;
+      }
+
+    if (!lib_ad.has("calibration"))
+      throw MLLibBadParamException(
+          "static quantization requires calibration data");
+    const APIData &ad_calib = lib_ad.getobj("calibration");
+    int batch_size = 1;
+    if (ad_calib.has("batch_size"))
+      batch_size = std::max(1, ad_calib.get("batch_size").get<int>());
+    std::vector<std::vector<Tensor>> samples
+        = sample_inputs(ad_calib, "calibration");
+
+    _module.prepare_static_quantization();
+    {
+      // observers record activation ranges over calibration batches
+      torch::NoGradGuard no_grad;
+      for (size_t s = 0; s < samples.size(); s += batch_size)
+        {
+          int bs = std::min(static_cast<size_t>(batch_size),
+                            samples.size() - s);
+          try
+            {
+              _module.forward(batch_inputs(samples, s, bs));
+            }
+          catch (std::exception &e)
+            {
+              throw MLLibInternalException(std::string("Libtorch error:")
+                                           + e.what());
+            }
+        }
+    }
+    this->_logger->info("calibrated static quantization on {} samples",
+                        samples.size());
+
+    std::string path = this->_mlmodel._traced;
+    path = path.substr(0, path.rfind(".pt")) + ".qpt";
+    _module.convert_static_quantization(path);
+    this->_mlmodel._quantized = path;
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
+            class TMLModel>
+  std::vector<std::vector<Tensor>>
+  TorchLib<TInputConnectorStrategy, TOutputConnectorStrategy,
+           TMLModel>::sample_inputs(const APIData &ad_samples,
+                                    const std::string &what)
+  {
+    if (!ad_samples.has("data"))
+      throw MLLibBadParamException(what + " requires sample data");
+
+    // samples go through the input connector, so that they have the
+    // declared input shapes
+    APIData ad;
+    ad.add("data", ad_samples.get("data").get<std::vector<std::string>>());
+    TInputConnectorStrategy inputc(this->_inputc);
+    inputc.transform(ad);
+    _module.post_transform_predict(_template, _template_params, inputc,
+                                   this->_mlmodel, _main_device);
+
+    std::vector<std::vector<Tensor>> samples;
+    inputc._dataset.reset(false);
+    auto dataloader = torch::data::make_data_loader(
+        std::move(inputc._dataset), data::DataLoaderOptions(1));
+    for (TorchBatch batch : *dataloader)
+      samples.push_back(batch.data);
+    if (samples.empty())
+      throw MLLibBadParamException(what + " data yields no input");
+    return samples;
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
+            class TMLModel>
+  std::vector<c10::IValue>
+  TorchLib<TInputConnectorStrategy, TOutputConnectorStrategy,
+           TMLModel>::batch_inputs(const std::vector<std::vector<Tensor>>
+                                       &samples,
+                                   const size_t &start, const int &bs)
+  {
+    std::vector<c10::IValue> in_vals;
+    for (size_t k = 0; k < samples.at(0).size(); ++k)
+      {
+        std::vector<Tensor> batch;
+        for (int b = 0; b < bs; ++b)
+          batch.push_back(samples.at((start + b) % samples.size()).at(k));
+        in_vals.push_back(torch::cat(batch).to(_main_device));
+      }
+    return in_vals;
+  }
+
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
             class TMLModel>
   void TorchLib<TInputConnectorStrategy, TOutputConnectorStrategy,
                 TMLModel>::clear_mllib(__attribute__((unused))
                                        const APIData &ad)
   {
-    std::vector<std::string> extensions{ ".json", ".pt", ".ptw" };
+    std::vector<std::string> extensions{ ".json", ".pt", ".ptw", ".qpt" };
     fileops::remove_directory_files(this->_mlmodel._repo, extensions);
     this->_logger->info("Torchlib service cleared");
   }
@@ -475,20 +678,88 @@ namespace dd
                  + ".pt");
   }
 
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
+            class TMLModel>
+  Tensor TorchLib<TInputConnectorStrategy, TOutputConnectorStrategy,
+                  TMLModel>::compute_loss(NativeModule *native,
+                                          const std::vector<c10::IValue>
+                                              &in_vals,
+                                          const Tensor &y_pred,
+                                          const Tensor &y,
+                                          const Tensor &class_weights)
+  {
+    // As CrossEntropy is not available (Libtorch 1.1) we use
+    // nllloss
+    // + log_softmax
+    if (_seq_training)
+      {
+        // Convert [n_batch, sequence_length, vocab_size] to
+        // [n_batch
+        // * sequence_length, vocab_size]
+        // + ignore non-masked tokens (== -1 in target)
+        return torch::nll_loss(
+            torch::log_softmax(y_pred.view(IntList{ -1, y_pred.size(2) }),
+                               1),
+            y.view(IntList{ -1 }), class_weights, Reduction::Mean, -1);
+      }
+    else if (_timeserie)
+      {
+        if (native != nullptr)
+          return native->loss(_loss, in_vals[0].toTensor(), y_pred, y);
+        if (_loss.empty() || _loss == "L1" || _loss == "l1")
+          return torch::l1_loss(y_pred, y);
+        else if (_loss == "L2" || _loss == "l2" || _loss == "eucl")
+          return torch::mse_loss(y_pred, y);
+        throw MLLibBadParamException("unknown loss " + _loss);
+      }
+    else if (_regression)
+      {
+        if (_loss.empty() || _loss == "L1" || _loss == "l1")
+          return torch::l1_loss(y_pred, y);
+        else if (_loss == "L2" || _loss == "l2" || _loss == "eucl")
+          return torch::mse_loss(y_pred, y);
+        throw MLLibBadParamException("unknown loss " + _loss);
+      }
+    else if (_classification)
+      {
+        return torch::nll_loss(torch::log_softmax(y_pred, 1),
+                               y.view(IntList{ -1 }), class_weights);
+      }
+    throw MLLibBadParamException("unexpected model type");
+  }
+
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
             class TMLModel>
   int TorchLib<TInputConnectorStrategy, TOutputConnectorStrategy,
                TMLModel>::train(const APIData &ad, APIData &out)
   {
     using namespace std::chrono;
+    if (_module._inference_only)
+      throw MLLibBadParamException(
+          "service was created inference_only or quantized and cannot be "
+          "trained");
     this->_tjob_running.store(true);
 
+    // whatever the outcome, hand the module back to predict calls in eval
+    // mode
+    struct EvalOnExit
+    {
+      TorchModule &_module;
+      ~EvalOnExit()
+      {
+        _module.eval();
+      }
+    } eval_on_exit{ _module };
+
     TInputConnectorStrategy inputc(this->_inputc);
     inputc._train = true;
 
     APIData ad_input = ad.getobj("parameters").getobj("input");
     if (ad_input.has("shuffle"))
       inputc._dataset.set_shuffle(ad_input.get("shuffle").get<bool>());
+    if (ad_input.has("shuffle_block"))
+      inputc._dataset.set_shuffle_block(
+          ad_input.get("shuffle_block").get<int>());
     inputc._dataset._classification = inputc._test_datasets._classification
         = _classification;
 
@@ -599,6 +870,10 @@ namespace dd
     bool retain_graph = ad_mllib.has("retain_graph")
                             ? ad_mllib.get("retain_graph").get<bool>()
                             : false;
+    int data_parallel_workers
+        = ad_mllib.has("data_parallel_workers")
+              ? ad_mllib.get("data_parallel_workers").get<int>()
+              : 0;
 
     if (iter_size <= 0)
       iter_size = 1;
@@ -636,7 +911,32 @@ namespace dd
     tsolver.zero_grad();
     _module.train();
 
+    // CPU data-parallel training, on replicas of the module
+    std::unique_ptr<TorchDataParallel> data_parallel;
+    if (data_parallel_workers > 1)
+      {
+        if (_main_device.is_cuda())
+          throw MLLibBadParamException(
+              "data_parallel_workers applies to CPU training, use gpuid "
+              "for multiple GPUs");
+        if (!_module._native)
+          throw MLLibBadParamException(
+              "CPU data-parallel training requires a native template");
+        data_parallel.reset(new TorchDataParallel(
+            _module._native, data_parallel_workers, _module._dtype));
+        this->_logger->info("CPU data-parallel training on {} workers",
+                            data_parallel->size());
+      }
+
     // create dataloader
+    if (ad_mllib.has("dataloader_workers"))
+      {
+        int prefetch_batches = 2;
+        if (ad_mllib.has("dataloader_prefetch"))
+          prefetch_batches = ad_mllib.get("dataloader_prefetch").get<int>();
+        inputc._dataset.set_prefetch(
+            ad_mllib.get("dataloader_workers").get<int>(), prefetch_batches);
+      }
     inputc._dataset.reset();
     auto dataloader = torch::data::make_data_loader(
         inputc._dataset, data::DataLoaderOptions(batch_size));
@@ -674,75 +974,62 @@ namespace dd
             Tensor y = batch.target.at(0).to(_main_device);
 
             Tensor y_pred;
-            try
-              {
-                y_pred = torch_utils::to_tensor_safe(
-                    _module.forward_on_devices(in_vals, _devices));
-              }
-            catch (std::exception &e)
-              {
-                this->_logger->error(std::string("Libtorch error: ")
-                                     + e.what());
-                throw MLLibInternalException(std::string("Libtorch error: ")
-                                             + e.what());
-              }
-
             Tensor loss;
-            // As CrossEntropy is not available (Libtorch 1.1) we use
-            // nllloss
-            // + log_softmax
-            if (_seq_training)
+            double loss_val = 0.0;
+            if (data_parallel)
               {
-                // Convert [n_batch, sequence_length, vocab_size] to
-                // [n_batch
-                // * sequence_length, vocab_size]
-                // + ignore non-masked tokens (== -1 in target)
-                loss = torch::nll_loss(
-                    torch::log_softmax(
-                        y_pred.view(IntList{ -1, y_pred.size(2) }), 1),
-                    y.view(IntList{ -1 }), class_weights, Reduction::Mean, -1);
-              }
-            else if (_timeserie)
-              {
-                if (_module._native != nullptr)
-                  loss = _module._native->loss(_loss, in_vals[0].toTensor(),
-                                               y_pred, y);
-                else
+                try
                   {
-                    if (_loss.empty() || _loss == "L1" || _loss == "l1")
-                      loss = torch::l1_loss(y_pred, y);
-                    else if (_loss == "L2" || _loss == "l2" || _loss == "eucl")
-                      loss = torch::mse_loss(y_pred, y);
-                    else
-                      throw MLLibBadParamException("unknown loss " + _loss);
+                    loss_val = data_parallel->forward_backward(
+                        in_vals, y,
+                        [&](NativeModule &native,
+                            const std::vector<c10::IValue> &shard_in,
+                            const Tensor &shard_pred, const Tensor &shard_y) {
+                          return compute_loss(&native, shard_in, shard_pred,
+                                              shard_y, class_weights)
+                                 / iter_size;
+                        },
+                        retain_graph);
+                  }
+                catch (MLLibBadParamException &e)
+                  {
+                    throw;
+                  }
+                catch (std::exception &e)
+                  {
+                    this->_logger->error(std::string("Libtorch error: ")
+                                         + e.what());
+                    throw MLLibInternalException(
+                        std::string("Libtorch error: ") + e.what());
                   }
-              }
-            else if (_regression)
-              {
-                if (_loss.empty() || _loss == "L1" || _loss == "l1")
-                  loss = torch::l1_loss(y_pred, y);
-                else if (_loss == "L2" || _loss == "l2" || _loss == "eucl")
-                  loss = torch::mse_loss(y_pred, y);
-                else
-                  throw MLLibBadParamException("unknown loss " + _loss);
-              }
-            else if (_classification)
-              {
-                loss = torch::nll_loss(torch::log_softmax(y_pred, 1),
-                                       y.view(IntList{ -1 }), class_weights);
               }
             else
               {
-                throw MLLibBadParamException("unexpected model type");
-              }
-            if (iter_size > 1)
-              loss /= iter_size;
+                try
+                  {
+                    y_pred = torch_utils::to_tensor_safe(
+                        _module.forward_on_devices(in_vals, _devices));
+                  }
+                catch (std::exception &e)
+                  {
+                    this->_logger->error(std::string("Libtorch error: ")
+                                         + e.what());
+                    throw MLLibInternalException(
+                        std::string("Libtorch error: ") + e.what());
+                  }
+
+                loss = compute_loss(_module._native.get(), in_vals, y_pred, y,
+                                    class_weights);
+                if (iter_size > 1)
+                  loss /= iter_size;
 
-            double loss_val = loss.item<double>();
+                loss_val = loss.item<double>();
+                loss.backward(
+                    {},
+                    /*retain_graph=*/c10::optional<bool>(retain_graph),
+                    /*create_graph=*/false);
+              }
             train_loss += loss_val;
-            loss.backward({},
-                          /*retain_graph=*/c10::optional<bool>(retain_graph),
-                          /*create_graph=*/false);
             auto tstop = steady_clock::now();
             last_it_time
                 += duration_cast<milliseconds>(tstop - tstart).count();
@@ -760,6 +1047,8 @@ namespace dd
                   {
                     tsolver.step();
                     tsolver.zero_grad();
+                    if (data_parallel)
+                      data_parallel->sync_replicas();
                   }
                 catch (std::exception &e)
                   {
@@ -970,13 +1259,29 @@ namespace dd
     bool lstm_continuation = false;
     TInputConnectorStrategy inputc(this->_inputc);
 
+    // nets are set up by the first predict calls, while no other predict
+    // call runs, and are then shared read-only by concurrent predict calls
+    boost::shared_lock<boost::shared_mutex> predict_lock(_predict_mutex,
+                                                         boost::defer_lock);
+
     this->_stats.transform_start();
     TOutputConnectorStrategy outputc(this->_outputc);
     try
       {
         inputc.transform(ad);
-        _module.post_transform_predict(_template, _template_params, inputc,
-                                       this->_mlmodel, _main_device, ad);
+        predict_lock.lock();
+        while (!_module.predict_ready(inputc))
+          {
+            predict_lock.unlock();
+            {
+              boost::unique_lock<boost::shared_mutex> setup_lock(
+                  _predict_mutex);
+              _module.post_transform_predict(_template, _template_params,
+                                             inputc, this->_mlmodel,
+                                             _main_device);
+            }
+            predict_lock.lock();
+          }
         if (ad.getobj("parameters").getobj("input").has("continuation")
             && ad.getobj("parameters")
                    .getobj("input")
@@ -985,6 +1290,8 @@ namespace dd
           lstm_continuation = true;
         else
           lstm_continuation = false;
+        if (_module._graph)
+          _module._graph->lstm_continues(lstm_continuation);
       }
     catch (...)
       {
@@ -992,8 +1299,10 @@ namespace dd
       }
     this->_stats.transform_end();
 
+    // no autograd bookkeeping on predict calls
+    torch_utils::InferenceGuard inference_guard;
+
     torch::Device cpu("cpu");
-    _module.eval();
 
     if (!extract_last && !extract_layer.empty()
         && !_module.extractable(extract_layer))
@@ -1085,7 +1394,18 @@ namespace dd
 
         if (!extract_layer.empty())
           {
-            for (int j = 0; j < batch_size; j++)
+            // one float32 copy of the batch output, sliced into one row per
+            // sample, unless the layer output is not batch major
+            int64_t bsize = batch.data[0].size(0);
+            bool per_sample = output.dim() > 0 && output.size(0) == bsize;
+            torch::Tensor fo
+                = (per_sample ? output.reshape({ bsize, -1 })
+                              : output.reshape({ 1, -1 }))
+                      .to(cpu, torch::kFloat)
+                      .contiguous();
+            const float *fo_data = fo.data_ptr<float>();
+            int64_t row_size = fo.size(1);
+            for (int64_t j = 0; j < bsize; j++)
               {
                 APIData rad;
                 if (!inputc._ids.empty())
@@ -1099,17 +1419,9 @@ namespace dd
                   rad.add("index_uri",
                           inputc._index_uris.at(results_ads.size()));
                 rad.add("loss", static_cast<double>(0.0));
-                torch::Tensor fo = torch::flatten(output)
-                                       .contiguous()
-                                       .to(torch::kFloat64)
-                                       .to(torch::Device("cpu"));
-
-                double *startout = fo.data_ptr<double>();
-                std::vector<double> vals(startout,
-                                         startout + torch::numel(fo));
-
-                rad.add("vals", vals);
-                results_ads.push_back(rad);
+                const float *row = fo_data + (per_sample ? j * row_size : 0);
+                rad.add("vals", std::vector<float>(row, row + row_size));
+                results_ads.push_back(std::move(rad));
               }
           }
         else
@@ -1122,23 +1434,32 @@ namespace dd
                 int best_count = _nclasses;
                 if (output_params.has("best"))
                   best_count = output_params.get("best").get<int>();
-                std::tuple<Tensor, Tensor> sorted_output
-                    = output.sort(1, true);
-                Tensor probsf = std::get<0>(sorted_output).to(torch::kFloat);
-                auto probs_acc = probsf.accessor<float, 2>();
-                auto indices_acc
-                    = std::get<1>(sorted_output).accessor<int64_t, 2>();
+                if (best_count < 0 || best_count > output.size(1))
+                  best_count = output.size(1);
+
+                // only the best classes are sorted, rows of the batch are
+                // then read from contiguous float32 buffers
+                std::tuple<Tensor, Tensor> best_output
+                    = output.topk(best_count, 1, true, true);
+                Tensor probsf
+                    = std::get<0>(best_output).to(torch::kFloat).contiguous();
+                Tensor indices = std::get<1>(best_output).contiguous();
+                const float *probs_data = probsf.data_ptr<float>();
+                const int64_t *indices_data = indices.data_ptr<int64_t>();
 
                 for (int i = 0; i < output.size(0); ++i)
                   {
                     APIData results_ad;
-                    std::vector<double> probs;
+                    const float *row_probs = probs_data + i * best_count;
+                    const int64_t *row_indices = indices_data + i * best_count;
+                    std::vector<double> probs(row_probs,
+                                              row_probs + best_count);
                     std::vector<std::string> cats;
+                    cats.reserve(best_count);
 
                     for (int j = 0; j < best_count; ++j)
                       {
-                        probs.push_back(probs_acc[i][j]);
-                        int index = indices_acc[i][j];
+                        int index = row_indices[j];
                         if (_seq_training)
                           {
                             cats.push_back(inputc.get_word(index));
@@ -1151,36 +1472,38 @@ namespace dd
 
                     results_ad.add("uri", inputc._uris.at(results_ads.size()));
                     results_ad.add("loss", 0.0);
-                    results_ad.add("cats", cats);
-                    results_ad.add("probs", probs);
+                    results_ad.add("cats", std::move(cats));
+                    results_ad.add("probs", std::move(probs));
                     results_ad.add("nclasses", (int)_nclasses);
 
-                    results_ads.push_back(results_ad);
+                    results_ads.push_back(std::move(results_ad));
                   }
               }
             else if (_regression)
               {
-                auto probs_acc = output.accessor<float, 2>();
+                Tensor outputf = output.to(torch::kFloat).contiguous();
+                const float *output_data = outputf.data_ptr<float>();
+                int64_t row_size = outputf.size(1);
+
+                // same targets for every sample
+                std::vector<std::string> cats;
+                cats.reserve(_nclasses);
+                for (size_t j = 0; j < _nclasses; ++j)
+                  cats.push_back(this->_mlmodel.get_hcorresp(j));
 
                 for (int i = 0; i < output.size(0); ++i)
                   {
                     APIData results_ad;
-                    std::vector<double> probs;
-                    std::vector<std::string> cats;
-
-                    for (size_t j = 0; j < _nclasses; ++j)
-                      {
-                        probs.push_back(probs_acc[i][j]);
-                        cats.push_back(this->_mlmodel.get_hcorresp(j));
-                      }
+                    const float *row = output_data + i * row_size;
+                    std::vector<double> probs(row, row + _nclasses);
 
                     results_ad.add("uri", inputc._uris.at(results_ads.size()));
                     results_ad.add("loss", 0.0);
                     results_ad.add("cats", cats);
-                    results_ad.add("probs", probs);
+                    results_ad.add("probs", std::move(probs));
                     results_ad.add("nclasses", (int)_nclasses);
 
-                    results_ads.push_back(results_ad);
+                    results_ads.push_back(std::move(results_ad));
                   }
               }
             else if (_timeserie)
@@ -1199,24 +1522,25 @@ namespace dd
                             preds.push_back(unscale(res, k, inputc));
                           }
                         APIData ts;
-                        ts.add("out", preds);
-                        series.push_back(ts);
+                        ts.add("out", std::move(preds));
+                        series.push_back(std::move(ts));
                       }
                     APIData result_ad;
                     if (!inputc._ids.empty())
                       result_ad.add("uri", inputc._ids.at(nsample++));
                     else
                       result_ad.add("uri", std::to_string(nsample++));
-                    result_ad.add("series", series);
-                    result_ad.add("probs",
-                                  std::vector<double>(series.size(), 1.0));
+                    size_t nseries = series.size();
+                    result_ad.add("series", std::move(series));
+                    result_ad.add("probs", std::vector<double>(nseries, 1.0));
                     result_ad.add("loss", 0.0);
-                    results_ads.push_back(result_ad);
+                    results_ads.push_back(std::move(result_ad));
                   }
               }
           }
       }
 
+    this->_stats.output_start();
     if (extract_layer.empty())
       {
         outputc.add_results(results_ads);
@@ -1236,6 +1560,7 @@ namespace dd
         unsupo.finalize(ad.getobj("parameters").getobj("output"), out,
                         static_cast<MLModel *>(&this->_mlmodel));
       }
+    this->_stats.output_end();
     out.add("status", 0);
     return 0;
   }
@@ -1282,7 +1607,11 @@ namespace dd
         dataset, data::DataLoaderOptions(batch_size));
     torch::Device cpu("cpu");
 
-    _module.eval();
+    // predict calls share the module in eval mode, only training calls get
+    // it back in train mode
+    bool training = _module.is_training();
+    if (training)
+      _module.eval();
     int entry_id = 0;
     for (TorchBatch batch : *dataloader)
       {
@@ -1412,7 +1741,8 @@ namespace dd
     ad_res.add("batch_size",
                entry_id); // here batch_size = tested entries count
     SupervisedOutput::measure(ad_res, ad_out, out, test_id, test_name);
-    _module.train();
+    if (training)
+      _module.train();
     return 0;
   }
 
@@ -24,6 +24,7 @@
 #define TORCHLIB_H
 
 #include <random>
+#include <boost/thread/shared_mutex.hpp>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -107,12 +108,56 @@ namespace dd
 
     TorchModule _module; /**< wrapper around different underlyng
                             implementations (traced/native/graph...)*/
+    boost::shared_mutex
+        _predict_mutex; /**< shared by predict calls, held exclusively while
+                           nets are set up for them */
 
     std::vector<std::string>
         _best_metrics; /**< metric to use for saving best model */
     std::vector<double> _best_metric_values; /**< best metric values  */
 
   private:
+    /**
+     * \brief runs forward passes on sample data at service creation, so that
+     * the first predict calls do not pay for graph profiling and optimization
+     * @param ad_warmup warm-up parameters: `data`, `iterations`, `batch_size`
+     */
+    void warmup(const APIData &ad_warmup);
+
+    /**
+     * \brief training loss of a batch, according to the model type
+     * @param native native module that computed y_pred, if any
+     */
+    torch::Tensor compute_loss(NativeModule *native,
+                               const std::vector<c10::IValue> &in_vals,
+                               const torch::Tensor &y_pred,
+                               const torch::Tensor &y,
+                               const torch::Tensor &class_weights);
+
+    /**
+     * \brief quantizes the net to int8 for CPU inference
+     * @param mode "dynamic" for linear layers, or "static" for a traced net
+     * calibrated on `calibration` data, or read from a previous calibration
+     */
+    void quantize(const std::string &mode, const APIData &lib_ad);
+
+    /**
+     * \brief reads sample data through the input connector, one input
+     * tensors vector per sample
+     * @param ad_samples object with a `data` array
+     * @param what name of samples purpose, for errors
+     */
+    std::vector<std::vector<torch::Tensor>>
+    sample_inputs(const APIData &ad_samples, const std::string &what);
+
+    /**
+     * \brief concatenates bs samples from start into batch inputs, samples
+     * are repeated to fill the batch if needed
+     */
+    std::vector<c10::IValue>
+    batch_inputs(const std::vector<std::vector<torch::Tensor>> &samples,
+                 const size_t &start, const int &bs);
+
     /**
      * \brief checks wether v1 is better than v2
      */
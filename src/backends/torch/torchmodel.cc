@@ -30,6 +30,7 @@ namespace dd
     const std::string weights = ".ptw";
     const std::string native = ".npt";
     const std::string traced = ".pt";
+    const std::string quantized = ".qpt";
     const std::string corresp = "corresp";
     // solver. may lead to _solver.prototxt when generated from caffe generator
     // we save solver states as solver-##.pt where ## is iteration number
@@ -45,9 +46,10 @@ namespace dd
         return 1;
       }
 
-    std::string tracedf, weightsf, correspf, sstatef, protof, nativef;
+    std::string tracedf, weightsf, correspf, sstatef, protof, nativef,
+        quantizedf;
     int traced_t = -1, weights_t = -1, corresp_t = -1, sstate_t = -1,
-        proto_t = -1, native_t = -1;
+        proto_t = -1, native_t = -1, quantized_t = -1;
 
     for (const auto &file : files)
       {
@@ -76,6 +78,14 @@ namespace dd
                 traced_t = lm;
               }
           }
+        else if (file.find(quantized) != std::string::npos)
+          {
+            if (quantized_t < lm)
+              {
+                quantizedf = file;
+                quantized_t = lm;
+              }
+          }
         else if (file.find(native) != std::string::npos)
           {
             if (native_t < lm)
@@ -108,6 +118,7 @@ namespace dd
     _sstate = sstatef;
     _proto = protof;
     _native = nativef;
+    _quantized = quantizedf;
 
     return 0;
   }
@@ -69,6 +69,7 @@ namespace dd
     std::string _sstate;  /**< current solver state to resume training */
     std::string _proto;   /**< prototxt file generated or read as graph */
     std::string _native;  /**< native torch net */
+    std::string _quantized; /**< statically quantized traced net */
   };
 }
 
@@ -24,6 +24,10 @@
 #include "graph/graph.h"
 #include "native/native.h"
 #include "torchutils.h"
+#include "torchquantize.h"
+
+#include <torch/csrc/jit/passes/fold_conv_bn.h>
+#include <torch/csrc/jit/passes/freeze_module.h>
 
 namespace dd
 {
@@ -49,26 +53,38 @@ namespace dd
   void TorchModule::to(torch::Dtype dtype)
   {
     if (_graph)
-      _graph->to(dtype);
+      torch_utils::to_floating_dtype(*_graph, dtype);
     if (_native)
-      _native->to(dtype);
+      torch_utils::to_floating_dtype(*_native, dtype);
     if (_traced)
-      _traced->to(dtype);
+      torch_utils::to_floating_dtype(*_traced, dtype);
     if (_linear)
-      _linear->to(dtype);
+      torch_utils::to_floating_dtype(*_linear, dtype);
   }
 
   void TorchModule::to(torch::Device device, torch::Dtype dtype)
   {
-    _device = device;
-    if (_graph)
-      _graph->to(device, dtype);
-    if (_native)
-      _native->to(device, dtype);
-    if (_traced)
-      _traced->to(device, dtype);
-    if (_linear)
-      _linear->to(device, dtype);
+    to(device);
+    to(dtype);
+  }
+
+  std::vector<c10::IValue>
+  TorchModule::to_dtype(std::vector<c10::IValue> source) const
+  {
+    if (_dtype == torch::kFloat32)
+      return source;
+    for (c10::IValue &val : source)
+      if (val.isTensor() && val.toTensor().is_floating_point())
+        val = val.toTensor().to(_dtype);
+    return source;
+  }
+
+  c10::IValue TorchModule::to_float(const c10::IValue &out_val) const
+  {
+    if (_dtype == torch::kFloat32 || !out_val.isTensor()
+        || out_val.toTensor().scalar_type() != _dtype)
+      return out_val;
+    return out_val.toTensor().to(torch::kFloat32);
   }
 
   void TorchModule::proto_model_load(const TorchModel &model)
@@ -214,6 +230,8 @@ namespace dd
         graph_model_load(tmodel);
       }
     to(_device);
+    if (_dtype != torch::kFloat32)
+      to(_dtype);
 
     if (_require_linear_layer && !_linear)
       {
@@ -225,7 +243,7 @@ namespace dd
             setup_linear_layer(_nclasses,
                                const_cast<TInputConnectorStrategy &>(inputc)
                                    .get_input_example(device));
-            _linear->to(_device);
+            _linear->to(_device, _dtype);
           }
         catch (std::exception &e)
           {
@@ -242,6 +260,8 @@ namespace dd
                                          const TorchModel &tmodel,
                                          const torch::Device &device)
   {
+    // nets may be reallocated, they are set up again at next predict call
+    _predict_ready = false;
     post_transform(tmpl, template_params, inputc, tmodel, device);
   }
 
@@ -249,31 +269,36 @@ namespace dd
   void TorchModule::post_transform_predict(
       const std::string tmpl, const APIData &template_params,
       const TInputConnectorStrategy &inputc, const TorchModel &tmodel,
-      const torch::Device &device, const APIData &ad)
+      const torch::Device &device)
   {
+    if (predict_ready(inputc))
+      return;
+    bool native_allocated = static_cast<bool>(_native);
     post_transform(tmpl, template_params, inputc, tmodel, device);
-
+    // nets allocated at first predict call, or reallocated, are quantized
+    // once, the others already were at service creation
+    if (_quantized_dynamic
+        && ((!native_allocated && _native)
+            || (_graph && _graph->needs_reload())))
+      quantize_dynamic();
+    eval();
     if (_graph)
-      {
-        if (ad.getobj("parameters").getobj("input").has("continuation")
-            && ad.getobj("parameters")
-                   .getobj("input")
-                   .get("continuation")
-                   .get<bool>())
-          _graph->lstm_continues(true);
-        else
-          _graph->lstm_continues(false);
-      }
+      _predict_dims = inputc._dataset.datasize(0);
+    _predict_ready = true;
   }
 
   c10::IValue TorchModule::forward(std::vector<c10::IValue> source,
                                    const std::string &forward_method)
   {
+    // inputs are cast to the weights datatype, and outputs back to fp32 so
+    // that losses and post-processing run in full precision
+    source = to_dtype(std::move(source));
     // graph and native modules take only one tensor as input for now
     if (_graph)
-      return _graph->forward(torch_utils::to_tensor_safe(source[0]));
+      return to_float(_graph->forward(torch_utils::to_tensor_safe(source[0])));
     if (_native)
-      return _native->forward(torch_utils::to_tensor_safe(source[0]));
+      return to_float(
+          _native->forward(torch_utils::to_tensor_safe(source[0])));
     if (_traced)
       {
         if (!forward_method.empty())
@@ -308,7 +333,7 @@ namespace dd
       {
         out_val = _linear->forward(torch_utils::to_tensor_safe(out_val));
       }
-    return out_val;
+    return to_float(out_val);
   }
 
   c10::IValue
@@ -365,12 +390,13 @@ namespace dd
   c10::IValue TorchModule::extract(std::vector<c10::IValue> source,
                                    std::string extract_layer)
   {
+    source = to_dtype(std::move(source));
     if (_graph) // native modules take only one tensor as input for now
-      return _graph->extract(torch_utils::to_tensor_safe(source[0]),
-                             extract_layer);
+      return to_float(_graph->extract(torch_utils::to_tensor_safe(source[0]),
+                                      extract_layer));
     if (_native)
-      return _native->extract(torch_utils::to_tensor_safe(source[0]),
-                              extract_layer);
+      return to_float(_native->extract(
+          torch_utils::to_tensor_safe(source[0]), extract_layer));
     auto output = _traced->forward(source);
     source = torch_utils::unwrap_c10_vector(output);
 
@@ -384,7 +410,7 @@ namespace dd
         auto &elems = out_val.toTuple()->elements();
         out_val = elems.back().toTensor().slice(1, 0, 1).squeeze(1);
       }
-    return out_val;
+    return to_float(out_val);
   }
 
   bool TorchModule::extractable(std::string extract_layer) const
@@ -427,6 +453,120 @@ namespace dd
       }
   }
 
+  void TorchModule::freeze_for_inference()
+  {
+    _inference_only = true;
+    if (!_traced)
+      return;
+
+    try
+      {
+        // batch norm folds into convolutions of the eval mode module, then
+        // freezing turns weights and attributes into graph constants that
+        // the graph executor can propagate and fuse
+        _traced->eval();
+        torch::jit::script::Module folded
+            = torch::jit::FoldConvBatchNorm(*_traced);
+        _traced = std::make_shared<torch::jit::script::Module>(
+            torch::jit::freeze_module(folded));
+      }
+    catch (std::exception &e)
+      {
+        _logger->error("unable to freeze traced module for inference: {}",
+                       e.what());
+        throw MLLibInternalException(std::string("Libtorch error: ")
+                                     + e.what());
+      }
+  }
+
+  void TorchModule::quantize_dynamic()
+  {
+    if (!_quantized_dynamic)
+      {
+        torch_quantize::set_quantized_engine();
+        _quantized_dynamic = true;
+        _inference_only = true;
+      }
+
+    int nquantized = 0;
+    try
+      {
+        if (_traced && !_traced_quantized)
+          {
+            nquantized += torch_quantize::quantize_dynamic(*_traced);
+            _traced_quantized = true;
+          }
+        if (_native)
+          nquantized += torch_quantize::quantize_dynamic(*_native);
+        if (_graph && _graph->allocated())
+          nquantized += torch_quantize::quantize_dynamic(*_graph);
+      }
+    catch (std::exception &e)
+      {
+        _logger->error("unable to quantize net: {}", e.what());
+        throw MLLibInternalException(std::string("Libtorch error: ")
+                                     + e.what());
+      }
+    if (nquantized > 0)
+      _logger->info("quantized {} linear layers to int8", nquantized);
+  }
+
+  void TorchModule::prepare_static_quantization()
+  {
+    if (!_traced)
+      throw MLLibBadParamException(
+          "static quantization requires a traced model");
+    torch_quantize::set_quantized_engine();
+    _inference_only = true;
+    try
+      {
+        _traced = std::make_shared<torch::jit::script::Module>(
+            torch_quantize::prepare_static(*_traced));
+      }
+    catch (std::exception &e)
+      {
+        _logger->error("unable to prepare static quantization: {}",
+                       e.what());
+        throw MLLibInternalException(std::string("Libtorch error: ")
+                                     + e.what());
+      }
+  }
+
+  void TorchModule::convert_static_quantization(const std::string &path)
+  {
+    try
+      {
+        _traced = std::make_shared<torch::jit::script::Module>(
+            torch_quantize::convert_static(*_traced));
+        _traced->save(path);
+      }
+    catch (std::exception &e)
+      {
+        _logger->error("unable to quantize traced module: {}", e.what());
+        throw MLLibInternalException(std::string("Libtorch error: ")
+                                     + e.what());
+      }
+    _logger->info("saved statically quantized model to {}", path);
+  }
+
+  void TorchModule::load_quantized(const std::string &path)
+  {
+    torch_quantize::set_quantized_engine();
+    _inference_only = true;
+    _logger->info("loading " + path);
+    try
+      {
+        _traced = std::make_shared<torch::jit::script::Module>(
+            torch::jit::load(path, _device));
+      }
+    catch (std::exception &e)
+      {
+        _logger->error("unable to load " + path);
+        throw;
+      }
+    _traced->eval();
+  }
+
   void TorchModule::setup_linear_layer(int nclasses,
                                        std::vector<c10::IValue> input_example)
   {
@@ -458,6 +598,9 @@ namespace dd
 
   void TorchModule::save_checkpoint(TorchModel &model, const std::string &name)
   {
+    // checkpoints are stored in fp32, whatever the training datatype
+    if (_dtype != torch::kFloat32)
+      to(torch::kFloat32);
     if (_traced)
       _traced->save(model._repo + "/checkpoint-" + name + ".pt");
     if (_linear)
@@ -466,6 +609,8 @@ namespace dd
       torch::save(_graph, model._repo + "/checkpoint-" + name + ".pt");
     if (_native)
       torch::save(_native, model._repo + "/checkpoint-" + name + ".npt");
+    if (_dtype != torch::kFloat32)
+      to(_dtype);
   }
 
   void TorchModule::load(TorchModel &model)
@@ -502,9 +647,10 @@ namespace dd
 
   void TorchModule::eval()
   {
+    _training = false;
     if (_graph)
       _graph->eval();
-    if (_traced)
+    if (_traced && !_inference_only) // frozen modules are in eval mode
       _traced->eval();
     if (_linear)
       _linear->eval();
@@ -514,6 +660,10 @@ namespace dd
 
   void TorchModule::train()
   {
+    if (_inference_only)
+      throw MLLibBadParamException(
+          "model was loaded for inference only and cannot be trained");
+    _training = true;
     if (_graph)
       _graph->train();
     if (_traced)
@@ -545,7 +695,7 @@ namespace dd
   template void TorchModule::post_transform_predict(
       const std::string tmpl, const APIData &template_params,
       const ImgTorchInputFileConn &inputc, const TorchModel &tmodel,
-      const torch::Device &device, const APIData &ad);
+      const torch::Device &device);
 
   template void TorchModule::post_transform(
       const std::string tmpl, const APIData &template_params,
@@ -560,7 +710,7 @@ namespace dd
   template void TorchModule::post_transform_predict(
       const std::string tmpl, const APIData &template_params,
       const TxtTorchInputFileConn &inputc, const TorchModel &tmodel,
-      const torch::Device &device, const APIData &ad);
+      const torch::Device &device);
 
   template void TorchModule::post_transform(
       const std::string tmpl, const APIData &template_params,
@@ -575,5 +725,5 @@ namespace dd
   template void TorchModule::post_transform_predict(
       const std::string tmpl, const APIData &template_params,
       const CSVTSTorchInputFileConn &inputc, const TorchModel &tmodel,
-      const torch::Device &device, const APIData &ad);
+      const torch::Device &device);
 }
@@ -87,6 +87,38 @@ namespace dd
      */
     void freeze_traced(bool freeze);
 
+    /**
+     * \brief prepares the net for inference only: the traced module gets
+     * its batch norms folded into convolutions, and is frozen. The net
+     * cannot be trained afterwards.
+     */
+    void freeze_for_inference();
+
+    /**
+     * \brief quantizes linear layers to int8 with dynamically quantized
+     * activations, for CPU inference only. Graph and native nets allocated
+     * later on are quantized once by post_transform_predict.
+     */
+    void quantize_dynamic();
+
+    /**
+     * \brief inserts observers into the traced module, so that following
+     * forward passes calibrate its static quantization
+     */
+    void prepare_static_quantization();
+
+    /**
+     * \brief quantizes the calibrated traced module to int8 and saves it
+     * @param path file the quantized traced module is saved to
+     */
+    void convert_static_quantization(const std::string &path);
+
+    /**
+     * \brief loads a statically quantized traced module instead of the
+     * float one
+     */
+    void load_quantized(const std::string &path);
+
     /**
      * \brief Add linear model at the end of module. Automatically detects size
      * of the last layer thanks to the provided example output.
@@ -121,6 +153,14 @@ namespace dd
      */
     void train();
 
+    /**
+     * \brief whether net was last set in train mode
+     */
+    bool is_training() const
+    {
+      return _training;
+    }
+
     /**
      * \brief release all shared_ptr
      */
@@ -151,15 +191,28 @@ namespace dd
                               const torch::Device &device);
 
     /**
-     * \brief hook called after inputConnector::transform(data) during predict
+     * \brief hook called after inputConnector::transform(data) during
+     * predict, when predict_ready() is false: allocates the nets and sets
+     * them in eval mode, so that predict calls can then share them
+     * read-only. Must not run concurrently with other predict calls.
      */
     template <class TInputConnectorStrategy>
     void post_transform_predict(const std::string tmpl,
                                 const APIData &template_params,
                                 const TInputConnectorStrategy &inputc,
                                 const TorchModel &tmodel,
-                                const torch::Device &device,
-                                const APIData &ad);
+                                const torch::Device &device);
+
+    /**
+     * \brief whether nets are set up for predict calls on inputc data, i.e.
+     * allocated and, for graphs, with the same input dimensions
+     */
+    template <class TInputConnectorStrategy>
+    bool predict_ready(const TInputConnectorStrategy &inputc) const
+    {
+      return _predict_ready
+             && (!_graph || inputc._dataset.datasize(0) == _predict_dims);
+    }
 
     /**
      * \brief see torch::module::to
@@ -169,17 +222,16 @@ namespace dd
     void to(torch::Device device);
 
     /**
-     * \brief see torch::module::to
-     * @param dtype : torch::kFloat32 or torch::kFloat64
-     * @param non_blocking
+     * \brief see torch::module::to, only floating point parameters and
+     * buffers are cast
+     * @param dtype : torch::kFloat32, torch::kFloat64 or torch::kBFloat16
      */
     void to(torch::Dtype dtype);
 
     /**
      * \brief see torch::module::to
      * @param device cpu / gpu
-     * @param dtype : torch::kFloat32 or torch::kFloat64
-     * @param non_blocking
+     * @param dtype : torch::kFloat32, torch::kFloat64 or torch::kBFloat16
      */
     void to(torch::Device device, torch::Dtype dtype);
 
@@ -195,6 +247,9 @@ namespace dd
     torch::nn::Linear _linear = nullptr;
 
     torch::Device _device;
+    torch::Dtype _dtype
+        = torch::kFloat32; /**< datatype of weights and of floating point
+                              inputs, outputs are always fp32 */
     int _linear_in = 0; /**<id of the input of the final linear layer */
     bool _hidden_states = false; /**< Take BERT hidden states as input. */
 
@@ -203,11 +258,22 @@ namespace dd
         _linear_layer_file;     /** < if require_linear_layer == true, this is
                                     the file where the weights are stored */
     unsigned int _nclasses = 0; /**< number of classes */
+    bool _inference_only
+        = false; /**< whether net is frozen or quantized for inference */
+    bool _quantized_dynamic
+        = false; /**< whether linear layers run on int8 weights */
 
     std::shared_ptr<spdlog::logger> _logger; /**< mllib logger. */
 
   private:
     bool _freeze_traced = false; /**< Freeze weights of the traced module */
+    bool _training = false;      /**< whether net is in train mode */
+    bool _predict_ready
+        = false; /**< whether nets are set up for predict calls */
+    std::vector<long int>
+        _predict_dims; /**< graph input dimensions of predict calls */
+    bool _traced_quantized
+        = false; /**< whether traced module was already quantized */
 
     /**
      * load graph module from caffe prototxt definition
@@ -238,6 +304,16 @@ namespace dd
      * load linear layer weights only from pt format
      */
     void linear_layer_load();
+
+    /**
+     * \brief casts floating point input tensors to the module datatype
+     */
+    std::vector<c10::IValue> to_dtype(std::vector<c10::IValue> source) const;
+
+    /**
+     * \brief casts output tensor back to fp32 if needed
+     */
+    c10::IValue to_float(const c10::IValue &out_val) const;
   };
 }
 #endif
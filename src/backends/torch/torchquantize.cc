@@ -0,0 +1,293 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2021 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "torchquantize.h"
+#include "mllibstrategy.h"
+
+#include <torch/csrc/jit/ir/ir.h>
+#include <torch/csrc/jit/passes/fold_conv_bn.h>
+#include <torch/csrc/jit/passes/quantization/finalize.h>
+#include <torch/csrc/jit/passes/quantization/insert_observers.h>
+#include <torch/csrc/jit/passes/quantization/insert_quant_dequant.h>
+#include <torch/csrc/jit/passes/quantization/quantization_type.h>
+
+#include <cmath>
+#include <unordered_set>
+
+namespace dd
+{
+  /*-- QLinearImpl --*/
+  QLinearImpl::QLinearImpl(const torch::nn::LinearOptions &options_)
+      : options(options_)
+  {
+    reset();
+  }
+
+  void QLinearImpl::reset()
+  {
+    weight = register_parameter(
+        "weight",
+        torch::empty({ options.out_features(), options.in_features() }));
+    if (options.bias())
+      bias = register_parameter("bias",
+                                torch::empty(options.out_features()));
+    else
+      bias = register_parameter("bias", {}, false);
+
+    // same initialization as torch::nn::Linear
+    torch::nn::init::kaiming_uniform_(weight, std::sqrt(5));
+    if (bias.defined())
+      {
+        int64_t fan_in = std::get<0>(
+            torch::nn::init::_calculate_fan_in_and_fan_out(weight));
+        const double bound = 1.0 / std::sqrt(fan_in);
+        torch::nn::init::uniform_(bias, -bound, bound);
+      }
+    _qweight = _packed = _col_offsets = _qbias = torch::Tensor();
+  }
+
+  torch::Tensor QLinearImpl::forward(const torch::Tensor &input)
+  {
+    if (_packed.defined() && !is_training())
+      return torch::fbgemm_linear_int8_weight_fp32_activation(
+          input.to(torch::kFloat), _qweight, _packed, _col_offsets, _scale,
+          _zero_point, _qbias);
+    return torch::linear(input, weight, bias);
+  }
+
+  void QLinearImpl::quantize()
+  {
+    torch::NoGradGuard no_grad;
+    torch::Tensor w = weight.to(torch::kCPU, torch::kFloat).contiguous();
+    std::tie(_qweight, _col_offsets, _scale, _zero_point)
+        = torch::fbgemm_linear_quantize_weight(w);
+    _packed = torch::fbgemm_pack_quantized_matrix(_qweight);
+    if (bias.defined())
+      _qbias = bias.to(torch::kCPU, torch::kFloat).contiguous();
+    else
+      _qbias = torch::zeros({ options.out_features() });
+  }
+
+  namespace torch_quantize
+  {
+    void set_quantized_engine()
+    {
+      if (!torch::fbgemm_is_cpu_supported())
+        throw MLLibBadParamException(
+            "int8 quantization requires a CPU supported by fbgemm");
+      at::globalContext().setQEngine(at::QEngine::FBGEMM);
+    }
+
+    int quantize_dynamic(torch::nn::Module &module)
+    {
+      int nquantized = 0;
+      for (const std::shared_ptr<torch::nn::Module> &m :
+           module.modules(false))
+        {
+          auto qlinear = std::dynamic_pointer_cast<QLinearImpl>(m);
+          if (qlinear && !qlinear->quantized())
+            {
+              qlinear->quantize();
+              ++nquantized;
+            }
+        }
+      return nquantized;
+    }
+
+    /**
+     * \brief whether a traced submodule is a torch.nn.Linear, possibly with a
+     * mangled type name
+     */
+    static bool is_linear(const torch::jit::script::Module &module)
+    {
+      const c10::optional<c10::QualifiedName> &name = module.type()->name();
+      return name && name->name() == "Linear"
+             && name->prefix().find("torch.nn.modules.linear")
+                    != std::string::npos;
+    }
+
+    /**
+     * \brief redirects calls to forward methods of the given types to their
+     * int8 version, in block and its sub-blocks
+     */
+    static void
+    redirect_forward_calls(torch::jit::Block *block,
+                           const std::unordered_set<std::string> &types)
+    {
+      for (torch::jit::Node *node : block->nodes())
+        {
+          for (torch::jit::Block *sub_block : node->blocks())
+            redirect_forward_calls(sub_block, types);
+          if (node->kind() != torch::jit::prim::CallMethod
+              || node->s(torch::jit::attr::name) != "forward")
+            continue;
+          c10::ClassTypePtr type
+              = node->input(0)->type()->cast<c10::ClassType>();
+          if (type && type->name()
+              && types.count(type->name()->qualifiedName()))
+            node->s_(torch::jit::attr::name, "forward_int8");
+        }
+    }
+
+    int quantize_dynamic(torch::jit::script::Module &module)
+    {
+      torch::NoGradGuard no_grad;
+      int nquantized = 0;
+      std::unordered_set<std::string> linear_types;
+      for (torch::jit::script::Module m : module.modules())
+        {
+          if (!is_linear(m))
+            continue;
+          torch::Tensor weight = m.attr("weight")
+                                     .toTensor()
+                                     .to(torch::kCPU, torch::kFloat)
+                                     .contiguous();
+          torch::Tensor qweight, col_offsets;
+          double scale;
+          int64_t zero_point;
+          std::tie(qweight, col_offsets, scale, zero_point)
+              = torch::fbgemm_linear_quantize_weight(weight);
+          torch::jit::IValue bias = m.attr("bias");
+          torch::Tensor qbias
+              = bias.isTensor()
+                    ? bias.toTensor().to(torch::kCPU, torch::kFloat)
+                    : torch::zeros({ weight.size(0) });
+
+          // Linear modules may share their type, attributes and method are
+          // added to the type once and filled for every module
+          m.register_attribute("_dd_qweight", c10::TensorType::get(),
+                               qweight);
+          m.register_attribute(
+              "_dd_packed", c10::TensorType::get(),
+              torch::fbgemm_pack_quantized_matrix(qweight));
+          m.register_attribute("_dd_col_offsets", c10::TensorType::get(),
+                               col_offsets);
+          m.register_attribute("_dd_scale", c10::FloatType::get(), scale);
+          m.register_attribute("_dd_zero_point", c10::IntType::get(),
+                               zero_point);
+          m.register_attribute("_dd_qbias", c10::TensorType::get(),
+                               qbias.contiguous());
+          if (!m.find_method("forward_int8"))
+            m.define(R"(
+def forward_int8(self, input: Tensor) -> Tensor:
+    return torch.fbgemm_linear_int8_weight_fp32_activation(
+        input.float(), self._dd_qweight, self._dd_packed,
+        self._dd_col_offsets, self._dd_scale, self._dd_zero_point,
+        self._dd_qbias)
+)");
+          linear_types.insert(m.type()->name()->qualifiedName());
+          ++nquantized;
+        }
+
+      for (const torch::jit::script::Module &m : module.modules())
+        for (const torch::jit::script::Method &method : m.get_methods())
+          redirect_forward_calls(method.graph()->block(), linear_types);
+      return nquantized;
+    }
+
+    /**
+     * \brief min/max observer, as torch.quantization.MinMaxObserver
+     * @param symmetric whether range is symmetric around zero (weights)
+     */
+    static torch::jit::script::Module
+    make_observer(const std::string &name, const at::ScalarType &dtype,
+                  const bool &symmetric, const int64_t &quant_min,
+                  const int64_t &quant_max)
+    {
+      torch::jit::script::Module observer(
+          c10::QualifiedName("__torch__.dd." + name));
+      observer.register_attribute("min_val", c10::TensorType::get(),
+                                  torch::zeros({}));
+      observer.register_attribute("max_val", c10::TensorType::get(),
+                                  torch::zeros({}));
+      observer.register_attribute("observed", c10::BoolType::get(), false);
+      observer.register_attribute("symmetric", c10::BoolType::get(),
+                                  symmetric);
+      observer.register_attribute("quant_min", c10::IntType::get(),
+                                  quant_min);
+      observer.register_attribute("quant_max", c10::IntType::get(),
+                                  quant_max);
+      // read by quantization passes
+      observer.register_attribute("dtype", c10::IntType::get(),
+                                  static_cast<int64_t>(dtype));
+      observer.register_attribute(
+          "qscheme", c10::IntType::get(),
+          static_cast<int64_t>(symmetric ? at::kPerTensorSymmetric
+                                         : at::kPerTensorAffine));
+      observer.define(R"(
+def forward(self, x: Tensor) -> Tensor:
+    if x.numel() > 0:
+        x_min = torch.min(x)
+        x_max = torch.max(x)
+        if self.observed:
+            x_min = torch.min(x_min, self.min_val)
+            x_max = torch.max(x_max, self.max_val)
+        self.min_val = x_min
+        self.max_val = x_max
+        self.observed = True
+    return x
+
+def calculate_qparams(self) -> Tuple[Tensor, Tensor]:
+    min_val = min(float(self.min_val), 0.0)
+    max_val = max(float(self.max_val), 0.0)
+    zero_point = 0
+    if self.symmetric:
+        max_val = max(-min_val, max_val)
+        scale = max_val / (float(self.quant_max - self.quant_min) / 2.0)
+    else:
+        scale = (max_val - min_val) / float(self.quant_max - self.quant_min)
+    scale = max(scale, 1.1920928955078125e-07)
+    if not self.symmetric:
+        zero_point = self.quant_min - int(round(min_val / scale))
+        zero_point = max(self.quant_min, min(self.quant_max, zero_point))
+    return torch.tensor([scale]), torch.tensor([zero_point])
+)");
+      return observer;
+    }
+
+    torch::jit::script::Module
+    prepare_static(torch::jit::script::Module &module)
+    {
+      // fbgemm activations use a reduced 7 bits range to avoid overflows
+      std::unordered_map<std::string,
+                         c10::optional<std::tuple<torch::jit::script::Module,
+                                                  torch::jit::script::Module>>>
+          qconfig_dict{
+            { "", std::make_tuple(make_observer("ActivationObserver",
+                                                at::kQUInt8, false, 0, 127),
+                                  make_observer("WeightObserver", at::kQInt8,
+                                                true, -128, 127)) }
+          };
+      module.eval();
+      torch::jit::script::Module folded
+          = torch::jit::FoldConvBatchNorm(module);
+      return torch::jit::InsertObservers(folded, "forward", qconfig_dict,
+                                         false, torch::jit::QuantType::STATIC);
+    }
+
+    torch::jit::script::Module
+    convert_static(torch::jit::script::Module &module)
+    {
+      torch::jit::script::Module quantized = torch::jit::InsertQuantDeQuant(
+          module, "forward", false, false, torch::jit::QuantType::STATIC);
+      return torch::jit::Finalize(quantized, torch::jit::QuantType::STATIC);
+    }
+  }
+}
@@ -0,0 +1,126 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2021 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TORCH_QUANTIZE_H
+#define TORCH_QUANTIZE_H
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#include <torch/torch.h>
+#pragma GCC diagnostic pop
+#include <torch/script.h>
+
+namespace dd
+{
+  /**
+   * \brief linear layer that can run with int8 weights and dynamically
+   * quantized activations on CPU. Parameters are named like the ones of
+   * torch::nn::Linear, so that weights are saved and loaded the same way.
+   */
+  class QLinearImpl : public torch::nn::Cloneable<QLinearImpl>
+  {
+  public:
+    QLinearImpl(int64_t in_features, int64_t out_features)
+        : QLinearImpl(torch::nn::LinearOptions(in_features, out_features))
+    {
+    }
+
+    explicit QLinearImpl(const torch::nn::LinearOptions &options_);
+
+    /**
+     * \brief (re)allocates and initializes parameters, as torch::nn::Linear
+     */
+    void reset() override;
+
+    /**
+     * \brief int8 forward pass once quantized and in eval mode, float
+     * forward pass otherwise
+     */
+    torch::Tensor forward(const torch::Tensor &input);
+
+    /**
+     * \brief quantizes and packs current weights for int8 forward passes
+     */
+    void quantize();
+
+    /**
+     * \brief whether weights have been quantized
+     */
+    bool quantized() const
+    {
+      return _packed.defined();
+    }
+
+    torch::nn::LinearOptions options;
+    torch::Tensor weight;
+    torch::Tensor bias;
+
+  private:
+    torch::Tensor _qweight;     /**< int8 weights */
+    torch::Tensor _packed;      /**< int8 weights packed for fbgemm */
+    torch::Tensor _col_offsets; /**< per column sums of int8 weights */
+    torch::Tensor _qbias;       /**< float bias, zeros if none */
+    double _scale = 1.0;        /**< weights quantization scale */
+    int64_t _zero_point = 0;    /**< weights quantization zero point */
+  };
+
+  TORCH_MODULE(QLinear);
+
+  namespace torch_quantize
+  {
+    /**
+     * \brief selects the fbgemm quantized engine, throws if the CPU does not
+     * support it
+     */
+    void set_quantized_engine();
+
+    /**
+     * \brief quantizes linear layers of a C++ module (graph or native) to
+     * int8, layers that already are quantized are left as is
+     * @return number of newly quantized layers
+     */
+    int quantize_dynamic(torch::nn::Module &module);
+
+    /**
+     * \brief quantizes torch.nn.Linear layers of a traced module to int8:
+     * calls to their forward method are redirected to an int8 method with
+     * dynamically quantized activations
+     * @return number of quantized layers
+     */
+    int quantize_dynamic(torch::jit::script::Module &module);
+
+    /**
+     * \brief folds batch norms and inserts min/max observers on activations
+     * and weights of a traced module, to be calibrated with forward passes
+     * over representative data
+     */
+    torch::jit::script::Module
+    prepare_static(torch::jit::script::Module &module);
+
+    /**
+     * \brief turns a calibrated module from prepare_static into a frozen
+     * module with int8 weights and activations
+     */
+    torch::jit::script::Module
+    convert_static(torch::jit::script::Module &module);
+  }
+}
+
+#endif
@@ -73,6 +73,22 @@ namespace dd
     this->_logger->info("Selected solver type: {}", _solver_type);
 
     _params = module.parameters();
+    _module_params.clear();
+    if (module._dtype != torch::kFloat32)
+      {
+        // lower precision weights are updated from fp32 master copies, so
+        // that small updates are not rounded away
+        this->_logger->info("fp32 master weights for {} module",
+                            c10::toString(module._dtype));
+        _module_params = _params;
+        _params.clear();
+        for (const at::Tensor &param : _module_params)
+          {
+            at::Tensor master = param.detach().to(torch::kFloat32);
+            master.set_requires_grad(param.requires_grad());
+            _params.push_back(master);
+          }
+      }
 
     if (_solver_type == "ADAM")
       {
@@ -153,8 +169,27 @@ namespace dd
       }
   }
 
+  void TorchSolver::zero_grad()
+  {
+    _optimizer->zero_grad();
+    for (at::Tensor &param : _module_params)
+      if (param.grad().defined())
+        {
+          param.mutable_grad().detach_();
+          param.mutable_grad().zero_();
+        }
+  }
+
   void TorchSolver::step()
   {
+    for (size_t p = 0; p < _module_params.size(); ++p)
+      {
+        const at::Tensor &grad = _module_params[p].grad();
+        if (grad.defined())
+          _params[p].mutable_grad() = grad.to(torch::kFloat32);
+        else
+          _params[p].mutable_grad() = at::Tensor();
+      }
     if (_clip)
       {
         if (_clip_value > 0.0)
@@ -168,6 +203,10 @@ namespace dd
           }
       }
     _optimizer->step();
+
+    torch::NoGradGuard no_grad;
+    for (size_t p = 0; p < _module_params.size(); ++p)
+      _module_params[p].copy_(_params[p]);
   }
 
   void TorchSolver::save(std::string sfile)
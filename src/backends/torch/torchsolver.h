@@ -86,14 +86,12 @@ namespace dd
      * \brief zero_grad() indirection in order to mimic native optimizer
      * behavior
      */
-    void zero_grad()
-    {
-      _optimizer->zero_grad();
-    }
+    void zero_grad();
 
     /**
      * \brief step() indirection in order to mimic native optimizer behavior
-     * also applies gradient clipping if asked for
+     * also applies gradient clipping if asked for, and updates the module
+     * weights from fp32 master weights when it runs in lower precision
      */
     void step();
 
@@ -110,6 +108,9 @@ namespace dd
 
     std::vector<at::Tensor> _params; /**< list of parameter to optimize,
                    storing it here for gradient clipping */
+    std::vector<at::Tensor>
+        _module_params; /**< module parameters, when they are not fp32:
+                           _params then holds their fp32 master copies */
 
     std::string _solver_type
         = "SGD"; /**< id of solver in {SGD, ADAM, RMSPROP, ADAGRAD, RANGER}*/
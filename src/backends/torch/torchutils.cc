@@ -25,6 +25,7 @@
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
+#include <cstring>
 #include <fcntl.h>
 #include <unordered_set>
 
@@ -186,5 +187,92 @@ namespace dd
       auto jit_module = torch::jit::load(filename, device);
       torch_utils::copy_weights(jit_module, module, device, logger);
     }
+
+    // record layout: magic, ntensors, then per tensor: dtype, ndim, sizes,
+    // nbytes, payload padded to 8 bytes
+    static const char tensor_record_magic[8] = { 'D', 'D', 'T', 'E',
+                                                 'N', 'S', '0', '1' };
+
+    static void append_pod(std::string &record, const int64_t &v)
+    {
+      record.append(reinterpret_cast<const char *>(&v), sizeof(int64_t));
+    }
+
+    void write_tensor_record(const std::vector<torch::Tensor> &tensors,
+                             std::string &record)
+    {
+      size_t size = sizeof(tensor_record_magic) + sizeof(int64_t);
+      std::vector<torch::Tensor> ctensors;
+      for (const torch::Tensor &t : tensors)
+        {
+          ctensors.push_back(t.to(torch::kCPU).contiguous());
+          size += (3 + t.dim()) * sizeof(int64_t)
+                  + (ctensors.back().nbytes() + 7) / 8 * 8;
+        }
+
+      record.clear();
+      record.reserve(size);
+      record.append(tensor_record_magic, sizeof(tensor_record_magic));
+      append_pod(record, ctensors.size());
+      for (const torch::Tensor &t : ctensors)
+        {
+          append_pod(record, static_cast<int64_t>(t.scalar_type()));
+          append_pod(record, t.dim());
+          for (int64_t s : t.sizes())
+            append_pod(record, s);
+          int64_t nbytes = t.nbytes();
+          append_pod(record, nbytes);
+          record.append(static_cast<const char *>(t.data_ptr()), nbytes);
+          record.append((8 - nbytes % 8) % 8, '\0');
+        }
+    }
+
+    bool is_tensor_record(const std::string &record)
+    {
+      return record.size() >= sizeof(tensor_record_magic)
+             && record.compare(0, sizeof(tensor_record_magic),
+                               tensor_record_magic,
+                               sizeof(tensor_record_magic))
+                    == 0;
+    }
+
+    std::vector<torch::Tensor> read_tensor_record(const std::string &record)
+    {
+      std::vector<torch::Tensor> tensors;
+      if (!is_tensor_record(record))
+        {
+          // legacy records
+          std::stringstream stream(record);
+          torch::load(tensors, stream);
+          return tensors;
+        }
+
+      const char *ptr = record.data() + sizeof(tensor_record_magic);
+      const char *end = record.data() + record.size();
+      auto read_pod = [&ptr, &end]() {
+        if (ptr + sizeof(int64_t) > end)
+          throw MLLibInternalException("truncated tensor record");
+        int64_t v;
+        std::memcpy(&v, ptr, sizeof(int64_t));
+        ptr += sizeof(int64_t);
+        return v;
+      };
+
+      int64_t ntensors = read_pod();
+      for (int64_t i = 0; i < ntensors; ++i)
+        {
+          auto dtype = static_cast<torch::ScalarType>(read_pod());
+          std::vector<int64_t> sizes(read_pod());
+          for (int64_t &s : sizes)
+            s = read_pod();
+          int64_t nbytes = read_pod();
+          if (ptr + nbytes > end)
+            throw MLLibInternalException("truncated tensor record");
+          tensors.push_back(torch::from_blob(const_cast<char *>(ptr), sizes,
+                                             torch::TensorOptions(dtype)));
+          ptr += (nbytes + 7) / 8 * 8;
+        }
+      return tensors;
+    }
   }
 }
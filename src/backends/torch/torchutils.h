@@ -34,6 +34,7 @@
 #include <torch/torch.h>
 #pragma GCC diagnostic pop
 #include <torch/script.h>
+#include <torch/version.h>
 
 #include <google/protobuf/message.h>
 
@@ -42,6 +43,16 @@ namespace dd
 
   namespace torch_utils
   {
+    /**
+     * \brief disables autograd for the scope of inference calls, with
+     * InferenceMode when libtorch has it
+     */
+#if TORCH_VERSION_MAJOR > 1                                                   \
+    || (TORCH_VERSION_MAJOR == 1 && TORCH_VERSION_MINOR >= 9)
+    typedef c10::InferenceMode InferenceGuard;
+#else
+    typedef torch::NoGradGuard InferenceGuard;
+#endif
 
     /**
      * \brief empty cuda caching allocator, This should be called after every
@@ -95,6 +106,21 @@ namespace dd
                         std::vector<torch::Tensor> &params,
                         bool requires_grad = true);
 
+    /**
+     * \brief casts floating point parameters and buffers of module to dtype,
+     * integer ones (token ids, counters) are kept as is
+     */
+    template <class TModule>
+    void to_floating_dtype(TModule &module, const torch::Dtype &dtype)
+    {
+      for (torch::Tensor tensor : module.parameters())
+        if (tensor.is_floating_point())
+          tensor.set_data(tensor.to(dtype));
+      for (torch::Tensor tensor : module.buffers())
+        if (tensor.is_floating_point())
+          tensor.set_data(tensor.to(dtype));
+    }
+
     std::vector<c10::IValue> unwrap_c10_vector(const c10::IValue &output);
 
     void copy_weights(const torch::jit::script::Module &from,
@@ -104,6 +130,25 @@ namespace dd
     void load_weights(torch::nn::Module &module, const std::string &filename,
                       const torch::Device &device,
                       std::shared_ptr<spdlog::logger> logger = nullptr);
+
+    /**
+     * \brief serialize tensors as a raw record: dtype, shape and bytes of
+     * every tensor, with 8-byte aligned payloads
+     */
+    void write_tensor_record(const std::vector<torch::Tensor> &tensors,
+                             std::string &record);
+
+    /**
+     * \brief whether record was written by write_tensor_record
+     */
+    bool is_tensor_record(const std::string &record);
+
+    /**
+     * \brief deserialize tensors from a raw record, tensors are views on the
+     * record memory, that must outlive them. Records written with
+     * torch::save are loaded (and copied) as well.
+     */
+    std::vector<torch::Tensor> read_tensor_record(const std::string &record);
   }
 }
 #endif
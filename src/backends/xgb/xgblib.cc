@@ -536,6 +536,7 @@ namespace dd
         rad.add("cats", cats);
         vrad.push_back(rad);
       }
+    this->_stats.output_start();
     tout.add_results(vrad);
     TOutputConnectorStrategy btout(this->_outputc);
     if (_regression)
@@ -546,6 +547,7 @@ namespace dd
     out.add("nclasses", nclasses);
     tout.finalize(ad.getobj("parameters").getobj("output"), out,
                   static_cast<MLModel *>(&this->_mlmodel));
+    this->_stats.output_end();
     out.add("status", 0);
     return 0;
   }
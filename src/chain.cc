@@ -131,7 +131,7 @@ namespace dd
                   {
                     APIData vout;
                     APIData vals;
-                    vals.add("vals", p.get("vals").get<std::vector<double>>());
+                    vals.add("vals", p.get("vals"));
                     if (p.has("nns"))
                       vals.add("nns", p.getv("nns"));
                     vout.add(model_name, vals);
@@ -24,6 +24,7 @@
 
 #include "apidata.h"
 #include <iostream>
+#include <mutex>
 
 namespace dd
 {
@@ -41,42 +42,49 @@ namespace dd
     {
     }
 
-    void add_model_data(const std::string &id, const APIData &out)
+    void add_model_data(const std::string &id, APIData out)
     {
-      std::unordered_map<std::string, APIData>::iterator hit;
-      if ((hit = _model_data.find(id)) != _model_data.end())
-        _model_data.erase(hit);
-      _model_data.insert(std::pair<std::string, APIData>(id, out));
+      std::lock_guard<std::mutex> lock(_mutex);
+      _model_data[id] = std::move(out);
     }
 
-    APIData get_model_data(const std::string &id) const
+    /**
+     * \brief model output for call id, or an empty object. The reference
+     *        stays valid until the same id is stored again.
+     */
+    const APIData &get_model_data(const std::string &id) const
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string, APIData>::const_iterator hit;
       if ((hit = _model_data.find(id)) != _model_data.end())
         return (*hit).second;
       else
-        return APIData();
+        return APIData::empty_obj();
     }
 
-    void add_action_data(const std::string &id, const APIData &out)
+    void add_action_data(const std::string &id, APIData out)
     {
-      std::unordered_map<std::string, APIData>::iterator hit;
-      if ((hit = _action_data.find(id)) != _action_data.end())
-        _action_data.erase(hit);
-      _action_data.insert(std::pair<std::string, APIData>(id, out));
+      std::lock_guard<std::mutex> lock(_mutex);
+      _action_data[id] = std::move(out);
     }
 
-    APIData get_action_data(const std::string &id) const
+    /**
+     * \brief action output for action id, or an empty object, shared in
+     *        between all the calls that take their input from this action
+     */
+    const APIData &get_action_data(const std::string &id) const
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string, APIData>::const_iterator hit;
       if ((hit = _action_data.find(id)) != _action_data.end())
         return (*hit).second;
       else
-        return APIData();
+        return APIData::empty_obj();
     }
 
     void add_model_sname(const std::string &id, const std::string &sname)
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string, std::string>::iterator hit;
       if ((hit = _id_sname.find(id)) == _id_sname.end())
         _id_sname.insert(std::pair<std::string, std::string>(id, sname));
@@ -84,6 +92,7 @@ namespace dd
 
     std::string get_model_sname(const std::string &id)
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string, std::string>::const_iterator hit;
       if ((hit = _id_sname.find(id)) != _id_sname.end())
         return (*hit).second;
@@ -98,6 +107,10 @@ namespace dd
     std::unordered_map<std::string, std::string> _id_sname;
     // std::string _first_sname;
     std::string _first_id;
+
+  private:
+    mutable std::mutex _mutex; /**< independent chain branches run
+                                  concurrently. */
   };
 
   /**
@@ -142,6 +155,10 @@ namespace dd
     {
       (void)vd;
     }
+    void operator()(const std::vector<float> &vf)
+    {
+      (void)vf;
+    }
     void operator()(const std::vector<int> &vd)
     {
       (void)vd;
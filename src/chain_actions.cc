@@ -33,9 +33,11 @@ namespace dd
   void ImgsCropAction::apply(APIData &model_out, ChainData &cdata)
   {
     std::vector<APIData> vad = model_out.getv("predictions");
-    std::vector<cv::Mat> imgs
+    // crops are ROI views over the decoded images, that are shared with the
+    // model output
+    const std::vector<cv::Mat> &imgs
         = model_out.getobj("input").get("imgs").get<std::vector<cv::Mat>>();
-    std::vector<std::pair<int, int>> imgs_size
+    const std::vector<std::pair<int, int>> &imgs_size
         = model_out.getobj("input")
               .get("imgs_size")
               .get<std::vector<std::pair<int, int>>>();
@@ -61,7 +63,7 @@ namespace dd
       {
         std::string uri = vad.at(i).get("uri").get<std::string>();
 
-        cv::Mat img = imgs.at(i);
+        const cv::Mat &img = imgs.at(i);
         int orig_cols = imgs_size.at(i).second;
         int orig_rows = imgs_size.at(i).first;
 
@@ -131,9 +133,9 @@ namespace dd
       }
     // store crops into action output store
     APIData action_out;
-    action_out.add("data_raw_img", cropped_imgs);
-    action_out.add("cids", bbox_ids);
-    cdata.add_action_data(_action_id, action_out);
+    action_out.add("data_raw_img", std::move(cropped_imgs));
+    action_out.add("cids", std::move(bbox_ids));
+    cdata.add_action_data(_action_id, std::move(action_out));
 
     // updated model data with chain ids
     model_out.add("predictions", cvad);
@@ -143,9 +145,9 @@ namespace dd
   {
     // get label
     std::vector<APIData> vad = model_out.getv("predictions");
-    std::vector<cv::Mat> imgs
+    const std::vector<cv::Mat> &imgs
         = model_out.getobj("input").get("imgs").get<std::vector<cv::Mat>>();
-    std::vector<std::pair<int, int>> imgs_size
+    const std::vector<std::pair<int, int>> &imgs_size
         = model_out.getobj("input")
               .get("imgs_size")
               .get<std::vector<std::pair<int, int>>>();
@@ -218,9 +220,9 @@ namespace dd
       }
     // store rotated images into action output store
     APIData action_out;
-    action_out.add("data_raw_img", rimgs);
-    action_out.add("cids", uris);
-    cdata.add_action_data(_action_id, action_out);
+    action_out.add("data_raw_img", std::move(rimgs));
+    action_out.add("cids", std::move(uris));
+    cdata.add_action_data(_action_id, std::move(action_out));
   }
 
   void ClassFilter::apply(APIData &model_out, ChainData &cdata)
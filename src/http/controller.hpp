@@ -36,6 +36,8 @@
 #include "apidata.h"
 #include "oatppjsonapi.h"
 #include "http/dto/info.hpp"
+#include "http/predict_stream.hpp"
+#include "oatpp/web/protocol/http/outgoing/StreamingBody.hpp"
 
 #include OATPP_CODEGEN_BEGIN(ApiController)
 
@@ -103,6 +105,19 @@ public:
     return _oja->jdoc_to_response(janswer);
   }
 
+  ENDPOINT_INFO(get_metrics)
+  {
+    info->summary = "Retreive services metrics, in Prometheus text format";
+  }
+  ENDPOINT("GET", "metrics", get_metrics)
+  {
+    auto response
+        = createResponse(Status::CODE_200, _oja->service_metrics().c_str());
+    response->putHeader(oatpp::web::protocol::http::Header::CONTENT_TYPE,
+                        "text/plain; version=0.0.4");
+    return response;
+  }
+
   ENDPOINT_INFO(create_service)
   {
     info->summary = "Create a service";
@@ -148,10 +163,50 @@ public:
     info->summary = "Predict";
   }
   ENDPOINT("POST", "predict", predict,
+           REQUEST(std::shared_ptr<IncomingRequest>, request),
            BODY_STRING(oatpp::String, predict_data))
   {
-    auto janswer = _oja->service_predict(predict_data.get()->std_str());
-    return _oja->jdoc_to_response(janswer);
+    auto content_type = request->getHeader("Content-Type");
+    auto accept = request->getHeader("Accept");
+    return _oja->predict_to_response(
+        predict_data.get()->std_str(),
+        content_type ? content_type.get()->std_str() : "",
+        accept ? accept.get()->std_str() : "");
+  }
+
+  ENDPOINT_INFO(predict_stream)
+  {
+    info->summary = "Predict from a stream of binary frames";
+  }
+  ENDPOINT("POST", "predict/stream", predict_stream,
+           REQUEST(std::shared_ptr<IncomingRequest>, request),
+           QUERIES(QueryParams, queryParams))
+  {
+    int max_batch_size = 32;
+    auto qs_max_batch_size = queryParams.get("max_batch_size");
+    if (qs_max_batch_size)
+      {
+        try
+          {
+            max_batch_size
+                = boost::lexical_cast<int>(qs_max_batch_size->std_str());
+          }
+        catch (boost::bad_lexical_cast &)
+          {
+            max_batch_size = 0;
+          }
+        if (max_batch_size <= 0)
+          return _oja->jdoc_to_response(_oja->dd_bad_request_400(
+              "max_batch_size must be a strictly positive integer"));
+      }
+    auto body = std::make_shared<
+        oatpp::web::protocol::http::outgoing::StreamingBody>(
+        std::make_shared<dd::http::PredictStream>(_oja, request,
+                                                  max_batch_size));
+    auto response = OutgoingResponse::createShared(Status::CODE_200, body);
+    response->putHeader(oatpp::web::protocol::http::Header::CONTENT_TYPE,
+                        dd::OatppJsonAPI::_frames_mime.c_str());
+    return response;
   }
 
   ENDPOINT_INFO(get_train)
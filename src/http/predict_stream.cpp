@@ -0,0 +1,232 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2021 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "http/predict_stream.hpp"
+#include "oatppjsonapi.h"
+
+#include "oatpp/network/tcp/Connection.hpp"
+
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace dd
+{
+  namespace http
+  {
+    oatpp::v_io_size FrameSink::write(const void *data, v_buff_size count,
+                                      oatpp::async::Action &action)
+    {
+      (void)action;
+      if (!append(static_cast<const char *>(data), count))
+        return oatpp::IOError::BROKEN_PIPE;
+      return count;
+    }
+
+    bool FrameSink::append(const char *data, const size_t &count)
+    {
+      _pending.append(data, count);
+      bool accepted = true;
+      while (accepted && _pending.size() - _pos >= 4)
+        {
+          const unsigned char *len_bytes
+              = reinterpret_cast<const unsigned char *>(_pending.data()
+                                                        + _pos);
+          size_t len = static_cast<size_t>(len_bytes[0])
+                       | static_cast<size_t>(len_bytes[1]) << 8
+                       | static_cast<size_t>(len_bytes[2]) << 16
+                       | static_cast<size_t>(len_bytes[3]) << 24;
+          if (_pending.size() - _pos - 4 < len)
+            break;
+          accepted = _push_frame(_pending.substr(_pos + 4, len));
+          _pos += 4 + len;
+        }
+      if (_pos > 0 && _pos * 2 >= _pending.size())
+        {
+          _pending.erase(0, _pos);
+          _pos = 0;
+        }
+      return accepted;
+    }
+
+    PredictStream::PredictStream(
+        OatppJsonAPI *oja,
+        const std::shared_ptr<oatpp::web::protocol::http::incoming::Request>
+            &request,
+        const int &max_batch_size,
+        const std::chrono::milliseconds &read_timeout)
+        : _oja(oja), _request(request), _max_batch_size(max_batch_size),
+          _max_queued(4 * _max_batch_size), _read_timeout(read_timeout)
+    {
+      _body_thread = std::thread([this]() { read_body(); });
+    }
+
+    PredictStream::~PredictStream()
+    {
+      close();
+      bool body_done = false;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        body_done = _body_done;
+      }
+      // the client may keep the connection open without sending anything
+      if (!body_done)
+        cancel_body();
+      if (_body_thread.joinable())
+        _body_thread.join();
+    }
+
+    void PredictStream::read_body()
+    {
+      FrameSink sink([this](std::string &&frame) {
+        return push_frame(std::move(frame));
+      });
+      bool error = false;
+      try
+        {
+          _request->transferBody(&sink);
+        }
+      catch (...)
+        {
+          error = true;
+        }
+      std::lock_guard<std::mutex> lock(_mutex);
+      _body_done = true;
+      _body_error = !_closed && (error || sink.truncated());
+      _cv.notify_all();
+    }
+
+    bool PredictStream::push_frame(std::string &&frame)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (!_has_call)
+        {
+          _call = std::move(frame);
+          _has_call = true;
+          return !_closed;
+        }
+      // backpressure, the client waits for predictions to catch up
+      _cv.wait(lock, [this]() {
+        return _closed || _frames.size() < _max_queued;
+      });
+      if (_closed)
+        return false;
+      _frames.push_back(std::move(frame));
+      _cv.notify_all();
+      return true;
+    }
+
+    void PredictStream::close()
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _closed = true;
+      _frames.clear();
+      _cv.notify_all();
+    }
+
+    void PredictStream::cancel_body()
+    {
+      auto connection
+          = std::dynamic_pointer_cast<oatpp::network::tcp::Connection>(
+              _request->getConnection());
+      if (connection)
+        ::shutdown(connection->getHandle(), SHUT_RD);
+    }
+
+    bool PredictStream::next_batch(std::vector<std::string> &batch)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (!_cv.wait_for(lock, _read_timeout, [this]() {
+            return !_frames.empty() || _body_done;
+          }))
+        {
+          _body_timeout = true;
+          return false;
+        }
+      while (!_frames.empty() && batch.size() < _max_batch_size)
+        {
+          batch.push_back(std::move(_frames.front()));
+          _frames.pop_front();
+        }
+      _cv.notify_all();
+      return !batch.empty();
+    }
+
+    oatpp::v_io_size PredictStream::read(void *buffer, v_buff_size count,
+                                         oatpp::async::Action &action)
+    {
+      (void)action;
+      while (_out_pos >= _out.size())
+        {
+          _out.clear();
+          _out_pos = 0;
+          if (_done)
+            return 0;
+
+          std::vector<std::string> batch;
+          if (!next_batch(batch))
+            {
+              _done = true;
+              if (_body_timeout)
+                {
+                  close();
+                  _out = JsonAPI::write_frames({ _oja->jrender(
+                      _oja->dd_bad_request_400("request body read timed "
+                                               "out")) });
+                }
+              else if (_body_error)
+                _out = JsonAPI::write_frames({ _oja->jrender(
+                    _oja->dd_bad_request_400("malformed binary frames")) });
+              continue;
+            }
+
+          if (_npredicted == 0)
+            {
+              // data elements are the stream frames only
+              JDoc jcall;
+              jcall.Parse<rapidjson::kParseNanAndInfFlag>(_call.c_str());
+              if (!jcall.HasParseError() && jcall.IsObject()
+                  && (jcall.HasMember("data") || jcall.HasMember("ids")))
+                {
+                  _done = true;
+                  close();
+                  _out = JsonAPI::write_frames({ _oja->jrender(
+                      _oja->dd_bad_request_400("data and ids cannot be set "
+                                               "on a streaming call")) });
+                  continue;
+                }
+            }
+
+          std::string rendered;
+          JDoc janswer = _oja->service_predict(_call, &rendered, &batch,
+                                               nullptr, _npredicted + 1);
+          _npredicted += batch.size();
+          if (rendered.empty())
+            rendered = _oja->jrender(janswer);
+          _out = JsonAPI::write_frames({ rendered });
+        }
+      size_t n = std::min(static_cast<size_t>(count), _out.size() - _out_pos);
+      std::memcpy(buffer, _out.data() + _out_pos, n);
+      _out_pos += n;
+      return n;
+    }
+  }
+}
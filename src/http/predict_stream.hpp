@@ -0,0 +1,180 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2021 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HTTP_PREDICTSTREAM_HPP
+#define HTTP_PREDICTSTREAM_HPP
+
+#include "oatpp/core/data/stream/Stream.hpp"
+#include "oatpp/web/protocol/http/incoming/Request.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dd
+{
+  class OatppJsonAPI;
+
+  namespace http
+  {
+    /**
+     * \brief request body sink, splits incoming bytes into binary frames,
+     *        each one a little-endian uint32 byte length then as many bytes
+     */
+    class FrameSink : public oatpp::data::stream::WriteCallback
+    {
+    public:
+      /**
+       * @param push_frame called on every complete frame, returns false to
+       *        stop the transfer
+       */
+      FrameSink(const std::function<bool(std::string &&)> &push_frame)
+          : _push_frame(push_frame)
+      {
+      }
+
+      oatpp::v_io_size write(const void *data, v_buff_size count,
+                             oatpp::async::Action &action) override;
+
+      /**
+       * \brief appends bytes, pushing the frames they complete
+       * @return false if a frame was refused
+       */
+      bool append(const char *data, const size_t &count);
+
+      /**
+       * \brief whether some bytes do not make a full frame
+       */
+      bool truncated() const
+      {
+        return _pos < _pending.size();
+      }
+
+    private:
+      std::function<bool(std::string &&)> _push_frame;
+      std::string _pending; /**< received bytes. */
+      size_t _pos = 0;      /**< start of the first incomplete frame. */
+    };
+
+    /**
+     * \brief streaming predict call, used as the response body of
+     *        /predict/stream. The request body is a sequence of binary
+     *        frames, the JSON call then data elements, read as they arrive.
+     *        Data elements that arrive together are predicted as one batch,
+     *        and one JSON response frame per batch is written to the
+     *        response body. The request body is no longer read while
+     *        max_queued elements wait for prediction. The response ends
+     *        with an error when no data element arrives for read_timeout.
+     */
+    class PredictStream : public oatpp::data::stream::ReadCallback
+    {
+    public:
+      /**
+       * \brief starts reading the request body
+       * @param oja API to predict from
+       * @param request streaming request
+       * @param max_batch_size maximum number of data elements per batch,
+       *        strictly positive
+       * @param read_timeout maximum wait for the next data element
+       */
+      PredictStream(
+          OatppJsonAPI *oja,
+          const std::shared_ptr<oatpp::web::protocol::http::incoming::Request>
+              &request,
+          const int &max_batch_size,
+          const std::chrono::milliseconds &read_timeout
+          = std::chrono::seconds(60));
+
+      /**
+       * \brief stops reading the request body, cancelling a read in
+       *        progress so that the body thread can be joined
+       */
+      ~PredictStream();
+
+      /**
+       * \brief fills the response body, predicting the next batch when all
+       *        former responses have been sent
+       */
+      oatpp::v_io_size read(void *buffer, v_buff_size count,
+                            oatpp::async::Action &action) override;
+
+    private:
+      /**
+       * \brief reads the request body until its end, on its own thread
+       */
+      void read_body();
+
+      /**
+       * \brief queues a frame received from the request body, waits while
+       *        the queue is full
+       * @return false once the stream is closed
+       */
+      bool push_frame(std::string &&frame);
+
+      /**
+       * \brief stops reading the request body
+       */
+      void close();
+
+      /**
+       * \brief unblocks a pending request body read by shutting down the
+       *        reading side of the connection
+       */
+      void cancel_body();
+
+      /**
+       * \brief waits for data elements
+       * @param batch destination batch
+       * @return false once the request body is over and all elements have
+       *         been consumed, or when no element arrived for read_timeout
+       */
+      bool next_batch(std::vector<std::string> &batch);
+
+      OatppJsonAPI *_oja = nullptr;
+      std::shared_ptr<oatpp::web::protocol::http::incoming::Request> _request;
+      size_t _max_batch_size = 32;
+      size_t _max_queued = 128; /**< max data elements waiting for predict. */
+      std::chrono::milliseconds _read_timeout; /**< max wait for an element. */
+
+      std::thread _body_thread; /**< request body reader. */
+      std::mutex _mutex;
+      std::condition_variable _cv;
+      std::string _call;               /**< JSON call, first frame. */
+      bool _has_call = false;          /**< whether the call was received. */
+      std::deque<std::string> _frames; /**< data elements not yet predicted. */
+      bool _body_done = false;         /**< whether request body is over. */
+      bool _body_error = false; /**< whether request body was malformed. */
+      bool _body_timeout = false; /**< whether the client stopped sending. */
+      bool _closed = false;     /**< whether frames are no longer read. */
+      size_t _npredicted = 0;   /**< data elements predicted so far. */
+
+      std::string _out;    /**< response frames not yet sent. */
+      size_t _out_pos = 0; /**< sent bytes of _out. */
+      bool _done = false;  /**< whether the response is over. */
+    };
+  }
+}
+
+#endif // HTTP_PREDICTSTREAM_HPP
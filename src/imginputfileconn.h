@@ -607,23 +607,23 @@ namespace dd
           if (ad.has("index_uris"))
             _index_uris = ad.get("index_uris").get<std::vector<std::string>>();
 
-          _images = ad.get("data_raw_img").get<std::vector<cv::Mat>>();
+          // raw images are usually ROI views over a former decoded image,
+          // e.g. chain crops, resized straight from the view
+          const std::vector<cv::Mat> &raw_imgs
+              = ad.get("data_raw_img").get<std::vector<cv::Mat>>();
           std::vector<cv::Mat> rimgs;
+          rimgs.reserve(raw_imgs.size());
           std::vector<std::string> uris;
           int i = 0;
-          for (auto img : _images)
+          for (const cv::Mat &img : raw_imgs)
             {
               cv::Mat rimg;
               resize(img, rimg, cv::Size(_width, _height), 0, 0);
               if (_bw && rimg.channels() > 1)
-                {
-                  cv::Mat bwimg;
-                  cv::cvtColor(rimg, bwimg, CV_BGR2GRAY);
-                  rimg = bwimg;
-                }
+                cv::cvtColor(rimg, rimg, CV_BGR2GRAY);
               _images_size.push_back(std::pair<int, int>(img.rows, img.cols));
               if (_keep_orig)
-                _orig_images.push_back(std::move(img));
+                _orig_images.push_back(img);
               if (!_ids.empty())
                 uris.push_back(_ids.at(i));
               else
@@ -634,9 +634,9 @@ namespace dd
               rimgs.push_back(std::move(rimg));
               ++i;
             }
-          _images = rimgs;
+          _images = std::move(rimgs);
           if (!uris.empty())
-            _uris = uris;
+            _uris = std::move(uris);
         }
       else
         InputConnectorStrategy::get_data(ad);
@@ -666,6 +666,17 @@ namespace dd
       std::vector<std::string> meta_uris;
       std::vector<std::string> index_uris;
       std::vector<std::string> failed_uris;
+
+#ifndef WIN32
+      // start all downloads first, decoding then overlaps with transfers
+      std::vector<std::future<http_response>> fetches(_uris.size());
+      for (size_t i = 0; i < _uris.size(); i++)
+        if (DataEl<DDImg>::is_remote(_uris.at(i)))
+          fetches.at(i) = httpfetcher::instance().fetch(
+              _uris.at(i), this->_input_timeout != -1 ? this->_input_timeout
+                                                      : _default_timeout);
+#endif
+
 #pragma omp parallel for
       for (size_t i = 0; i < _uris.size(); i++)
         {
@@ -676,9 +687,17 @@ namespace dd
 
           try
             {
-              if (dimg.read_element(u, this->_logger))
+              int read_err = 0;
+#ifndef WIN32
+              if (fetches.at(i).valid())
+                read_err = dimg.read_fetched(fetches.at(i), this->_logger);
+              else
+#endif
+                read_err = dimg.read_element(u, this->_logger);
+              if (read_err)
                 {
-                  _logger->error("no data for image {}", u);
+                  _logger->error("no data for image {}",
+                                 _ids.empty() ? u : _ids.at(i));
                   no_img = true;
                 }
               if (!dimg._ctype._db_fname.empty())
@@ -690,7 +709,7 @@ namespace dd
               {
                 ++catch_read;
                 catch_msg = e.what();
-                failed_uris.push_back(u);
+                failed_uris.push_back(_ids.empty() ? u : _ids.at(i));
                 no_img = true;
               }
             }
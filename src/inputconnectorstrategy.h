@@ -50,29 +50,53 @@ namespace dd
     {
     }
 
+    /**
+     * \brief whether an element is fetched over the network
+     */
+    static bool is_remote(const std::string &uri)
+    {
+      return uri.rfind("https://", 0) == 0 || uri.rfind("http://", 0) == 0
+             || uri.rfind("file://", 0) == 0;
+    }
+
+#ifndef WIN32
+    /**
+     * \brief starts fetching a remote element, to be read later on with
+     *        read_fetched, so that downloads of several elements overlap
+     */
+    std::future<http_response> fetch(const std::string &uri) const
+    {
+      return httpfetcher::instance().fetch(uri, _timeout);
+    }
+
+    /**
+     * \brief reads a remote element once fetched
+     * @param fetched pending fetch from fetch()
+     */
+    int read_fetched(std::future<http_response> &fetched,
+                     std::shared_ptr<spdlog::logger> &logger)
+    {
+      _ctype._logger = logger;
+      http_response resp = fetched.get();
+      if (resp._code != 200)
+        return -1;
+      _content = std::move(resp._content);
+      return _ctype.read_mem(_content);
+    }
+#endif
+
     int read_element(const std::string &uri,
                      std::shared_ptr<spdlog::logger> &logger, int test_id = -1)
     {
       _ctype._logger = logger;
       bool dir = false;
-      if (uri.rfind("https://", 0) == 0 || uri.rfind("http://", 0) == 0
-          || uri.rfind("file://", 0) == 0)
+      if (is_remote(uri))
         {
 #ifdef WIN32
           return -1;
 #else
-          int outcode = -1;
-          try
-            {
-              httpclient::get_call(uri, "GET", outcode, _content, _timeout);
-            }
-          catch (...)
-            {
-              throw;
-            }
-          if (outcode != 200)
-            return -1;
-          return _ctype.read_mem(_content);
+          std::future<http_response> fetched = fetch(uri);
+          return read_fetched(fetched, logger);
 #endif
         }
       else if (fileops::file_exists(uri, dir))
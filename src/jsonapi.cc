@@ -27,6 +27,7 @@
 #include <rapidjson/reader.h>
 #include <rapidjson/writer.h>
 #include <gflags/gflags.h>
+#include <cstring>
 
 DEFINE_string(service_start_list, "",
               "list of JSON calls to be executed at startup");
@@ -338,6 +339,15 @@ namespace dd
     return jd;
   }
 
+  JDoc JsonAPI::dd_service_busy_1015(const std::string &what) const
+  {
+    JDoc jd;
+    jd.SetObject();
+    render_status(jd, 503, "Service Unavailable", 1015,
+                  what.empty() ? "Service Busy" : what);
+    return jd;
+  }
+
   std::string JsonAPI::jrender(const JDoc &jst) const
   {
     rapidjson::StringBuffer buffer;
@@ -364,6 +374,46 @@ namespace dd
     return buffer.GetString();
   }
 
+  bool JsonAPI::read_frames(const std::string &body,
+                            std::vector<std::string> &frames)
+  {
+    size_t pos = 0;
+    while (pos < body.size())
+      {
+        if (body.size() - pos < 4)
+          return false;
+        const unsigned char *len_bytes
+            = reinterpret_cast<const unsigned char *>(body.data() + pos);
+        size_t len = static_cast<size_t>(len_bytes[0])
+                     | static_cast<size_t>(len_bytes[1]) << 8
+                     | static_cast<size_t>(len_bytes[2]) << 16
+                     | static_cast<size_t>(len_bytes[3]) << 24;
+        pos += 4;
+        if (body.size() - pos < len)
+          return false;
+        frames.emplace_back(body, pos, len);
+        pos += len;
+      }
+    return true;
+  }
+
+  std::string JsonAPI::write_frames(const std::vector<std::string> &frames)
+  {
+    size_t size = 0;
+    for (const std::string &frame : frames)
+      size += 4 + frame.size();
+    std::string body;
+    body.reserve(size);
+    for (const std::string &frame : frames)
+      {
+        uint32_t len = static_cast<uint32_t>(frame.size());
+        for (int b = 0; b < 4; ++b)
+          body.push_back(static_cast<char>((len >> (8 * b)) & 0xff));
+        body.append(frame);
+      }
+    return body;
+  }
+
   JDoc JsonAPI::info(const std::string &jstr) const
   {
     bool status = false;
@@ -435,6 +485,20 @@ namespace dd
     return jinfo;
   }
 
+  std::string JsonAPI::service_metrics() const
+  {
+    std::string out;
+    ServiceStats::prometheus_header(out);
+    auto hit = _mlservices.begin();
+    while (hit != _mlservices.end())
+      {
+        mapbox::util::apply_visitor(visitor_metrics((*hit).first, out),
+                                    (*hit).second);
+        ++hit;
+      }
+    return out;
+  }
+
   JDoc JsonAPI::service_create(const std::string &sname,
                                const std::string &jstr)
   {
@@ -1076,7 +1140,11 @@ namespace dd
     return dd_not_found_404();
   }
 
-  JDoc JsonAPI::service_predict(const std::string &jstr)
+  JDoc JsonAPI::service_predict(const std::string &jstr,
+                                std::string *rendered,
+                                std::vector<std::string> *data_frames,
+                                std::vector<std::string> *out_frames,
+                                const size_t &first_frame)
   {
     rapidjson::Document d;
     d.Parse<rapidjson::kParseNanAndInfFlag>(jstr.c_str());
@@ -1115,9 +1183,46 @@ namespace dd
       {
         return dd_bad_request_400();
       }
+    if (data_frames && !data_frames->empty())
+      {
+        std::vector<std::string> data;
+        if (ad_data.has("data"))
+          {
+            if (!ad_data.get("data").is<std::vector<std::string>>())
+              return dd_bad_request_400("data must be an array of strings");
+            data = ad_data.get("data").get<std::vector<std::string>>();
+          }
+        // raw frames cannot serve as prediction uris, they are identified
+        // by their frame index in the request body unless ids are given
+        bool has_ids = ad_data.has("ids");
+        std::vector<std::string> ids;
+        if (!has_ids)
+          for (size_t i = 0; i < data.size(); ++i)
+            ids.push_back(data.at(i).compare(0, 4, "http") == 0
+                                  || fileops::file_exists(data.at(i))
+                              ? data.at(i)
+                              : std::to_string(i));
+        for (size_t f = 0; f < data_frames->size(); ++f)
+          {
+            data.push_back(std::move(data_frames->at(f)));
+            if (!has_ids)
+              ids.push_back("frame_" + std::to_string(first_frame + f));
+          }
+        ad_data.add("data", std::move(data));
+        if (!has_ids)
+          ad_data.add("ids", std::move(ids));
+      }
 
     // prediction
+    const APIData &ad_output = ad_data.getobj("parameters").getobj("output");
+    bool has_measure = ad_output.has("measure");
+    if (out_frames && (ad_output.has("template") || ad_output.has("network")))
+      return dd_bad_request_400(
+          "binary frames output does not support template or network");
     APIData out;
+    if (rendered && !out_frames && !has_measure && !ad_output.has("template")
+        && !ad_output.has("network"))
+      out.add("render_predictions", true);
     try
       {
         this->predict(
@@ -1144,6 +1249,10 @@ namespace dd
       {
         return dd_train_predict_conflict_1008();
       }
+    catch (MLServiceBusyException &e)
+      {
+        return dd_service_busy_1015(e.what());
+      }
 #ifdef USE_SIMSEARCH
     catch (SimIndexException &e)
       {
@@ -1159,10 +1268,78 @@ namespace dd
         return dd_internal_mllib_error_1007(e.what());
       }
     JDoc jpred = dd_ok_200();
+    if (out.has("predictions_json"))
+      {
+        // predictions were written straight to JSON by the output
+        // connector, wrap them without going through a JSON document
+        JVal jhead(rapidjson::kObjectType);
+        jhead.AddMember("method", "/predict", jpred.GetAllocator());
+        rapidjson::Value service;
+        service.SetString(sname.c_str(), jpred.GetAllocator());
+        jhead.AddMember("service", service, jpred.GetAllocator());
+        jhead.AddMember("time", JVal(out.get("time").get<double>()),
+                        jpred.GetAllocator());
+        jpred.AddMember("head", jhead, jpred.GetAllocator());
+
+        const std::string &jpreds
+            = out.get("predictions_json").get<std::string>();
+        rapidjson::StringBuffer buffer;
+        buffer.Reserve(jpreds.size() + 256);
+        rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>,
+                          rapidjson::UTF8<>, rapidjson::CrtAllocator,
+                          rapidjson::kWriteNanAndInfFlag>
+            writer(buffer);
+        writer.StartObject();
+        writer.Key("status");
+        jpred["status"].Accept(writer);
+        writer.Key("head");
+        jpred["head"].Accept(writer);
+        writer.Key("body");
+        writer.StartObject();
+        writer.Key("predictions");
+        writer.RawValue(jpreds.c_str(), jpreds.size(), rapidjson::kArrayType);
+        writer.EndObject();
+        writer.EndObject();
+        rendered->assign(buffer.GetString(), buffer.GetSize());
+        return jpred;
+      }
+    if (out_frames && out.has("predictions"))
+      {
+        // move prediction vectors to float32 frames, frame 0 is the response
+        std::vector<APIData> preds = out.getv("predictions");
+        for (APIData &pred : preds)
+          {
+            if (!pred.has("vals"))
+              continue;
+            // float32 backend outputs are written as is, others narrowed
+            const ad_variant_type &adv = pred.get("vals");
+            std::vector<float> narrowed;
+            const std::vector<float> *vals = &narrowed;
+            if (adv.is<std::vector<float>>())
+              vals = &adv.get<std::vector<float>>();
+            else if (adv.is<std::vector<double>>())
+              narrowed.assign(adv.get<std::vector<double>>().begin(),
+                              adv.get<std::vector<double>>().end());
+            else
+              continue;
+            // little-endian whatever the host byte order
+            std::string frame(vals->size() * sizeof(float), '\0');
+            for (size_t i = 0; i < vals->size(); ++i)
+              {
+                uint32_t bits = 0;
+                std::memcpy(&bits, &(*vals)[i], sizeof(float));
+                for (int b = 0; b < 4; ++b)
+                  frame[4 * i + b]
+                      = static_cast<char>((bits >> (8 * b)) & 0xff);
+              }
+            out_frames->push_back(std::move(frame));
+            pred.erase("vals");
+            pred.add("vals_frame", static_cast<int>(out_frames->size()));
+          }
+        out.add("predictions", std::move(preds));
+      }
     JVal jout(rapidjson::kObjectType);
     out.toJVal(jpred, jout);
-    bool has_measure
-        = ad_data.getobj("parameters").getobj("output").has("measure");
     JVal jhead(rapidjson::kObjectType);
     jhead.AddMember("method", "/predict", jpred.GetAllocator());
     rapidjson::Value service;
@@ -1181,15 +1358,9 @@ namespace dd
       jbody.AddMember("predictions", jout["predictions"],
                       jpred.GetAllocator());
     jpred.AddMember("body", jbody, jpred.GetAllocator());
-    if (ad_data.getobj("parameters").getobj("output").has("template")
-        && ad_data.getobj("parameters")
-                   .getobj("output")
-                   .get("template")
-                   .get<std::string>()
-               != "")
-      {
-        APIData ad_params = ad_data.getobj("parameters");
-        APIData ad_output = ad_params.getobj("output");
+    if (ad_output.has("template")
+        && ad_output.get("template").get<std::string>() != "")
+      {
         jpred.AddMember(
             "template",
             JVal().SetString(
@@ -1197,13 +1368,10 @@ namespace dd
                 jpred.GetAllocator()),
             jpred.GetAllocator());
       }
-    if (ad_data.getobj("parameters").getobj("output").has("network"))
+    if (ad_output.has("network"))
       {
-        APIData ad_params = ad_data.getobj("parameters");
-        APIData ad_output = ad_params.getobj("output");
-        APIData ad_net = ad_output.getobj("network");
         JVal jnet(rapidjson::kObjectType);
-        ad_net.toJVal(jpred, jnet);
+        ad_output.getobj("network").toJVal(jpred, jnet);
         jpred.AddMember("network", jnet, jpred.GetAllocator());
       }
     return jpred;
@@ -1561,6 +1729,10 @@ namespace dd
       {
         return dd_train_predict_conflict_1008();
       }
+    catch (MLServiceBusyException &e)
+      {
+        return dd_service_busy_1015(e.what());
+      }
 #ifdef USE_SIMSEARCH
     catch (SimIndexException &e)
       {
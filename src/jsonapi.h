@@ -84,11 +84,29 @@ namespace dd
     JDoc dd_action_bad_request_1012(const std::string &what = "") const;
     JDoc dd_action_internal_error_1013(const std::string &what = "") const;
     JDoc dd_service_already_exists_1014() const;
+    JDoc dd_service_busy_1015(const std::string &what = "") const;
 
     // JSON rendering
     std::string jrender(const JDoc &jst) const;
     std::string jrender(const JVal &jval) const;
 
+    // binary frames, as a little-endian uint32 length followed by bytes
+    /**
+     * \brief splits a binary body into frames
+     * @param body binary body
+     * @param frames destination frames
+     * @return false if the body is truncated
+     */
+    static bool read_frames(const std::string &body,
+                            std::vector<std::string> &frames);
+
+    /**
+     * \brief concatenates frames into a binary body
+     * @param frames source frames
+     * @return binary body
+     */
+    static std::string write_frames(const std::vector<std::string> &frames);
+
     // resources
     // return a JSON document for every API call
     JDoc info(const std::string &jstr) const;
@@ -96,7 +114,25 @@ namespace dd
     JDoc service_status(const std::string &sname);
     JDoc service_delete(const std::string &sname, const std::string &jstr);
 
-    JDoc service_predict(const std::string &jstr);
+    /**
+     * \brief predict call
+     * @param jstr JSON call body
+     * @param rendered if not null, receives the full JSON response when
+     *        predictions could be written directly by the output connector,
+     *        in which case the returned document only holds status and head
+     * @param data_frames if not null, raw data elements (e.g. encoded image
+     *        bytes) moved to the end of the call data
+     * @param out_frames if not null, receives prediction vectors as packed
+     *        float32 arrays, each replaced in the response by the index of
+     *        its frame
+     * @param first_frame index of the first data frame in the request
+     *        body, data frames are named after it when no ids are given
+     */
+    JDoc service_predict(const std::string &jstr,
+                         std::string *rendered = nullptr,
+                         std::vector<std::string> *data_frames = nullptr,
+                         std::vector<std::string> *out_frames = nullptr,
+                         const size_t &first_frame = 1);
 
     JDoc service_train(const std::string &jstr);
     JDoc service_train_status(const std::string &jstr);
@@ -104,6 +140,9 @@ namespace dd
 
     JDoc service_chain(const std::string &cname, const std::string &jstr);
 
+    // services metrics, in Prometheus text format
+    std::string service_metrics() const;
+
     static int store_json_blob(const std::string &model_repo,
                                const std::string &jstr,
                                const std::string &jfilename = "");
@@ -141,6 +180,28 @@ namespace dd
     bool _status = false;
   };
 
+  /**
+   * \brief visitor class for service metrics call
+   */
+  class visitor_metrics
+  {
+  public:
+    visitor_metrics(const std::string &sname, std::string &out)
+        : _sname(sname), _out(out)
+    {
+    }
+    ~visitor_metrics()
+    {
+    }
+
+    template <typename T> void operator()(T &mllib)
+    {
+      mllib._stats.to_prometheus(_sname, _out);
+    }
+    std::string _sname;
+    std::string &_out;
+  };
+
   /**
    * \brief visitor class for service status call
    */
@@ -132,6 +132,10 @@ namespace dd
             _se->_tse->_ondisk = ad.get("ondisk").get<bool>();
           if (ad.has("nprobe"))
             _se->_tse->_nprobe = ad.get("nprobe").get<int>();
+          if (ad.has("index_shards"))
+            _se->_tse->_nshards = ad.get("index_shards").get<int>();
+          if (ad.has("index_merge_size"))
+            _se->_tse->_merge_size = ad.get("index_merge_size").get<int>();
 #ifdef USE_GPU_FAISS
           if (ad.has("index_gpu"))
             _se->_tse->_gpu = ad.get("index_gpu").get<bool>();
@@ -32,6 +32,10 @@
 #include <string>
 #include <future>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <memory>
 //#include <shared_mutex>
 #include "dd_spdlog.h"
 #include <boost/thread/shared_mutex.hpp>
@@ -63,6 +67,27 @@ namespace dd
     std::string _s;
   };
 
+  /**
+   * \brief busy service exception, when the predict queue is full
+   */
+  class MLServiceBusyException : public std::exception
+  {
+  public:
+    MLServiceBusyException(const std::string &s) : _s(s)
+    {
+    }
+    ~MLServiceBusyException()
+    {
+    }
+    const char *what() const noexcept
+    {
+      return _s.c_str();
+    }
+
+  private:
+    std::string _s;
+  };
+
   /**
    * \brief training job
    */
@@ -90,6 +115,86 @@ namespace dd
         = 0; /**< 0: not started, 1: running, 2: finished or terminated */
   };
 
+  /**
+   * \brief predict job, queued for merging with concurrent predict calls
+   *        into a single backend batch
+   */
+  class pjob
+  {
+  public:
+    pjob(const APIData &ad)
+        : _ad(ad), _tstart(std::chrono::steady_clock::now())
+    {
+      _data = ad.get("data").get<std::vector<std::string>>();
+      if (ad.has("ids"))
+        _uris = ad.get("ids").get<std::vector<std::string>>();
+      else
+        for (size_t i = 0; i < _data.size(); i++)
+          {
+            // files and URLs keep their name as uri, inline data is
+            // identified by its position in the call
+            const std::string &d = _data.at(i);
+            if (d.compare(0, 4, "http") == 0 || fileops::file_exists(d))
+              _uris.push_back(d);
+            else
+              _uris.push_back(std::to_string(i));
+          }
+
+      // calls are merged only if their parameters are identical
+      JDoc jd;
+      jd.SetObject();
+      ad.getobj("parameters").toJDoc(jd);
+      rapidjson::StringBuffer buffer;
+      rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+      jd.Accept(writer);
+      _key = buffer.GetString();
+    }
+    ~pjob()
+    {
+    }
+
+    /**
+     * \brief whether a predict call can be merged with others
+     * @param ad root data object
+     * @param chain whether the call is part of a chain
+     */
+    static bool batchable(const APIData &ad, const bool &chain)
+    {
+      if (chain || !ad.has("data")
+          || !ad.get("data").is<std::vector<std::string>>()
+          || ad.has("meta_uris") || ad.has("index_uris"))
+        return false;
+      const APIData &ad_out = ad.getobj("parameters").getobj("output");
+      if (ad_out.has("measure") || ad_out.has("template")
+          || ad_out.has("network") || ad_out.has("index"))
+        return false;
+      // a directory yields several samples that cannot be told apart by
+      // the single id it gets in a batch
+      for (const std::string &d :
+           ad.get("data").get<std::vector<std::string>>())
+        {
+          bool dir = false;
+          if (d.compare(0, 4, "http") != 0 && fileops::file_exists(d, dir)
+              && dir)
+            return false;
+        }
+      return true;
+    }
+
+    const APIData &_ad; /**< caller's root data object. */
+    std::vector<std::string> _data; /**< input data. */
+    std::vector<std::string>
+        _uris; /**< uris to report back to the caller. */
+    std::string _key; /**< merging key, i.e. rendered call parameters. */
+    std::chrono::steady_clock::time_point
+        _tstart; /**< date at which the job was queued. */
+
+    APIData _out;            /**< output data object for this job only. */
+    int _status = 0;         /**< predict status. */
+    std::exception_ptr _eptr; /**< predict error, if any. */
+    bool _done = false;      /**< whether the output is ready. */
+  };
+
   /**
    * \brief main machine learning service encapsulation
    */
@@ -126,7 +231,11 @@ namespace dd
           _description(std::move(mls._description)),
           _init_parameters(std::move(mls._init_parameters)),
           _tjobs_counter(mls._tjobs_counter.load()),
-          _training_jobs(std::move(mls._training_jobs))
+          _training_jobs(std::move(mls._training_jobs)),
+          _batch_max_size(mls._batch_max_size),
+          _batch_max_wait_us(mls._batch_max_wait_us),
+          _predict_replicas(mls._predict_replicas),
+          _predict_max_queue(mls._predict_max_queue)
     {
     }
 
@@ -160,6 +269,33 @@ namespace dd
       this->_outputc.init(_init_parameters.getobj("output"));
       this->init_mllib(_init_parameters.getobj("mllib"));
       this->fillup_measures_history(ad);
+
+      APIData ad_mllib = _init_parameters.getobj("mllib");
+      if (ad_mllib.has("batching"))
+        {
+          APIData ad_batching = ad_mllib.getobj("batching");
+          if (ad_batching.has("max_batch_size"))
+            _batch_max_size = ad_batching.get("max_batch_size").get<int>();
+          if (ad_batching.has("max_wait_us"))
+            _batch_max_wait_us = ad_batching.get("max_wait_us").get<int>();
+          if (_batch_max_size < 0 || _batch_max_wait_us < 0)
+            throw MLLibBadParamException(
+                "batching max_batch_size and max_wait_us must be positive");
+        }
+      if (ad_mllib.has("replicas"))
+        {
+          _predict_replicas = ad_mllib.get("replicas").get<int>();
+          if (_predict_replicas < 0)
+            throw MLLibBadParamException("replicas must be non-negative");
+          _predict_max_queue = 8 * _predict_replicas;
+        }
+      if (ad_mllib.has("predict_queue"))
+        {
+          _predict_max_queue = ad_mllib.get("predict_queue").get<int>();
+          if (_predict_max_queue < 0)
+            throw MLLibBadParamException(
+                "predict_queue must be non-negative");
+        }
     }
 
     /**
@@ -492,18 +628,46 @@ namespace dd
     }
 
     /**
-     * \brief starts a predict job, makes sure no training call is running.
+     * \brief starts a predict job, possibly merged with concurrent calls
+     *        when server-side batching is enabled.
      * @param ad root data object
      * @param out output data object
      * @return predict job status
      */
     int predict_job(const APIData &ad, APIData &out, const bool &chain = false)
+    {
+      if (_batch_max_size > 1 && pjob::batchable(ad, chain))
+        return predict_batched(ad, out);
+      return predict_direct(ad, out, chain);
+    }
+
+    /**
+     * \brief runs a predict call, makes sure no training call is running.
+     *        When the service has a bounded number of replicas, waits for
+     *        one of them to be available.
+     * @param ad root data object
+     * @param out output data object
+     * @return predict job status
+     */
+    int predict_direct(const APIData &ad, APIData &out,
+                       const bool &chain = false)
     {
       if (!_train_mutex.try_lock_shared())
         throw MLServiceLockException(
             "Predict call while training with an offline learning algorithm");
 
-      this->_stats.predict_start();
+      try
+        {
+          acquire_replica();
+        }
+      catch (...)
+        {
+          _train_mutex.unlock_shared();
+          throw;
+        }
+
+      ServiceCallTimer timer;
+      this->_stats.predict_start(timer);
 
       int err = 0;
       try
@@ -512,18 +676,264 @@ namespace dd
             const_cast<APIData &>(ad).add("chain", true);
           err = this->predict(ad, out);
         }
-      catch (std::exception &e)
+      catch (...)
         {
+          release_replica();
           _train_mutex.unlock_shared();
-          this->_stats.predict_end(false);
+          this->_stats.predict_end(timer, false);
           throw;
         }
-      this->_stats.predict_end(true);
+      this->_stats.predict_end(timer, true);
 
+      release_replica();
       _train_mutex.unlock_shared();
       return err;
     }
 
+    /**
+     * \brief waits for a free predict replica, or fails if too many calls
+     *        are already waiting
+     */
+    void acquire_replica()
+    {
+      if (_predict_replicas <= 0)
+        return;
+      std::unique_lock<std::mutex> lock(_predict_mutex);
+      if (_predict_running >= _predict_replicas)
+        {
+          if (_predict_waiting >= _predict_max_queue)
+            {
+              this->_stats.predict_rejected();
+              throw MLServiceBusyException(
+                  "Predict queue is full, " + std::to_string(_predict_waiting)
+                  + " calls waiting for " + std::to_string(_predict_replicas)
+                  + " replicas");
+            }
+          ++_predict_waiting;
+          this->_stats.predict_queued();
+          _predict_cv.wait(lock, [this]() {
+            return _predict_running < _predict_replicas;
+          });
+          --_predict_waiting;
+          this->_stats.predict_dequeued();
+        }
+      ++_predict_running;
+    }
+
+    /**
+     * \brief hands a predict replica back to the pool
+     */
+    void release_replica()
+    {
+      if (_predict_replicas <= 0)
+        return;
+      {
+        std::lock_guard<std::mutex> lock(_predict_mutex);
+        --_predict_running;
+      }
+      _predict_cv.notify_one();
+    }
+
+    /**
+     * \brief queues a predict call until enough concurrent calls with the
+     *        same parameters are gathered or the max wait time is reached,
+     *        and runs them as a single backend batch. The first waiting
+     *        thread that finds no batch being assembled collects and runs
+     *        the next one, so no dispatcher thread is needed.
+     * @param ad root data object
+     * @param out output data object
+     * @return predict job status
+     */
+    int predict_batched(const APIData &ad, APIData &out)
+    {
+      auto job = std::make_shared<pjob>(ad);
+      std::unique_lock<std::mutex> lock(_batch_mutex);
+      _batch_queue.push_back(job);
+      _batch_cv.notify_all();
+      while (!job->_done)
+        {
+          if (_batch_collecting || _batch_queue.empty())
+            {
+              _batch_cv.wait(lock);
+              continue;
+            }
+          _batch_collecting = true;
+          std::vector<std::shared_ptr<pjob>> batch = collect_batch(lock);
+          _batch_collecting = false;
+          _batch_cv.notify_all();
+          lock.unlock();
+          run_batch(batch);
+          lock.lock();
+          for (auto &bjob : batch)
+            bjob->_done = true;
+          _batch_cv.notify_all();
+        }
+      lock.unlock();
+      if (job->_eptr)
+        std::rethrow_exception(job->_eptr);
+      out = std::move(job->_out);
+      return job->_status;
+    }
+
+    /**
+     * \brief waits for the batch at the head of the queue to fill up, then
+     *        removes it from the queue
+     * @param lock lock held over the batching queue
+     * @return jobs to be run together
+     */
+    std::vector<std::shared_ptr<pjob>>
+    collect_batch(std::unique_lock<std::mutex> &lock)
+    {
+      const std::string key = _batch_queue.front()->_key;
+      auto deadline = _batch_queue.front()->_tstart
+                      + std::chrono::microseconds(_batch_max_wait_us);
+      auto queued_samples = [this, &key]() {
+        int nsamples = 0;
+        for (const auto &qjob : _batch_queue)
+          if (qjob->_key == key)
+            nsamples += qjob->_data.size();
+        return nsamples;
+      };
+      while (queued_samples() < _batch_max_size
+             && std::chrono::steady_clock::now() < deadline)
+        _batch_cv.wait_until(lock, deadline);
+
+      std::vector<std::shared_ptr<pjob>> batch;
+      int nsamples = 0;
+      auto qit = _batch_queue.begin();
+      while (qit != _batch_queue.end())
+        {
+          int jsize = (*qit)->_data.size();
+          if ((*qit)->_key == key
+              && (batch.empty() || nsamples + jsize <= _batch_max_size))
+            {
+              nsamples += jsize;
+              batch.push_back(std::move(*qit));
+              qit = _batch_queue.erase(qit);
+            }
+          else
+            ++qit;
+        }
+      return batch;
+    }
+
+    /**
+     * \brief runs a set of predict jobs as a single predict call, and
+     *        scatters the predictions back to each job
+     * @param batch jobs to run
+     */
+    void run_batch(std::vector<std::shared_ptr<pjob>> &batch)
+    {
+      if (batch.size() == 1)
+        {
+          run_job(*batch.at(0));
+          return;
+        }
+
+      // merge inputs, tagging each of them with its job and position
+      APIData ad_batch = batch.at(0)->_ad;
+      std::vector<std::string> data;
+      std::vector<std::string> ids;
+      std::unordered_map<std::string, std::pair<size_t, size_t>> tags;
+      for (size_t k = 0; k < batch.size(); k++)
+        for (size_t i = 0; i < batch.at(k)->_data.size(); i++)
+          {
+            std::string tag
+                = "batch_" + std::to_string(k) + "_" + std::to_string(i);
+            data.push_back(batch.at(k)->_data.at(i));
+            ids.push_back(tag);
+            tags.insert(std::make_pair(tag, std::make_pair(k, i)));
+          }
+      ad_batch.add("data", data);
+      ad_batch.add("ids", ids);
+
+      // unless set by the caller, forward all samples at once
+      APIData ad_params = ad_batch.getobj("parameters");
+      APIData ad_mllib = ad_params.getobj("mllib");
+      APIData ad_net = ad_mllib.getobj("net");
+      if (!ad_net.has("test_batch_size"))
+        {
+          ad_net.add("test_batch_size", static_cast<int>(data.size()));
+          ad_mllib.add("net", ad_net);
+          ad_params.add("mllib", ad_mllib);
+          ad_batch.add("parameters", ad_params);
+        }
+
+      APIData out_batch;
+      int status = 0;
+      try
+        {
+          status = predict_direct(ad_batch, out_batch);
+        }
+      catch (...)
+        {
+          // replay calls one by one so that an error is only reported to
+          // the call that caused it
+          this->_logger->warn("batched predict call failed, replaying {} "
+                              "calls separately",
+                              batch.size());
+          for (auto &job : batch)
+            run_job(*job);
+          return;
+        }
+
+      std::vector<std::vector<APIData>> preds(batch.size());
+      std::vector<std::vector<bool>> predicted(batch.size());
+      for (size_t k = 0; k < batch.size(); k++)
+        predicted.at(k).resize(batch.at(k)->_data.size(), false);
+      size_t nmatched = 0;
+      for (APIData pred : out_batch.getv("predictions"))
+        {
+          if (!pred.has("uri") || !pred.get("uri").is<std::string>())
+            continue;
+          auto hit = tags.find(pred.get("uri").get<std::string>());
+          if (hit == tags.end())
+            continue;
+          size_t k = (*hit).second.first;
+          size_t i = (*hit).second.second;
+          pred.add("uri", batch.at(k)->_uris.at(i));
+          preds.at(k).push_back(std::move(pred));
+          predicted.at(k).at(i) = true;
+          ++nmatched;
+        }
+
+      if (nmatched == 0)
+        this->_logger->warn("input connector does not report predict ids, "
+                            "replaying {} batched calls separately",
+                            batch.size());
+
+      for (size_t k = 0; k < batch.size(); k++)
+        {
+          const std::vector<bool> &jpredicted = predicted.at(k);
+          if (std::find(jpredicted.begin(), jpredicted.end(), false)
+              != jpredicted.end())
+            {
+              // some samples got no prediction in the batch, replay the call
+              run_job(*batch.at(k));
+              continue;
+            }
+          batch.at(k)->_out = out_batch;
+          batch.at(k)->_out.add("predictions", preds.at(k));
+          batch.at(k)->_status = status;
+        }
+    }
+
+    /**
+     * \brief runs a single predict job
+     * @param job job to run
+     */
+    void run_job(pjob &job)
+    {
+      try
+        {
+          job._status = predict_direct(job._ad, job._out);
+        }
+      catch (...)
+        {
+          job._eptr = std::current_exception();
+        }
+    }
+
     std::string _sname;       /**< service name. */
     std::string _description; /**< optional description of the service. */
     APIData _init_parameters; /**< service creation parameters. */
@@ -535,6 +945,30 @@ namespace dd
                         // terminated
     std::unordered_map<int, APIData> _training_out;
     boost::shared_mutex _train_mutex;
+
+    int _batch_max_size
+        = 0; /**< max number of samples merged into a predict batch, 0 or 1
+                disables server-side batching. */
+    int _batch_max_wait_us
+        = 0; /**< max time a predict call waits for others to join its
+                batch, in microseconds. */
+    std::mutex _batch_mutex; /**< mutex around the batching queue. */
+    std::condition_variable
+        _batch_cv; /**< signals new queued calls and finished batches. */
+    std::deque<std::shared_ptr<pjob>>
+        _batch_queue; /**< predict calls waiting for a batch. */
+    bool _batch_collecting
+        = false; /**< whether a thread is assembling the next batch. */
+
+    int _predict_replicas = 0; /**< max number of concurrent predict calls,
+                                  0 means unbounded. */
+    int _predict_max_queue
+        = 0; /**< max number of predict calls waiting for a replica. */
+    int _predict_running = 0; /**< number of running predict calls. */
+    int _predict_waiting = 0; /**< number of waiting predict calls. */
+    std::mutex _predict_mutex; /**< mutex around predict replicas. */
+    std::condition_variable
+        _predict_cv; /**< signals a predict replica is available. */
   };
 
 }
@@ -164,8 +164,9 @@ namespace dd
     return buffer.GetString();
   }
 
-  std::shared_ptr<oatpp::web::protocol::http::outgoing::Response>
-  OatppJsonAPI::jdoc_to_response(const JDoc &janswer)
+  const std::string OatppJsonAPI::_frames_mime = "application/octet-stream";
+
+  void OatppJsonAPI::set_access_log_service(const JDoc &janswer)
   {
     // NOTE(sileht): Maybe not the best place to do this, but we need DTO in
     // all calls before doing it otherwise
@@ -175,6 +176,13 @@ namespace dd
         if (!service.empty())
           dd::http::setAccessLogServiceName(service);
       }
+  }
+
+  std::shared_ptr<oatpp::web::protocol::http::outgoing::Response>
+  OatppJsonAPI::jdoc_to_response(const JDoc &janswer,
+                                 const std::string &rendered)
+  {
+    set_access_log_service(janswer);
 
     int outcode = janswer["status"]["code"].GetInt();
     std::string stranswer;
@@ -186,6 +194,10 @@ namespace dd
         mustache::RenderTemplate(tpl, " ", janswer, &sg);
         stranswer = sg.str();
       }
+    else if (!rendered.empty())
+      {
+        stranswer = rendered;
+      }
     else
       {
         stranswer = jrender(janswer);
@@ -236,6 +248,54 @@ namespace dd
     return response;
   }
 
+  std::shared_ptr<oatpp::web::protocol::http::outgoing::Response>
+  OatppJsonAPI::predict_to_response(const std::string &body,
+                                    const std::string &content_type,
+                                    const std::string &accept)
+  {
+    bool frames_in = content_type.rfind(_frames_mime, 0) == 0;
+    bool frames_out = accept.find(_frames_mime) != std::string::npos;
+    if (!frames_in && !frames_out)
+      {
+        std::string rendered;
+        JDoc janswer = service_predict(body, &rendered);
+        return jdoc_to_response(janswer, rendered);
+      }
+
+    // first frame is the JSON call, others are data elements
+    std::vector<std::string> data_frames;
+    std::string jstr;
+    if (frames_in)
+      {
+        if (!read_frames(body, data_frames) || data_frames.empty())
+          return jdoc_to_response(
+              dd_bad_request_400("malformed binary frames"));
+        jstr = std::move(data_frames.front());
+        data_frames.erase(data_frames.begin());
+      }
+    else
+      jstr = body;
+
+    std::vector<std::string> out_frames;
+    JDoc janswer = service_predict(jstr, nullptr, &data_frames,
+                                   frames_out ? &out_frames : nullptr);
+    if (!frames_out)
+      return jdoc_to_response(janswer);
+
+    // first frame is the JSON response, others are prediction vectors
+    set_access_log_service(janswer);
+    out_frames.insert(out_frames.begin(), jrender(janswer));
+    std::string stranswer = write_frames(out_frames);
+    auto response = oatpp::web::protocol::http::outgoing::ResponseFactory::
+        createResponse(
+            oatpp::web::protocol::http::Status(
+                janswer["status"]["code"].GetInt(), ""),
+            oatpp::String(stranswer.data(), stranswer.size(), true));
+    response->putHeader(oatpp::web::protocol::http::Header::CONTENT_TYPE,
+                        _frames_mime.c_str());
+    return response;
+  }
+
   void OatppJsonAPI::terminate(int signal)
   {
     (void)signal;
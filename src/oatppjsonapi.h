@@ -43,7 +43,24 @@ namespace dd
     std::string
     uri_query_to_json(oatpp::web::protocol::http::QueryParams queryParams);
     std::shared_ptr<oatpp::web::protocol::http::outgoing::Response>
-    jdoc_to_response(const JDoc &janswer);
+    jdoc_to_response(const JDoc &janswer, const std::string &rendered = "");
+
+    /**
+     * \brief /predict call, body and response are either JSON or binary
+     *        frames, as selected by the Content-Type and Accept headers
+     * @param body call body
+     * @param content_type body content type
+     * @param accept accepted response content types
+     */
+    std::shared_ptr<oatpp::web::protocol::http::outgoing::Response>
+    predict_to_response(const std::string &body,
+                        const std::string &content_type,
+                        const std::string &accept);
+
+    static const std::string _frames_mime; /**< binary frames mime type. */
+
+  private:
+    void set_access_log_service(const JDoc &janswer);
   };
 }
 
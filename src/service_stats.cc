@@ -20,7 +20,9 @@
  * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 
 #include "apidata.h"
 #include "service_stats.h"
@@ -28,27 +30,150 @@
 namespace dd
 {
 
+  /*- LatencyHistogram -*/
+  size_t LatencyHistogram::bucket(uint64_t us)
+  {
+    if (us < (2u << _sub_bits))
+      return us;
+    us = std::min(us, (uint64_t(1) << _max_bits) - 1);
+    int e = 63 - __builtin_clzll(us); // e > _sub_bits
+    uint64_t sub = (us >> (e - _sub_bits)) & ((1 << _sub_bits) - 1);
+    return (2 << _sub_bits) + (e - _sub_bits - 1) * (1 << _sub_bits) + sub;
+  }
+
+  uint64_t LatencyHistogram::bucket_upper(const size_t &b)
+  {
+    if (b < (2u << _sub_bits))
+      return b + 1;
+    size_t r = b - (2 << _sub_bits);
+    int e = r / (1 << _sub_bits) + _sub_bits + 1;
+    uint64_t sub = r % (1 << _sub_bits);
+    return ((1 << _sub_bits) + sub + 1) << (e - _sub_bits);
+  }
+
+  void LatencyHistogram::record(const std::chrono::steady_clock::duration &d)
+  {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    if (us < 0)
+      us = 0;
+    _counts[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+    _sum_us.fetch_add(us, std::memory_order_relaxed);
+  }
+
+  uint64_t LatencyHistogram::count() const
+  {
+    uint64_t n = 0;
+    for (const auto &c : _counts)
+      n += c.load(std::memory_order_relaxed);
+    return n;
+  }
+
+  double LatencyHistogram::quantile_ms(const double &q) const
+  {
+    std::array<uint64_t, _nbuckets> counts;
+    uint64_t n = 0;
+    for (size_t b = 0; b < _nbuckets; ++b)
+      n += counts[b] = _counts[b].load(std::memory_order_relaxed);
+    if (n == 0)
+      return 0.0;
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(q * n));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < _nbuckets; ++b)
+      {
+        seen += counts[b];
+        if (seen >= rank)
+          return bucket_upper(b) / 1000.0;
+      }
+    return bucket_upper(_nbuckets - 1) / 1000.0;
+  }
+
+  void LatencyHistogram::to(APIData &ad) const
+  {
+    ad.add("count", static_cast<int>(count()));
+    ad.add("p50", quantile_ms(0.5));
+    ad.add("p90", quantile_ms(0.9));
+    ad.add("p99", quantile_ms(0.99));
+    ad.add("p999", quantile_ms(0.999));
+  }
+
+  void LatencyHistogram::to_prometheus(const std::string &name,
+                                       const std::string &labels,
+                                       std::string &out) const
+  {
+    for (const std::string q : { "0.5", "0.9", "0.99", "0.999" })
+      out += name + "{" + labels + ",quantile=\"" + q + "\"} "
+             + std::to_string(quantile_ms(std::stod(q)) / 1000.0) + "\n";
+    out += name + "_sum{" + labels + "} "
+           + std::to_string(_sum_us.load() / 1e6) + "\n";
+    out += name + "_count{" + labels + "} " + std::to_string(count())
+           + "\n";
+  }
+
+  /*- ServiceStats -*/
+  static thread_local ServiceCallTimer *current_call
+      = nullptr; /**< predict call running on this thread. */
+
   void ServiceStats::inc_inference_count(const int &l)
   {
     _inference_count += l;
   }
   void ServiceStats::transform_start()
   {
-    _transform_tstart = std::chrono::steady_clock::now();
+    if (current_call)
+      current_call->_transform_start = std::chrono::steady_clock::now();
   }
   void ServiceStats::transform_end()
   {
-    auto tend = std::chrono::steady_clock::now();
-    _transform_total_duration_ms += tend - _transform_tstart;
+    if (current_call)
+      current_call->_transform_end = std::chrono::steady_clock::now();
   }
 
-  void ServiceStats::predict_start()
+  void ServiceStats::output_start()
+  {
+    if (current_call)
+      current_call->_output_start = std::chrono::steady_clock::now();
+  }
+  void ServiceStats::output_end()
   {
-    _predict_tstart = std::chrono::steady_clock::now();
+    if (current_call)
+      current_call->_output_end = std::chrono::steady_clock::now();
   }
 
-  void ServiceStats::predict_end(bool succeed)
+  void ServiceStats::predict_start(ServiceCallTimer &timer)
   {
+    timer._start = std::chrono::steady_clock::now();
+    timer._prev = current_call;
+    current_call = &timer;
+  }
+
+  void ServiceStats::predict_end(ServiceCallTimer &timer, bool succeed)
+  {
+    typedef ServiceCallTimer::time_point time_point;
+    time_point tend = std::chrono::steady_clock::now();
+    current_call = timer._prev;
+
+    // unmarked stages fall back to their neighbours
+    time_point unset;
+    time_point inference_start = timer._transform_end != unset
+                                     ? timer._transform_end
+                                     : timer._start;
+    time_point inference_end
+        = timer._output_start != unset ? timer._output_start : tend;
+    auto transform_duration = timer._transform_start != unset
+                                      && timer._transform_end != unset
+                                  ? timer._transform_end
+                                        - timer._transform_start
+                                  : std::chrono::steady_clock::duration(0);
+
+    _total_hist.record(tend - timer._start);
+    if (timer._transform_start != unset)
+      _transform_hist.record(transform_duration);
+    _inference_hist.record(inference_end - inference_start);
+    if (timer._output_start != unset)
+      _output_hist.record(
+          (timer._output_end != unset ? timer._output_end : tend)
+          - timer._output_start);
+
     std::lock_guard<std::mutex> lock(_mutex);
 
     if (succeed)
@@ -56,8 +181,8 @@ namespace dd
     else
       _predict_failure++;
 
-    auto tend = std::chrono::steady_clock::now();
-    _predict_total_duration_ms += tend - _predict_tstart;
+    _predict_total_duration_ms += tend - timer._start;
+    _transform_total_duration_ms += transform_duration;
 
     int _predict_count = _predict_success + _predict_failure;
     _avg_batch_size = _inference_count / static_cast<double>(_predict_count);
@@ -67,6 +192,26 @@ namespace dd
                                / static_cast<double>(_predict_count);
   }
 
+  void ServiceStats::predict_queued()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_predict_queue_depth;
+    _predict_queue_max_depth
+        = std::max(_predict_queue_max_depth, _predict_queue_depth);
+  }
+
+  void ServiceStats::predict_dequeued()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    --_predict_queue_depth;
+  }
+
+  void ServiceStats::predict_rejected()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_predict_rejected;
+  }
+
   void ServiceStats::to(APIData &ad) const
   {
     std::lock_guard<std::mutex> lock(_mutex);
@@ -85,6 +230,21 @@ namespace dd
     stats.add("total_predict_duration_ms", _predict_total_duration_ms.count());
     stats.add("total_transform_duration_ms",
               _transform_total_duration_ms.count());
+    stats.add("predict_queue_depth", _predict_queue_depth);
+    stats.add("predict_queue_max_depth", _predict_queue_max_depth);
+    stats.add("predict_rejected", _predict_rejected);
+
+    APIData latency;
+    APIData total, transform, inference, output;
+    _total_hist.to(total);
+    _transform_hist.to(transform);
+    _inference_hist.to(inference);
+    _output_hist.to(output);
+    latency.add("total", total);
+    latency.add("transform", transform);
+    latency.add("inference", inference);
+    latency.add("output", output);
+    stats.add("latency_ms", latency);
 
     // FIXME(sileht): to deprecate
     stats.add("avg_predict_duration", _avg_predict_duration_ms / 1000.0);
@@ -92,4 +252,48 @@ namespace dd
 
     ad.add("service_stats", stats);
   }
+
+  void ServiceStats::prometheus_header(std::string &out)
+  {
+    out += "# HELP dd_predict_latency_seconds Predict calls latency, by "
+           "stage\n"
+           "# TYPE dd_predict_latency_seconds summary\n"
+           "# HELP dd_predict_calls_total Predict calls, by status\n"
+           "# TYPE dd_predict_calls_total counter\n"
+           "# HELP dd_inference_samples_total Samples processed by predict "
+           "calls\n"
+           "# TYPE dd_inference_samples_total counter\n"
+           "# HELP dd_predict_queue_depth Predict calls waiting for a "
+           "replica\n"
+           "# TYPE dd_predict_queue_depth gauge\n"
+           "# HELP dd_predict_rejected_total Predict calls rejected on full "
+           "queue\n"
+           "# TYPE dd_predict_rejected_total counter\n";
+  }
+
+  void ServiceStats::to_prometheus(const std::string &sname,
+                                   std::string &out) const
+  {
+    std::string labels = "service=\"" + sname + "\"";
+    _total_hist.to_prometheus("dd_predict_latency_seconds",
+                              labels + ",stage=\"total\"", out);
+    _transform_hist.to_prometheus("dd_predict_latency_seconds",
+                                  labels + ",stage=\"transform\"", out);
+    _inference_hist.to_prometheus("dd_predict_latency_seconds",
+                                  labels + ",stage=\"inference\"", out);
+    _output_hist.to_prometheus("dd_predict_latency_seconds",
+                               labels + ",stage=\"output\"", out);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    out += "dd_predict_calls_total{" + labels + ",status=\"success\"} "
+           + std::to_string(_predict_success) + "\n";
+    out += "dd_predict_calls_total{" + labels + ",status=\"failure\"} "
+           + std::to_string(_predict_failure) + "\n";
+    out += "dd_inference_samples_total{" + labels + "} "
+           + std::to_string(_inference_count) + "\n";
+    out += "dd_predict_queue_depth{" + labels + "} "
+           + std::to_string(_predict_queue_depth) + "\n";
+    out += "dd_predict_rejected_total{" + labels + "} "
+           + std::to_string(_predict_rejected) + "\n";
+  }
 }
@@ -22,6 +22,8 @@
 #ifndef STATISTICS_H
 #define STATISTICS_H
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <mutex>
 
@@ -29,6 +31,76 @@
 
 namespace dd
 {
+  /**
+   * \brief lock-free latency histogram, log-linear buckets of ~6% relative
+   * precision, from 1us to days
+   */
+  class LatencyHistogram
+  {
+  public:
+    LatencyHistogram()
+    {
+      for (auto &c : _counts)
+        c = 0;
+    }
+
+    LatencyHistogram(const LatencyHistogram &h)
+    {
+      for (size_t i = 0; i < _counts.size(); ++i)
+        _counts[i] = h._counts[i].load();
+      _sum_us = h._sum_us.load();
+    }
+
+    ~LatencyHistogram()
+    {
+    }
+
+    void record(const std::chrono::steady_clock::duration &d);
+
+    uint64_t count() const;
+
+    /**
+     * \brief latency at quantile q (in [0,1]), as the upper bound of its
+     * bucket, in milliseconds
+     */
+    double quantile_ms(const double &q) const;
+
+    void to(APIData &ad) const;
+
+    /**
+     * \brief appends summary lines in Prometheus text format
+     */
+    void to_prometheus(const std::string &name, const std::string &labels,
+                       std::string &out) const;
+
+  private:
+    static const int _sub_bits = 4; /**< 16 sub-buckets per power of two. */
+    static const int _max_bits = 40; /**< values capped to 2^40 us. */
+    static const size_t _nbuckets
+        = (2 << _sub_bits) + (_max_bits - _sub_bits - 1) * (1 << _sub_bits);
+
+    static size_t bucket(uint64_t us);
+    static uint64_t bucket_upper(const size_t &b);
+
+    std::array<std::atomic<uint64_t>, _nbuckets> _counts;
+    std::atomic<uint64_t> _sum_us{ 0 };
+  };
+
+  /**
+   * \brief timings of a single predict call, stages are left unset when a
+   * backend does not mark them
+   */
+  struct ServiceCallTimer
+  {
+    typedef std::chrono::steady_clock::time_point time_point;
+    time_point _start;
+    time_point _transform_start;
+    time_point _transform_end;
+    time_point _output_start;
+    time_point _output_end;
+    ServiceCallTimer *_prev = nullptr; /**< enclosing call on this thread. */
+  };
+
   class ServiceStats
   {
 
@@ -38,19 +110,24 @@ namespace dd
     }
 
     ServiceStats(ServiceStats &stats)
+        : _total_hist(stats._total_hist),
+          _transform_hist(stats._transform_hist),
+          _inference_hist(stats._inference_hist),
+          _output_hist(stats._output_hist)
     {
       // NOTE(sileht) : Do we really want to have all stats copied ?
       _inference_count = stats._inference_count;
 
       _predict_success = stats._predict_success;
       _predict_failure = stats._predict_failure;
-      _predict_tstart = stats._predict_tstart;
-
-      _transform_tstart = stats._transform_tstart;
 
       _avg_batch_size = stats._avg_batch_size;
       _avg_predict_duration_ms = stats._avg_predict_duration_ms;
       _avg_transform_duration_ms = stats._avg_transform_duration_ms;
+
+      _predict_queue_depth = stats._predict_queue_depth;
+      _predict_queue_max_depth = stats._predict_queue_max_depth;
+      _predict_rejected = stats._predict_rejected;
     }
 
     ~ServiceStats()
@@ -59,25 +136,50 @@ namespace dd
 
     void inc_inference_count(const int &l);
 
+    /**
+     * \brief stage marks, recorded into the predict call running on the
+     * calling thread, if any
+     */
     void transform_start();
     void transform_end();
+    void output_start();
+    void output_end();
+
+    /**
+     * \brief starts timing a predict call on the calling thread
+     */
+    void predict_start(ServiceCallTimer &timer);
+
+    /**
+     * \brief ends a predict call, and records its stage latencies
+     */
+    void predict_end(ServiceCallTimer &timer, bool succeed);
 
-    void predict_start();
-    void predict_end(bool succeed);
+    void predict_queued();
+    void predict_dequeued();
+    void predict_rejected();
 
     void to(APIData &ad) const;
 
+    /**
+     * \brief appends service metrics in Prometheus text format
+     */
+    void to_prometheus(const std::string &sname, std::string &out) const;
+
+    /**
+     * \brief Prometheus metric families help and types, once per export
+     */
+    static void prometheus_header(std::string &out);
+
   private:
     int _inference_count = 0;
 
     int _predict_success = 0;
     int _predict_failure = 0;
 
-    std::chrono::steady_clock::time_point _predict_tstart;
     std::chrono::duration<double, std::milli> _predict_total_duration_ms
         = std::chrono::milliseconds(0);
 
-    std::chrono::steady_clock::time_point _transform_tstart;
     std::chrono::duration<double, std::milli> _transform_total_duration_ms
         = std::chrono::milliseconds(0);
 
@@ -85,6 +187,15 @@ namespace dd
     double _avg_predict_duration_ms = -1;
     double _avg_transform_duration_ms = -1;
 
+    int _predict_queue_depth = 0; /**< predict calls waiting for a replica. */
+    int _predict_queue_max_depth = 0; /**< max observed queue depth. */
+    int _predict_rejected = 0; /**< predict calls rejected on full queue. */
+
+    LatencyHistogram _total_hist;     /**< whole predict calls. */
+    LatencyHistogram _transform_hist; /**< input connector stage. */
+    LatencyHistogram _inference_hist; /**< model stage. */
+    LatencyHistogram _output_hist;    /**< output connector stage. */
+
     mutable std::mutex _mutex; /**< mutex for converting to APIData. */
   };
 };
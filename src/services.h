@@ -69,6 +69,9 @@
 #include <vector>
 #include <mutex>
 #include <chrono>
+#include <atomic>
+#include <thread>
+#include <exception>
 #include <iostream>
 
 namespace dd
@@ -642,6 +645,11 @@ namespace dd
           llog->error("mllib lock error: {}", e.what());
           throw;
         }
+      catch (MLServiceBusyException &e)
+        {
+          llog->error("mllib busy error: {}", e.what());
+          throw;
+        }
       catch (...)
         {
           llog->error("prediction call failed: {}",
@@ -683,7 +691,7 @@ namespace dd
       if (chain_pos != 0)
         {
           // take data from the previous action
-          APIData act_data = cdata.get_action_data(parent_id);
+          const APIData &act_data = cdata.get_action_data(parent_id);
           if (act_data.empty())
             {
               spdlog::drop(cname);
@@ -780,13 +788,14 @@ namespace dd
           chain_logger->info("[" + std::to_string(chain_pos)
                              + "] / no result from prediction");
           cdata.add_model_data(pred_id,
-                               pred_out); // store empty model output
+                               std::move(pred_out)); // store empty model
+                                                     // output
           return 1;
         }
       ++npredicts;
 
       // store model output
-      cdata.add_model_data(pred_id, pred_out);
+      cdata.add_model_data(pred_id, std::move(pred_out));
 
       return 0;
     }
@@ -812,10 +821,10 @@ namespace dd
       ChainActionFactory caf(adc);
       caf.apply_action(action_type, prev_data, cdata, chain_logger);
 
-      // replace prev_data in cdata for prec_pred_id
-      cdata.add_model_data(prec_pred_id, prev_data);
-
       std::vector<APIData> vad = prev_data.getv("predictions");
+
+      // replace prev_data in cdata for prec_pred_id
+      cdata.add_model_data(prec_pred_id, std::move(prev_data));
       if (vad.empty())
         {
           // no prediction to work from
@@ -871,62 +880,170 @@ namespace dd
           // debug
 
           ChainData cdata;
-          std::vector<std::string> meta_uris;
-          std::vector<std::string> index_uris;
+
+          // compile the calls into a DAG: a predict call depends on the
+          // action it takes its data from, an action on the predict call it
+          // acts upon, and on former actions on the same call since they
+          // modify its output
+          size_t ncalls = ad_calls.size();
+          std::vector<std::vector<size_t>> deps(ncalls);
+          std::vector<std::string> call_ids(ncalls);
+          std::vector<std::string> parent_ids(ncalls);
+          {
+            std::unordered_map<std::string, size_t> action_calls;
+            std::unordered_map<std::string, size_t> last_actions;
+            std::string prec_pred_id;
+            std::string prec_action_id;
+            int prec_pred_call = -1;
+            int aid = 0;
+            for (size_t i = 0; i < ncalls; i++)
+              {
+                APIData &adc = ad_calls.at(i);
+                if (adc.has("service"))
+                  {
+                    if (adc.has("id"))
+                      call_ids[i] = adc.get("id").get<std::string>();
+                    else
+                      call_ids[i] = std::to_string(i);
+
+                    if (adc.has("parent_id"))
+                      parent_ids[i] = adc.get("parent_id").get<std::string>();
+                    else
+                      parent_ids[i] = prec_action_id;
+
+                    auto hit = action_calls.find(parent_ids[i]);
+                    if (hit != action_calls.end())
+                      deps[i].push_back((*hit).second);
+                    cdata.add_model_sname(
+                        call_ids[i], adc.get("service").get<std::string>());
+                    prec_pred_id = call_ids[i];
+                    prec_pred_call = static_cast<int>(i);
+                  }
+                else if (adc.has("action"))
+                  {
+                    if (adc.has("id"))
+                      call_ids[i] = adc.get("id").get<std::string>();
+                    else
+                      {
+                        // set before execution, action ids do not depend
+                        // on the order in which branches complete
+                        call_ids[i] = std::to_string(aid);
+                        adc.add("id", call_ids[i]);
+                      }
+                    parent_ids[i] = prec_pred_id;
+
+                    if (prec_pred_call >= 0)
+                      deps[i].push_back(prec_pred_call);
+                    auto hit = last_actions.find(prec_pred_id);
+                    if (hit != last_actions.end())
+                      deps[i].push_back((*hit).second);
+                    last_actions[prec_pred_id] = i;
+                    action_calls[call_ids[i]] = i;
+                    prec_action_id = call_ids[i];
+                    ++aid;
+                  }
+              }
+          }
+
+          // meta and index URIs output by predict calls and actions
+          std::mutex uris_mutex;
           std::unordered_map<std::string, std::vector<std::string>>
               um_meta_uris;
           std::unordered_map<std::string, std::vector<std::string>>
               um_index_uris;
-          int npredicts = 0;
-          std::string prec_pred_id;
-          std::string prec_action_id;
-          int aid = 0;
-          for (size_t i = 0; i < ad_calls.size(); i++)
-            {
-              APIData adc = ad_calls.at(i);
-              if (adc.has("service"))
+          std::unordered_map<std::string, std::vector<std::string>>
+              um_pred_meta_uris;
+          std::unordered_map<std::string, std::vector<std::string>>
+              um_pred_index_uris;
+          std::atomic<int> npredicts{ 0 };
+
+          // executes call i, returns 1 when the chain has to stop
+          auto run_call = [&](const size_t i) -> int
+          {
+            APIData &adc = ad_calls.at(i);
+            if (adc.has("service"))
+              {
+                std::vector<std::string> meta_uris;
+                std::vector<std::string> index_uris;
                 {
-                  std::string pred_id;
-                  if (adc.has("id"))
-                    pred_id = adc.get("id").get<std::string>();
-                  else
-                    pred_id = std::to_string(i);
-
-                  std::string parent_id;
-                  if (adc.has("parent_id"))
-                    parent_id = adc.get("parent_id").get<std::string>();
-                  else
-                    parent_id = prec_action_id;
-
-                  auto hit = um_meta_uris.find(parent_id);
+                  std::lock_guard<std::mutex> lock(uris_mutex);
+                  auto hit = um_meta_uris.find(parent_ids[i]);
                   if (hit != um_meta_uris.end())
                     meta_uris = (*hit).second;
-                  hit = um_index_uris.find(parent_id);
+                  hit = um_index_uris.find(parent_ids[i]);
                   if (hit != um_index_uris.end())
                     index_uris = (*hit).second;
-                  cdata.add_model_sname(pred_id,
-                                        adc.get("service").get<std::string>());
-                  if (chain_service(cname, chain_logger, adc, cdata, pred_id,
-                                    meta_uris, index_uris, parent_id, i,
-                                    npredicts))
-                    break;
-                  prec_pred_id = pred_id;
                 }
-              else if (adc.has("action"))
+                int call_npredicts = 0;
+                int stop = chain_service(cname, chain_logger, adc, cdata,
+                                         call_ids[i], meta_uris, index_uris,
+                                         parent_ids[i], i, call_npredicts);
+                npredicts += call_npredicts;
+                std::lock_guard<std::mutex> lock(uris_mutex);
+                um_pred_meta_uris[call_ids[i]] = std::move(meta_uris);
+                um_pred_index_uris[call_ids[i]] = std::move(index_uris);
+                return stop;
+              }
+            else if (adc.has("action"))
+              {
+                if (chain_action(chain_logger, adc, cdata, i, parent_ids[i]))
+                  return 1;
+                std::lock_guard<std::mutex> lock(uris_mutex);
+                um_meta_uris[call_ids[i]] = um_pred_meta_uris[parent_ids[i]];
+                um_index_uris[call_ids[i]]
+                    = um_pred_index_uris[parent_ids[i]];
+              }
+            return 0;
+          };
+
+          // execute the DAG by waves of calls whose dependencies are done,
+          // independent branches running concurrently
+          std::vector<bool> done(ncalls, false);
+          size_t ndone = 0;
+          bool stop = false;
+          while (!stop && ndone < ncalls)
+            {
+              std::vector<size_t> wave;
+              for (size_t i = 0; i < ncalls; i++)
+                {
+                  if (done[i])
+                    continue;
+                  bool ready = true;
+                  for (size_t d : deps[i])
+                    ready = ready && done[d];
+                  if (ready)
+                    wave.push_back(i);
+                }
+              if (wave.empty())
+                break;
+
+              std::vector<int> status(wave.size(), 0);
+              std::vector<std::exception_ptr> errors(wave.size());
+              auto run_branch = [&](const size_t w)
+              {
+                try
+                  {
+                    status[w] = run_call(wave[w]);
+                  }
+                catch (...)
+                  {
+                    errors[w] = std::current_exception();
+                  }
+              };
+              std::vector<std::thread> branches;
+              for (size_t w = 1; w < wave.size(); w++)
+                branches.emplace_back(run_branch, w);
+              run_branch(0);
+              for (std::thread &b : branches)
+                b.join();
+
+              for (size_t w = 0; w < wave.size(); w++)
                 {
-                  if (chain_action(chain_logger, adc, cdata, i, prec_pred_id))
-                    break;
-                  if (adc.has("id"))
-                    prec_action_id = adc.get("id").get<std::string>();
-                  else
-                    prec_action_id = std::to_string(aid);
-                  um_meta_uris.insert(
-                      std::pair<std::string, std::vector<std::string>>(
-                          prec_action_id, meta_uris));
-                  um_index_uris.insert(
-                      std::pair<std::string, std::vector<std::string>>(
-                          prec_action_id, index_uris));
-                  ++aid;
+                  if (errors[w])
+                    std::rethrow_exception(errors[w]);
+                  done[wave[w]] = true;
+                  ++ndone;
+                  stop = stop || status[w];
                 }
             }
 
@@ -22,11 +22,25 @@
 #include "simsearch.h"
 #include "utils/fileops.hpp"
 #include "utils/utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #ifdef USE_FAISS
 #include "faiss/IndexIVF.h"
 #include "faiss/OnDiskInvertedLists.h"
 #include "faiss/IndexPreTransform.h"
 #include "faiss/index_factory.h"
+#include "faiss/MetaIndexes.h"
+#include "faiss/clone_index.h"
+#include "faiss/impl/AuxIndexStructures.h"
+#include "faiss/utils/distances.h"
 #ifdef USE_GPU_FAISS
 #include "faiss/gpu/GpuCloner.h"
 #endif
@@ -34,6 +48,11 @@
 
 namespace dd
 {
+  /**
+   * \brief max number of neighbors searched per requested one, when
+   *        removed or filtered out entries are compensated by searching more
+   */
+  static const long int search_max_growth = 64;
 
   /*-- URIData --*/
   char URIData::_enc_char = '^';
@@ -64,6 +83,264 @@ namespace dd
     _cat = tok.at(6);
   }
 
+  /*-- URIStore --*/
+  static const char *map_file(const std::string &filename, size_t &bytes)
+  {
+    bytes = 0;
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return nullptr;
+    struct stat st;
+    void *addr = nullptr;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+          addr = nullptr;
+        else
+          bytes = st.st_size;
+      }
+    ::close(fd);
+    return static_cast<const char *>(addr);
+  }
+
+  URIStoreMap::URIStoreMap(const std::string &offsets_filename,
+                           const std::string &records_filename)
+  {
+    _offsets = reinterpret_cast<const uint64_t *>(
+        map_file(offsets_filename, _offsets_bytes));
+    _size = _offsets_bytes / sizeof(uint64_t);
+    _records = map_file(records_filename, _records_bytes);
+  }
+
+  URIStoreMap::~URIStoreMap()
+  {
+    if (_offsets)
+      munmap(const_cast<uint64_t *>(_offsets), _offsets_bytes);
+    if (_records)
+      munmap(const_cast<char *>(_records), _records_bytes);
+  }
+
+  URIStore::~URIStore()
+  {
+    close();
+  }
+
+  void URIStore::open(const std::string &filename)
+  {
+    close();
+    _filename = filename;
+    _foffsets = std::fopen((_filename + ".idx").c_str(), "ab");
+    _frecords = std::fopen((_filename + ".dat").c_str(), "ab");
+    if (!_foffsets || !_frecords)
+      throw SimIndexException("failed opening uri store " + _filename);
+    std::atomic_store(&_map, std::shared_ptr<const URIStoreMap>(
+                                 new URIStoreMap(_filename + ".idx",
+                                                 _filename + ".dat")));
+    _records_size = _map->_records_bytes;
+    _size = _map->_size;
+
+    // tombstones
+    std::unordered_set<long int> *removed = new std::unordered_set<long int>();
+    std::FILE *fremoved = std::fopen((_filename + ".del").c_str(), "rb");
+    if (fremoved)
+      {
+        uint64_t idx;
+        while (std::fread(&idx, sizeof(uint64_t), 1, fremoved) == 1)
+          removed->insert(idx);
+        std::fclose(fremoved);
+      }
+    std::atomic_store(&_removed,
+                      std::shared_ptr<const std::unordered_set<long int>>(
+                          removed));
+    _fremoved = std::fopen((_filename + ".del").c_str(), "ab");
+    if (!_fremoved)
+      throw SimIndexException("failed opening uri store " + _filename);
+
+    // uri to live ids
+    _uri_ids.clear();
+    URIData uri;
+    for (long int idx = 0; idx < _size; ++idx)
+      if (removed->find(idx) == removed->end() && get(idx, uri)
+          && !uri._uri.empty())
+        _uri_ids[uri._uri].push_back(idx);
+  }
+
+  void URIStore::close()
+  {
+    if (_foffsets)
+      {
+        commit();
+        std::fclose(_foffsets);
+        std::fclose(_frecords);
+        std::fclose(_fremoved);
+        _foffsets = nullptr;
+        _frecords = nullptr;
+        _fremoved = nullptr;
+      }
+    std::atomic_store(&_map, std::shared_ptr<const URIStoreMap>());
+    _uri_ids.clear();
+  }
+
+  void URIStore::remove()
+  {
+    close();
+    std::remove((_filename + ".idx").c_str());
+    std::remove((_filename + ".dat").c_str());
+    std::remove((_filename + ".del").c_str());
+    _records_size = 0;
+    _size = 0;
+  }
+
+  void URIStore::truncate(const long int &size)
+  {
+    commit();
+    std::shared_ptr<const URIStoreMap> map = std::atomic_load(&_map);
+    if (size < 0 || !map || size >= map->_size)
+      return;
+    off_t records_bytes = map->_offsets[size];
+    std::shared_ptr<const std::unordered_set<long int>> removed
+        = std::atomic_load(&_removed);
+    map.reset();
+    close();
+    if (::truncate((_filename + ".idx").c_str(), size * sizeof(uint64_t))
+            != 0
+        || ::truncate((_filename + ".dat").c_str(), records_bytes) != 0)
+      throw SimIndexException("failed truncating uri store " + _filename);
+    // tombstones of dropped ids would apply to the ids reused next
+    std::FILE *fremoved = std::fopen((_filename + ".del").c_str(), "wb");
+    if (!fremoved)
+      throw SimIndexException("failed truncating uri store " + _filename);
+    for (long int idx : *removed)
+      if (idx < size)
+        {
+          uint64_t uidx = idx;
+          std::fwrite(&uidx, sizeof(uint64_t), 1, fremoved);
+        }
+    std::fclose(fremoved);
+    open(_filename);
+  }
+
+  bool URIStore::exists() const
+  {
+    return fileops::file_exists(_filename + ".idx");
+  }
+
+  void URIStore::put(const long int &idx, const URIData &uri)
+  {
+    if (idx < _size)
+      throw SimIndexException("uri store is append only, cannot put id "
+                              + std::to_string(idx));
+    while (_size <= idx) // missing ids are stored as empty records
+      {
+        URIRecord rec;
+        if (_size == idx)
+          {
+            rec._uri_len = uri._uri.size();
+            rec._cat_len = uri._cat.size();
+            rec._nbbox = uri._bbox.size();
+            rec._prob = uri._prob;
+          }
+        _woffsets.push_back(_records_size + _wrecords.size());
+        const char *hdr = reinterpret_cast<const char *>(&rec);
+        _wrecords.insert(_wrecords.end(), hdr, hdr + sizeof(URIRecord));
+        for (uint32_t b = 0; b < rec._nbbox; ++b)
+          {
+            float fb = uri._bbox[b];
+            const char *pb = reinterpret_cast<const char *>(&fb);
+            _wrecords.insert(_wrecords.end(), pb, pb + sizeof(float));
+          }
+        if (_size == idx)
+          {
+            _wrecords.insert(_wrecords.end(), uri._uri.begin(),
+                             uri._uri.end());
+            _wrecords.insert(_wrecords.end(), uri._cat.begin(),
+                             uri._cat.end());
+          }
+        // keeps every record header aligned
+        _wrecords.resize((_wrecords.size() + 7) & ~static_cast<size_t>(7),
+                         0);
+        ++_size;
+      }
+    _uri_ids[uri._uri].push_back(idx);
+  }
+
+  void URIStore::commit()
+  {
+    if (_woffsets.empty())
+      return;
+    // records are written before the offsets that point to them
+    std::fwrite(_wrecords.data(), 1, _wrecords.size(), _frecords);
+    std::fflush(_frecords);
+    std::fwrite(_woffsets.data(), sizeof(uint64_t), _woffsets.size(),
+                _foffsets);
+    std::fflush(_foffsets);
+    _records_size += _wrecords.size();
+    _wrecords.clear();
+    _woffsets.clear();
+    std::atomic_store(&_map, std::shared_ptr<const URIStoreMap>(
+                                 new URIStoreMap(_filename + ".idx",
+                                                 _filename + ".dat")));
+  }
+
+  bool URIStore::get(const long int &idx, URIData &uri) const
+  {
+    std::shared_ptr<const URIStoreMap> map = std::atomic_load(&_map);
+    if (!map || idx < 0 || idx >= map->_size)
+      return false;
+    const URIRecord *rec = reinterpret_cast<const URIRecord *>(
+        map->_records + map->_offsets[idx]);
+    const float *bbox = reinterpret_cast<const float *>(rec + 1);
+    const char *str = reinterpret_cast<const char *>(bbox + rec->_nbbox);
+    uri._uri.assign(str, rec->_uri_len);
+    uri._bbox.assign(bbox, bbox + rec->_nbbox);
+    uri._prob = rec->_prob;
+    uri._cat.assign(str + rec->_uri_len, rec->_cat_len);
+    return true;
+  }
+
+  void URIStore::remove_uri(const std::string &uri, std::vector<long int> &ids)
+  {
+    auto hit = _uri_ids.find(uri);
+    if (hit == _uri_ids.end())
+      return;
+    std::unordered_set<long int> *removed
+        = new std::unordered_set<long int>(*std::atomic_load(&_removed));
+    for (long int idx : (*hit).second)
+      {
+        uint64_t uidx = idx;
+        std::fwrite(&uidx, sizeof(uint64_t), 1, _fremoved);
+        removed->insert(idx);
+        ids.push_back(idx);
+      }
+    std::fflush(_fremoved);
+    _uri_ids.erase(hit);
+    std::atomic_store(&_removed,
+                      std::shared_ptr<const std::unordered_set<long int>>(
+                          removed));
+  }
+
+  void URIStore::import_db(const std::string &db_filename,
+                           const std::string &db_backend)
+  {
+    std::unique_ptr<caffe::db::DB> db(caffe::db::GetDB(db_backend));
+    db->Open(db_filename, caffe::db::READ);
+    std::unique_ptr<caffe::db::Cursor> cursor(db->NewCursor());
+    std::map<long int, std::string> records; // lmdb keys are not id ordered
+    for (cursor->SeekToFirst(); cursor->valid(); cursor->Next())
+      records.insert(std::pair<long int, std::string>(
+          std::stol(cursor->key()), cursor->value()));
+    cursor.reset();
+    db->Close();
+    for (auto &r : records)
+      {
+        URIData uri;
+        uri.decode(r.second);
+        put(r.first, uri);
+      }
+    commit();
+  }
+
   /*-- SearchEngine --*/
   template <class TSE>
   SearchEngine<TSE>::SearchEngine(const int &dim,
@@ -80,16 +357,19 @@ namespace dd
 
   template <class TSE> void SearchEngine<TSE>::create_index()
   {
+    std::lock_guard<std::mutex> lock(_index_mutex);
     _tse->create_index();
   }
 
   template <class TSE> void SearchEngine<TSE>::update_index()
   {
+    std::lock_guard<std::mutex> lock(_index_mutex);
     _tse->update_index();
   }
 
   template <class TSE> void SearchEngine<TSE>::remove_index()
   {
+    std::lock_guard<std::mutex> lock(_index_mutex);
     std::cerr << "removing index\n";
     _tse->remove_index();
   }
@@ -110,6 +390,21 @@ namespace dd
     _tse->index(uris, datas);
   }
 
+  template <class TSE>
+  void SearchEngine<TSE>::index(const std::vector<URIData> &uris,
+                                const std::vector<float> &datas)
+  {
+    if (datas.size() != uris.size() * _dim)
+      throw SimIndexException("batch index data size "
+                              + std::to_string(datas.size())
+                              + " does not match "
+                              + std::to_string(uris.size())
+                              + " vectors of dimension "
+                              + std::to_string(_dim));
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    _tse->index(uris, datas);
+  }
+
   template <class TSE>
   void SearchEngine<TSE>::search(const std::vector<double> &data,
                                  const int &nn, std::vector<URIData> &uris,
@@ -118,6 +413,28 @@ namespace dd
     _tse->search(data, nn, uris, distances);
   }
 
+  template <class TSE>
+  void SearchEngine<TSE>::search(const std::vector<float> &datas,
+                                 const int &nn,
+                                 std::vector<std::vector<URIData>> &uris,
+                                 std::vector<std::vector<double>> &distances,
+                                 const URIFilter &filter)
+  {
+    if (datas.size() % _dim != 0)
+      throw SimSearchException("batch search data size "
+                               + std::to_string(datas.size())
+                               + " is not a multiple of index dimension "
+                               + std::to_string(_dim));
+    _tse->search(datas, nn, uris, distances, filter);
+  }
+
+  template <class TSE>
+  void SearchEngine<TSE>::remove(const std::vector<std::string> &uris)
+  {
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    _tse->remove(uris);
+  }
+
 #ifdef USE_ANNOY
   /*- AnnoySE -*/
 
@@ -126,15 +443,11 @@ namespace dd
   {
     _aindex = new AnnoyIndex<int, double, Angular, Kiss32Random,
                              AnnoyIndexSingleThreadedBuildPolicy>(f);
-    _db = caffe::db::GetDB(_db_backend);
   }
 
   AnnoySE::~AnnoySE()
   {
     delete _aindex;
-    if (_db)
-      _db->Close();
-    delete _db;
   }
 
   void AnnoySE::create_index() // TODO: exception
@@ -147,21 +460,23 @@ namespace dd
         _built_index = true;
       }
     std::string db_filename = _model_repo + "/" + _db_name;
-    if (fileops::file_exists(db_filename))
-      {
-        std::cerr << "open existing index db\n";
-        _db->Open(db_filename, caffe::db::WRITE);
-      }
-    else
+    _store.open(_model_repo + "/" + _store_name);
+    if (_store._size == 0 && fileops::file_exists(db_filename))
       {
-        std::cerr << "create index db\n";
-        _db->Open(db_filename, caffe::db::NEW);
+        std::cerr << "import existing index db\n";
+        _store.import_db(db_filename, _db_backend);
       }
+    // records committed after the index was last saved, e.g. before a
+    // crash, are dropped so that their ids can be indexed again
+    long int saved_size = _saved_tree ? _aindex->get_n_items() : 0;
+    if (_store._size > saved_size)
+      _store.truncate(saved_size);
   }
 
   void AnnoySE::remove_index()
   {
     fileops::remove_file(_model_repo, _index_name);
+    _store.remove();
     std::string db_filename = _model_repo + "/" + _db_name;
     fileops::clear_directory(db_filename);
     rmdir(db_filename.c_str());
@@ -175,11 +490,7 @@ namespace dd
 
   void AnnoySE::build_tree()
   {
-    if (_count_put % _count_put_max != 0)
-      {
-        _txn->Commit(); // last pending db commit
-        _txn = std::unique_ptr<caffe::db::Transaction>(_db->NewTransaction());
-      }
+    _store.commit(); // last pending db commit
     _aindex->build(_ntrees);
     _built_index = true;
   }
@@ -217,118 +528,363 @@ namespace dd
       }
   }
 
+  void AnnoySE::index(const std::vector<URIData> &uris,
+                      const std::vector<float> &vecs)
+  {
+    // annoy items are double, rows are converted one at a time
+    std::vector<double> vec(_f);
+    for (size_t i = 0; i < uris.size(); ++i)
+      {
+        std::copy(vecs.begin() + i * _f, vecs.begin() + (i + 1) * _f,
+                  vec.begin());
+        index(uris[i], vec);
+      }
+  }
+
   void AnnoySE::search(const std::vector<double> &vec, const int &nn,
                        std::vector<URIData> &uris,
                        std::vector<double> &distances)
+  {
+    std::vector<float> v(vec.begin(), vec.end());
+    std::vector<std::vector<URIData>> vuris;
+    std::vector<std::vector<double>> vdistances;
+    search(v, nn, vuris, vdistances);
+    uris.insert(uris.end(), vuris.at(0).begin(), vuris.at(0).end());
+    distances.insert(distances.end(), vdistances.at(0).begin(),
+                     vdistances.at(0).end());
+  }
+
+  void AnnoySE::search(const std::vector<float> &vecs, const int &nn,
+                       std::vector<std::vector<URIData>> &uris,
+                       std::vector<std::vector<double>> &distances,
+                       const URIFilter &filter)
   {
     if (!_built_index)
       throw SimSearchException(
           "Cannot search before the Annoy tree has been built");
-    std::vector<int> result;
-    _aindex->get_nns_by_vector(&vec[0], nn, -1, &result, &distances);
-    for (auto i : result)
+    std::shared_ptr<const std::unordered_set<long int>> removed
+        = _store.removed_ids();
+
+    // annoy has no multi-query search, queries are run one by one
+    size_t n = vecs.size() / _f;
+    int max_k = static_cast<int>(
+        std::min(static_cast<long int>(nn) * search_max_growth,
+                 static_cast<long int>(_aindex->get_n_items())));
+    uris.resize(n);
+    distances.resize(n);
+    std::vector<double> vec(_f);
+    for (size_t q = 0; q < n; ++q)
       {
-        URIData uri;
-        get_from_db(i, uri);
-        uris.push_back(uri);
+        std::copy(vecs.begin() + q * _f, vecs.begin() + (q + 1) * _f,
+                  vec.begin());
+        // removed and filtered out entries are compensated by searching
+        // more neighbors
+        int k = nn;
+        while (true)
+          {
+            std::vector<int> result;
+            std::vector<double> dists;
+            _aindex->get_nns_by_vector(&vec[0], k, -1, &result, &dists);
+            uris.at(q).clear();
+            distances.at(q).clear();
+            for (size_t i = 0; i < result.size()
+                               && uris.at(q).size() < static_cast<size_t>(nn);
+                 ++i)
+              {
+                if (removed && removed->find(result[i]) != removed->end())
+                  continue;
+                URIData uri;
+                get_from_db(result[i], uri);
+                if (!filter.accept(uri))
+                  continue;
+                uris.at(q).push_back(std::move(uri));
+                distances.at(q).push_back(dists[i]);
+              }
+            if (uris.at(q).size() >= static_cast<size_t>(nn)
+                || result.size() < static_cast<size_t>(k)
+                || k >= max_k)
+              break;
+            k = std::min(k * 4, max_k);
+          }
       }
   }
 
+  void AnnoySE::remove(const std::vector<std::string> &uris)
+  {
+    // annoy trees are immutable, removed entries are only filtered out
+    std::vector<long int> ids;
+    for (const std::string &uri : uris)
+      _store.remove_uri(uri, ids);
+  }
+
   void AnnoySE::add_to_db(const int &idx, const URIData &fmap)
   {
-    if (_count_put == 0)
-      _txn = std::unique_ptr<caffe::db::Transaction>(_db->NewTransaction());
-    _txn->Put(std::to_string(idx), fmap.encode());
+    _store.put(idx, fmap);
     ++_count_put;
     if (_count_put % _count_put_max == 0)
-      {
-        _txn->Commit(); // batch commit
-        _txn = std::unique_ptr<caffe::db::Transaction>(_db->NewTransaction());
-      }
+      _store.commit(); // batch commit
   }
 
   void AnnoySE::get_from_db(const int &idx, URIData &fmap)
   {
-    std::string tmp;
-    _db->Get(std::to_string(idx), tmp);
-    fmap.decode(tmp);
+    _store.get(idx, fmap);
   }
 
   template class SearchEngine<AnnoySE>;
 #endif
 
 #ifdef USE_FAISS
+  /**
+   * \brief collects the IVF indexes wrapped in shards, id maps and
+   *        pre-transforms
+   */
+  static void get_ivfs(faiss::Index *index,
+                       std::vector<faiss::IndexIVF *> &ivfs)
+  {
+    faiss::IndexIVF *iivf = dynamic_cast<faiss::IndexIVF *>(index);
+    if (iivf)
+      {
+        ivfs.push_back(iivf);
+        return;
+      }
+    faiss::IndexShards *ishards = dynamic_cast<faiss::IndexShards *>(index);
+    if (ishards)
+      {
+        for (int k = 0; k < ishards->count(); ++k)
+          get_ivfs(ishards->at(k), ivfs);
+        return;
+      }
+    faiss::IndexIDMap *iidmap = dynamic_cast<faiss::IndexIDMap *>(index);
+    if (iidmap)
+      {
+        get_ivfs(iidmap->index, ivfs);
+        return;
+      }
+    faiss::IndexPreTransform *ipivf
+        = dynamic_cast<faiss::IndexPreTransform *>(index);
+    if (ipivf)
+      get_ivfs(ipivf->index, ivfs);
+  }
+
+  /**
+   * \brief whether ids can be removed from index, through faiss remove_ids
+   *        on every sub-index, without renumbering the remaining entries
+   * @param mapped whether ids are kept by an enclosing id map
+   */
+  static bool removable(faiss::Index *index, const bool &mapped)
+  {
+    faiss::IndexShards *ishards = dynamic_cast<faiss::IndexShards *>(index);
+    if (ishards)
+      {
+        // faiss removes ids from shards one at a time only
+        for (int k = 0; k < ishards->count(); ++k)
+          if (!removable(ishards->at(k), mapped))
+            return false;
+        return ishards->count() > 0;
+      }
+    faiss::IndexIDMap *iidmap = dynamic_cast<faiss::IndexIDMap *>(index);
+    if (iidmap)
+      return removable(iidmap->index, true);
+    faiss::IndexPreTransform *ipt
+        = dynamic_cast<faiss::IndexPreTransform *>(index);
+    if (ipt)
+      return removable(ipt->index, mapped);
+    if (dynamic_cast<faiss::IndexIVF *>(index))
+      return true;
+    // removing ids from a plain flat index renumbers the others
+    return mapped && dynamic_cast<faiss::IndexFlat *>(index);
+  }
+
+  /**
+   * \brief copy of index without the selected ids, shards are copied and
+   *        compacted one at a time
+   */
+  static faiss::Index *compacted_copy(faiss::Index *index,
+                                      const faiss::IDSelector &sel)
+  {
+    faiss::IndexShards *ishards = dynamic_cast<faiss::IndexShards *>(index);
+    if (ishards)
+      {
+        faiss::IndexShards *cshards
+            = new faiss::IndexShards(index->d, true, false);
+        cshards->own_fields = true;
+        cshards->metric_type = index->metric_type;
+        try
+          {
+            for (int k = 0; k < ishards->count(); ++k)
+              cshards->add_shard(compacted_copy(ishards->at(k), sel));
+          }
+        catch (...)
+          {
+            delete cshards;
+            throw;
+          }
+        cshards->is_trained = index->is_trained;
+        return cshards;
+      }
+    faiss::Index *cindex = faiss::clone_index(index);
+    try
+      {
+        cindex->remove_ids(sel);
+      }
+    catch (...)
+      {
+        delete cindex;
+        throw;
+      }
+    return cindex;
+  }
+
+  /**
+   * \brief removes the selected ids from index in place
+   */
+  static void compact_in_place(faiss::Index *index,
+                               const faiss::IDSelector &sel)
+  {
+    faiss::IndexShards *ishards = dynamic_cast<faiss::IndexShards *>(index);
+    if (!ishards)
+      {
+        index->remove_ids(sel);
+        return;
+      }
+    index->ntotal = 0;
+    for (int k = 0; k < ishards->count(); ++k)
+      {
+        ishards->at(k)->remove_ids(sel);
+        index->ntotal += ishards->at(k)->ntotal;
+      }
+  }
+
   FaissSE::FaissSE(const int &f, const std::string &model_repo)
       : _f(f), _model_repo(model_repo)
   {
-    _db = caffe::db::GetDB(_db_backend);
     _index_key = std::string("Flat");
+    _delta = std::shared_ptr<const FaissDelta>(new FaissDelta());
   }
 
   FaissSE::~FaissSE()
   {
+    if (_compact_thread.joinable())
+      _compact_thread.join();
     delete _findex;
-    if (_db)
-      _db->Close();
-    delete _db;
+  }
+
+  bool FaissSE::trained()
+  {
+    boost::shared_lock<boost::shared_mutex> lock(_findex_mutex);
+    return _findex->is_trained;
+  }
+
+  faiss::Index *FaissSE::new_index(const std::string &ondisk_filename)
+  {
+    faiss::Index *findex = faiss::index_factory(_f, _index_key.c_str());
+    if (_ondisk)
+      {
+        faiss::IndexIVF *iivf = dynamic_cast<faiss::IndexIVF *>(findex);
+        if (!iivf)
+          {
+            faiss::IndexPreTransform *ipivf
+                = dynamic_cast<faiss::IndexPreTransform *>(findex);
+            if (ipivf)
+              iivf = dynamic_cast<faiss::IndexIVF *>(ipivf->index);
+          }
+        if (iivf)
+          {
+            faiss::OnDiskInvertedLists *odil = new faiss::OnDiskInvertedLists(
+                iivf->nlist, iivf->code_size, ondisk_filename.c_str());
+            iivf->own_invlists = true;
+            iivf->replace_invlists(odil, true);
+          }
+        else
+          std::cerr << "cannot put index on disk : neither IVF nor "
+                       "vectorTransform+IVF\n";
+      }
+    return findex;
+  }
+
+  std::string FaissSE::shard_name(const std::string &name,
+                                  const int &k) const
+  {
+    size_t dot = name.rfind('.');
+    return name.substr(0, dot) + "_" + std::to_string(k) + name.substr(dot);
   }
 
   void FaissSE::create_index()
   {
+    if (_compact_thread.joinable())
+      _compact_thread.join();
     if (_findex)
       delete _findex;
-    std::string index_filename = _model_repo + "/" + _index_name;
-    if (fileops::file_exists(index_filename))
+    _pending.clear();
+    _delta = std::shared_ptr<const FaissDelta>(new FaissDelta());
+    _delta_size = 0;
+    _applied_nprobe = -1;
+    if (_nshards > 1)
       {
-        if (_ondisk)
-          _findex
-              = faiss::read_index(index_filename.c_str(), faiss::IO_FLAG_MMAP);
-        else
-          _findex = faiss::read_index(index_filename.c_str());
+        // sub-indexes are searched in parallel by faiss and their top-k
+        // merged, ids are kept global through id maps
+        faiss::IndexShards *ishards
+            = new faiss::IndexShards(_f, true, false);
+        ishards->own_fields = true;
+        for (int k = 0; k < _nshards; ++k)
+          {
+            std::string shard_filename
+                = _model_repo + "/" + shard_name(_index_name, k);
+            faiss::Index *shard = nullptr;
+            if (fileops::file_exists(shard_filename))
+              {
+                if (_ondisk)
+                  shard = faiss::read_index(shard_filename.c_str(),
+                                            faiss::IO_FLAG_MMAP);
+                else
+                  shard = faiss::read_index(shard_filename.c_str());
+              }
+            else
+              {
+                faiss::IndexIDMap *iidmap = new faiss::IndexIDMap(new_index(
+                    _model_repo + "/" + shard_name(_il_name, k)));
+                iidmap->own_fields = true;
+                shard = iidmap;
+              }
+            ishards->add_shard(shard);
+          }
+        _findex = ishards;
         _index_size = _findex->ntotal;
       }
     else
       {
-        _findex = faiss::index_factory(_f, _index_key.c_str());
-        if (_ondisk)
+        std::string index_filename = _model_repo + "/" + _index_name;
+        if (fileops::file_exists(index_filename))
           {
-            std::string odilfn = _model_repo + "/" + _il_name;
-            faiss::IndexIVF *iivf = dynamic_cast<faiss::IndexIVF *>(_findex);
-            if (iivf)
-              {
-                faiss::OnDiskInvertedLists *odil
-                    = new faiss::OnDiskInvertedLists(
-                        iivf->nlist, iivf->code_size, odilfn.c_str());
-                iivf->own_invlists = true;
-                iivf->replace_invlists(odil, true);
-              }
+            if (_ondisk)
+              _findex = faiss::read_index(index_filename.c_str(),
+                                          faiss::IO_FLAG_MMAP);
             else
+              _findex = faiss::read_index(index_filename.c_str());
+            _index_size = _findex->ntotal;
+          }
+        else
+          {
+            _findex = new_index(_model_repo + "/" + _il_name);
+            _index_size = 0;
+            std::vector<faiss::IndexIVF *> ivfs;
+            get_ivfs(_findex, ivfs);
+#ifdef USE_GPU_FAISS
+            if (ivfs.empty() && !_gpu)
+#else
+            if (ivfs.empty())
+#endif
               {
-                faiss::IndexPreTransform *ipivf
-                    = dynamic_cast<faiss::IndexPreTransform *>(_findex);
-                if (ipivf)
-                  {
-                    faiss::IndexIVF *iivf
-                        = dynamic_cast<faiss::IndexIVF *>(ipivf->index);
-                    if (iivf)
-                      {
-                        faiss::OnDiskInvertedLists *odil
-                            = new faiss::OnDiskInvertedLists(
-                                iivf->nlist, iivf->code_size, odilfn.c_str());
-                        iivf->own_invlists = true;
-                        iivf->replace_invlists(odil, true);
-                      }
-                  }
-                else
-                  std::cerr << "cannot put index on disk : neither IVF nor "
-                               "vectorTransform+IVF\n";
+                // keeps ids stable when compacting removed entries away
+                faiss::IndexIDMap *iidmap = new faiss::IndexIDMap(_findex);
+                iidmap->own_fields = true;
+                _findex = iidmap;
               }
           }
-        _index_size = 0;
       }
 
 #ifdef USE_GPU_FAISS
-    if (_gpu)
+    if (_gpu && _nshards <= 1)
       {
         if (_gpuids.size() == 0)
           {
@@ -359,20 +915,31 @@ namespace dd
 #endif
 
     std::string db_filename = _model_repo + "/" + _db_name;
-    if (fileops::file_exists(db_filename))
+    _store.open(_model_repo + "/" + _store_name);
+    if (_store._size == 0 && fileops::file_exists(db_filename))
       {
-        std::cerr << "open existing index db\n";
-        _db->Open(db_filename, caffe::db::WRITE);
-      }
-    else
-      {
-        std::cerr << "create index db\n";
-        _db->Open(db_filename, caffe::db::NEW);
+        std::cerr << "import existing index db\n";
+        _store.import_db(db_filename, _db_backend);
       }
+    // compacted indexes hold fewer vectors than ids were issued, the id
+    // count is saved along with them
+    std::ifstream size_file(_model_repo + "/" + _size_name);
+    long int saved_size = 0;
+    if (size_file >> saved_size)
+      _index_size = std::max(saved_size, _index_size.load());
+
+    // records committed after the index was last saved, e.g. before a
+    // crash, are dropped so that their ids can be indexed again
+    if (_store._size > _index_size)
+      _store.truncate(_index_size);
   }
 
   void FaissSE::train()
   {
+    boost::unique_lock<boost::shared_mutex> lock(_findex_mutex);
+    if (_findex->is_trained)
+      return;
+    std::lock_guard<std::mutex> train_lock(_train_mutex);
     // train
     try
       {
@@ -386,38 +953,143 @@ namespace dd
         return;
       }
     // then add data to index
-    _findex->add(_train_samples.size() / _f, _train_samples.data());
+    long int nsamples = _train_samples.size() / _f;
+    add_to_main(nsamples, _train_samples.data(), _train_base);
     // then throw away data
     _train_samples.clear();
   }
 
-  void FaissSE::update_index()
+  void FaissSE::add_to_main(const long int &n, const float *data,
+                            const long int &base)
   {
-    if (!_findex->is_trained)
-      train();
-    std::string index_path = _model_repo + "/" + _index_name;
-#ifdef USE_GPU_FAISS
-    if (_gpu)
+    if (_nshards > 1 || dynamic_cast<faiss::IndexIDMap *>(_findex))
       {
-        faiss::Index *cindex = faiss::gpu::index_gpu_to_cpu(_findex);
-        faiss::write_index(cindex, index_path.c_str());
-        delete cindex;
+        std::vector<faiss::Index::idx_t> ids(n);
+        for (long int i = 0; i < n; ++i)
+          ids[i] = base + i;
+        _findex->add_with_ids(n, data, ids.data());
       }
     else
+      _findex->add(n, data);
+  }
+
+  void FaissSE::publish()
+  {
+    // metadata is committed before vectors become searchable
+    commit_db();
+    if (_pending.empty())
+      return;
+    long int n = _pending.size() / _f;
+    faiss::MetricType metric;
+    {
+      boost::shared_lock<boost::shared_mutex> lock(_findex_mutex);
+      metric = _findex->metric_type;
+    }
+    std::shared_ptr<FaissSegment> segment
+        = std::make_shared<FaissSegment>(_f, metric, _pending_base);
+    segment->_index.add(n, _pending.data());
+    _pending.clear();
+    std::shared_ptr<FaissDelta> delta
+        = std::make_shared<FaissDelta>(*std::atomic_load(&_delta));
+    delta->push_back(segment);
+    std::atomic_store(&_delta, std::shared_ptr<const FaissDelta>(delta));
+    _delta_size += n;
+    if (_delta_size >= _merge_size)
+      merge();
+  }
+
+  void FaissSE::merge()
+  {
+    std::shared_ptr<const FaissDelta> delta = std::atomic_load(&_delta);
+    if (delta->empty())
+      return;
+    // the main index is not appended to while being compacted
+    std::lock_guard<std::mutex> compact_lock(_compact_mutex);
+    // readers only wait for the merge itself
+    boost::unique_lock<boost::shared_mutex> lock(_findex_mutex);
+    for (const std::shared_ptr<const FaissSegment> &segment : *delta)
       {
-        faiss::write_index(_findex, index_path.c_str());
+        long int n = segment->_index.ntotal;
+        std::vector<float> data(n * _f);
+        segment->_index.reconstruct_n(0, n, data.data());
+        add_to_main(n, data.data(), segment->_base);
       }
+    std::atomic_store(&_delta,
+                      std::shared_ptr<const FaissDelta>(new FaissDelta()));
+    _delta_size = 0;
+  }
+
+  void FaissSE::update_index()
+  {
+    publish();
+    if (!trained())
+      train();
+    merge();
+    {
+      boost::shared_lock<boost::shared_mutex> lock(_findex_mutex);
+      if (_nshards > 1)
+        {
+          faiss::IndexShards *ishards
+              = dynamic_cast<faiss::IndexShards *>(_findex);
+          for (int k = 0; k < ishards->count(); ++k)
+            {
+              std::string shard_path
+                  = _model_repo + "/" + shard_name(_index_name, k);
+              faiss::write_index(ishards->at(k), shard_path.c_str());
+            }
+        }
+      else
+        {
+          std::string index_path = _model_repo + "/" + _index_name;
+#ifdef USE_GPU_FAISS
+          if (_gpu)
+            {
+              faiss::Index *cindex = faiss::gpu::index_gpu_to_cpu(_findex);
+              faiss::write_index(cindex, index_path.c_str());
+              delete cindex;
+            }
+          else
+            {
+              faiss::write_index(_findex, index_path.c_str());
+            }
 #else
-    faiss::write_index(_findex, index_path.c_str());
+          faiss::write_index(_findex, index_path.c_str());
 #endif
-    _txn->Commit();
-    _txn = std::unique_ptr<caffe::db::Transaction>(_db->NewTransaction());
+        }
+    }
+
+    // ids covered by the saved index, vectors that still wait for the
+    // index to be trained are not part of it
+    long int saved_size = _index_size;
+    {
+      std::lock_guard<std::mutex> train_lock(_train_mutex);
+      if (!_train_samples.empty())
+        saved_size = _train_base;
+    }
+    std::string size_path = _model_repo + "/" + _size_name;
+    {
+      std::ofstream size_file(size_path + ".tmp");
+      size_file << saved_size << std::endl;
+    }
+    std::rename((size_path + ".tmp").c_str(), size_path.c_str());
+
+    // removed entries are dropped from the main index in the background
+    compact();
   }
 
   void FaissSE::remove_index()
   {
+    if (_compact_thread.joinable())
+      _compact_thread.join();
     fileops::remove_file(_model_repo, _index_name);
     fileops::remove_file(_model_repo, _il_name);
+    fileops::remove_file(_model_repo, _size_name);
+    for (int k = 0; k < _nshards; ++k)
+      {
+        fileops::remove_file(_model_repo, shard_name(_index_name, k));
+        fileops::remove_file(_model_repo, shard_name(_il_name, k));
+      }
+    _store.remove();
     std::string db_filename = _model_repo + "/" + _db_name;
     fileops::clear_directory(db_filename);
     rmdir(db_filename.c_str());
@@ -425,102 +1097,374 @@ namespace dd
 
   void FaissSE::index(const URIData &uri, const std::vector<double> &data)
   {
-    if (!_findex->is_trained && _index_size >= _train_samples_size)
-      train();
-    long int idx = _index_size;
-    if (_findex->is_trained)
-      {
-        std::vector<float> d(data.begin(), data.end());
-        _findex->add(1, d.data());
-      }
-    else
-      {
-        _train_samples.insert(_train_samples.end(), data.begin(), data.end());
-      }
-    ++_index_size;
-    add_to_db(idx, uri);
+    std::vector<float> d(data.begin(), data.end());
+    index(std::vector<URIData>({ uri }), d);
   }
 
   void FaissSE::index(const std::vector<URIData> &uris,
                       const std::vector<std::vector<double>> &datas)
   {
-    if (!_findex->is_trained && _index_size >= _train_samples_size)
-      train();
+    std::vector<float> d;
+    d.reserve(uris.size() * _f);
+    for (const std::vector<double> &data : datas)
+      d.insert(d.end(), data.begin(), data.end());
+    index(uris, d);
+  }
+
+  void FaissSE::index(const std::vector<URIData> &uris,
+                      const std::vector<float> &datas)
+  {
+    bool is_trained = trained();
+    if (!is_trained && _index_size >= _train_samples_size)
+      {
+        commit_db();
+        train();
+        is_trained = trained();
+      }
     long int idx = _index_size;
-    if (_findex->is_trained)
+    if (is_trained)
       {
-        std::vector<float> d;
-        for (std::vector<double> data : datas)
-          d.insert(d.end(), data.begin(), data.end());
-        _findex->add(uris.size(), d.data());
+        // new vectors go to the delta, main index is left to readers
+        if (_pending.empty())
+          _pending_base = idx;
+        _pending.insert(_pending.end(), datas.begin(), datas.end());
       }
     else
       {
-        for (std::vector<double> data : datas)
-          _train_samples.insert(_train_samples.end(), data.begin(),
-                                data.end());
+        std::lock_guard<std::mutex> train_lock(_train_mutex);
+        if (_train_samples.empty())
+          _train_base = idx;
+        _train_samples.insert(_train_samples.end(), datas.begin(),
+                              datas.end());
       }
     _index_size += uris.size();
     for (unsigned long int i = 0; i < uris.size(); ++i)
       add_to_db(idx + i, uris[i]);
+    if (_count_put >= _count_put_max)
+      publish(); // batch commit
+  }
+
+  void FaissSE::set_nprobe()
+  {
+    int nprobe = _nprobe;
+    {
+      boost::shared_lock<boost::shared_mutex> lock(_findex_mutex);
+      std::vector<faiss::IndexIVF *> ivfs;
+      get_ivfs(_findex, ivfs);
+      if (ivfs.empty())
+        return;
+      if (nprobe == -1)
+        nprobe = std::max(static_cast<int>(ivfs.at(0)->nlist / 50), 2);
+      if (nprobe == _applied_nprobe)
+        return;
+    }
+    boost::unique_lock<boost::shared_mutex> lock(_findex_mutex);
+    std::vector<faiss::IndexIVF *> ivfs;
+    get_ivfs(_findex, ivfs);
+    for (faiss::IndexIVF *iivf : ivfs)
+      iivf->nprobe = nprobe;
+    _applied_nprobe = nprobe;
   }
 
   void FaissSE::search(const std::vector<double> &vec, const int &nn,
                        std::vector<URIData> &uris,
                        std::vector<double> &distances)
   {
-    if (!_findex->is_trained)
-      train();
-    std::vector<long int> labels(nn, -1);
-    std::vector<float> d(nn, -1.0);
     std::vector<float> v(vec.begin(), vec.end());
-    faiss::IndexIVF *iivf = dynamic_cast<faiss::IndexIVF *>(_findex);
-    if (iivf)
+    std::vector<std::vector<URIData>> vuris;
+    std::vector<std::vector<double>> vdistances;
+    search(v, nn, vuris, vdistances);
+    uris.insert(uris.end(), vuris.at(0).begin(), vuris.at(0).end());
+    distances.insert(distances.end(), vdistances.at(0).begin(),
+                     vdistances.at(0).end());
+  }
+
+  void FaissSE::search_k(const long int &n, const float *vecs, const int &k,
+                         std::vector<float> &d, std::vector<long int> &labels)
+  {
+    labels.assign(n * k, -1);
+    d.assign(n * k, -1.0);
+
+    // shared with other searches, only excluded by merges and training
+    boost::shared_lock<boost::shared_mutex> lock(_findex_mutex);
+    if (!_findex->is_trained)
+      {
+        search_train_samples(n, vecs, k, d, labels);
+        return;
+      }
+    std::shared_ptr<const FaissDelta> delta = std::atomic_load(&_delta);
+
+    // a single multi-query call, parallelized by faiss over queries
+    _findex->search(n, vecs, k, d.data(), labels.data());
+    if (delta->empty())
+      return;
+
+    // merge top-k of the main index and of every delta segment
+    bool ip = (_findex->metric_type == faiss::METRIC_INNER_PRODUCT);
+    std::vector<std::vector<std::pair<float, long int>>> cands(n);
+    for (long int r = 0; r < n * k; ++r)
+      if (labels[r] != -1)
+        cands[r / k].push_back(std::pair<float, long int>(d[r], labels[r]));
+    std::vector<long int> slabels(n * k);
+    std::vector<float> sd(n * k);
+    for (const std::shared_ptr<const FaissSegment> &segment : *delta)
       {
-        if (_nprobe == -1)
+        segment->_index.search(n, vecs, k, sd.data(), slabels.data());
+        for (long int r = 0; r < n * k; ++r)
+          if (slabels[r] != -1)
+            cands[r / k].push_back(std::pair<float, long int>(
+                sd[r], segment->_base + slabels[r]));
+      }
+    for (long int q = 0; q < n; ++q)
+      {
+        std::vector<std::pair<float, long int>> &qc = cands[q];
+        size_t kq = std::min(qc.size(), static_cast<size_t>(k));
+        std::partial_sort(qc.begin(), qc.begin() + kq, qc.end(),
+                          [ip](const std::pair<float, long int> &a,
+                               const std::pair<float, long int> &b) {
+                            return ip ? a.first > b.first : a.first < b.first;
+                          });
+        for (int i = 0; i < k; ++i)
           {
-            int np = iivf->nlist / 50;
-            if (np < 2)
-              iivf->nprobe = 2;
+            long int r = q * k + i;
+            if (static_cast<size_t>(i) < kq)
+              {
+                d[r] = qc[i].first;
+                labels[r] = qc[i].second;
+              }
             else
-              iivf->nprobe = np;
+              labels[r] = -1;
           }
-        else
-          iivf->nprobe = _nprobe;
       }
+  }
 
-    _findex->search(1, v.data(), nn, d.data(), labels.data());
-    for (int i = 0; i < nn; ++i)
+  void FaissSE::search_train_samples(const long int &n, const float *vecs,
+                                     const int &k, std::vector<float> &d,
+                                     std::vector<long int> &labels)
+  {
+    // until the index is trained, its vectors are scanned exhaustively
+    std::lock_guard<std::mutex> train_lock(_train_mutex);
+    bool ip = (_findex->metric_type == faiss::METRIC_INNER_PRODUCT);
+    auto better = [ip](const std::pair<float, long int> &a,
+                       const std::pair<float, long int> &b) {
+      return ip ? a.first > b.first : a.first < b.first;
+    };
+    long int nsamples = _train_samples.size() / _f;
+    for (long int q = 0; q < n; ++q)
       {
-        long int label = labels[i];
-        if (label != -1)
+        const float *qvec = vecs + q * _f;
+        // worst kept neighbor on top
+        std::priority_queue<std::pair<float, long int>,
+                            std::vector<std::pair<float, long int>>,
+                            decltype(better)>
+            heap(better);
+        for (long int s = 0; s < nsamples; ++s)
+          {
+            const float *svec = _train_samples.data() + s * _f;
+            std::pair<float, long int> cand(
+                ip ? faiss::fvec_inner_product(qvec, svec, _f)
+                   : faiss::fvec_L2sqr(qvec, svec, _f),
+                s);
+            if (heap.size() < static_cast<size_t>(k))
+              heap.push(cand);
+            else if (better(cand, heap.top()))
+              {
+                heap.pop();
+                heap.push(cand);
+              }
+          }
+        for (long int i = static_cast<long int>(heap.size()) - 1; i >= 0;
+             --i)
           {
-            URIData uri;
-            get_from_db(label, uri);
-            uris.push_back(uri);
-            distances.push_back(d[i] / ((double)vec.size()));
+            d[q * k + i] = heap.top().first;
+            labels[q * k + i] = _train_base + heap.top().second;
+            heap.pop();
           }
       }
   }
 
-  void FaissSE::add_to_db(const int &idx, const URIData &fmap)
+  void FaissSE::search(const std::vector<float> &vecs, const int &nn,
+                       std::vector<std::vector<URIData>> &uris,
+                       std::vector<std::vector<double>> &distances,
+                       const URIFilter &filter)
   {
-    if (_count_put == 0)
-      _txn = std::unique_ptr<caffe::db::Transaction>(_db->NewTransaction());
-    _txn->Put(std::to_string(idx), fmap.encode());
-    ++_count_put;
-    if (_count_put % _count_put_max == 0)
+    // searches never train the index, they would race with indexing calls
+    set_nprobe();
+    std::shared_ptr<const std::unordered_set<long int>> removed
+        = _store.removed_ids();
+    long int n = vecs.size() / _f;
+    uris.resize(n);
+    distances.resize(n);
+
+    // removed and filtered out entries are compensated by searching more
+    // neighbors for the queries that lack results
+    std::vector<long int> queries(n);
+    for (long int q = 0; q < n; ++q)
+      queries[q] = q;
+    const float *qvecs = vecs.data();
+    std::vector<float> rvecs;
+    int k = nn;
+    // queries whose filter rejects most entries may get less than nn
+    // results, rather than scanning the whole index
+    long int max_k = std::min(static_cast<long int>(nn) * search_max_growth,
+                              _index_size.load());
+    while (!queries.empty())
       {
-        _txn->Commit(); // batch commit
-        _txn = std::unique_ptr<caffe::db::Transaction>(_db->NewTransaction());
+        long int m = queries.size();
+        std::vector<long int> labels;
+        std::vector<float> d;
+        search_k(m, qvecs, k, d, labels);
+        std::vector<URIData> nn_uris;
+        get_from_db(labels, nn_uris);
+
+        std::vector<long int> retries;
+        for (long int qi = 0; qi < m; ++qi)
+          {
+            long int q = queries[qi];
+            bool exhausted = false;
+            uris.at(q).clear();
+            distances.at(q).clear();
+            for (int i = 0; i < k; ++i)
+              {
+                long int r = qi * k + i;
+                if (labels[r] == -1)
+                  {
+                    exhausted = true;
+                    break;
+                  }
+                // training samples may not have committed metadata yet
+                if (uris.at(q).size() >= static_cast<size_t>(nn)
+                    || (removed && removed->find(labels[r]) != removed->end())
+                    || nn_uris.at(r)._uri.empty()
+                    || !filter.accept(nn_uris.at(r)))
+                  continue;
+                uris.at(q).push_back(std::move(nn_uris.at(r)));
+                distances.at(q).push_back(d[r] / static_cast<double>(_f));
+              }
+            if (uris.at(q).size() < static_cast<size_t>(nn) && !exhausted
+                && k < max_k)
+              retries.push_back(q);
+          }
+        if (retries.empty())
+          break;
+        k = static_cast<int>(std::min(static_cast<long int>(k) * 4, max_k));
+        rvecs.clear();
+        for (long int q : retries)
+          rvecs.insert(rvecs.end(), vecs.begin() + q * _f,
+                       vecs.begin() + (q + 1) * _f);
+        qvecs = rvecs.data();
+        queries = retries;
       }
   }
 
+  void FaissSE::remove(const std::vector<std::string> &uris)
+  {
+    // entries are tombstoned right away and dropped from the main index at
+    // the next compaction
+    std::vector<long int> ids;
+    for (const std::string &uri : uris)
+      _store.remove_uri(uri, ids);
+  }
+
+  bool FaissSE::compactable() const
+  {
+    return removable(_findex, false);
+  }
+
+  void FaissSE::compact()
+  {
+    if (_compact_thread.joinable())
+      _compact_thread.join();
+    std::shared_ptr<const std::unordered_set<long int>> removed
+        = _store.removed_ids();
+    if (!removed || removed->size() == _compacted)
+      return;
+    if (!compactable())
+      {
+        std::cerr << "index type cannot be compacted, removed entries are "
+                     "only filtered out at search\n";
+        return;
+      }
+    std::vector<faiss::Index::idx_t> ids(removed->begin(), removed->end());
+    _compacted = removed->size();
+    _compact_thread = std::thread([this, ids]() { compact_main(ids); });
+  }
+
+  void FaissSE::compact_main(const std::vector<faiss::Index::idx_t> &ids)
+  {
+    std::lock_guard<std::mutex> compact_lock(_compact_mutex);
+    faiss::IDSelectorBatch sel(ids.size(), ids.data());
+
+    // the index is rewritten on a copy while readers use the current one
+    faiss::Index *cindex = nullptr;
+    try
+      {
+        {
+          boost::shared_lock<boost::shared_mutex> lock(_findex_mutex);
+          cindex = compacted_copy(_findex, sel);
+        }
+      }
+    catch (std::exception &e)
+      {
+        cindex = nullptr;
+      }
+
+    boost::unique_lock<boost::shared_mutex> lock(_findex_mutex);
+    if (cindex)
+      {
+        delete _findex;
+        _findex = cindex;
+        _applied_nprobe = -1;
+        return;
+      }
+    // indexes that cannot be copied, e.g. on disk, are compacted in place
+    try
+      {
+        compact_in_place(_findex, sel);
+      }
+    catch (std::exception &e)
+      {
+        std::cerr << "could not compact index: " << e.what() << std::endl;
+      }
+  }
+
+  void FaissSE::commit_db()
+  {
+    _store.commit();
+    _count_put = 0;
+  }
+
+  void FaissSE::add_to_db(const int &idx, const URIData &fmap)
+  {
+    _store.put(idx, fmap);
+    ++_count_put;
+  }
+
   void FaissSE::get_from_db(const int &idx, URIData &fmap)
   {
-    std::string tmp;
-    _db->Get(std::to_string(idx), tmp);
-    fmap.decode(tmp);
+    _store.get(idx, fmap);
+  }
+
+  void FaissSE::get_from_db(const std::vector<long int> &idxs,
+                            std::vector<URIData> &fmaps)
+  {
+    // neighbors shared by several queries are only looked up once
+    std::unordered_map<long int, size_t> fetched;
+    fmaps.resize(idxs.size());
+    for (size_t i = 0; i < idxs.size(); ++i)
+      {
+        long int idx = idxs[i];
+        if (idx == -1)
+          continue;
+        auto hit = fetched.find(idx);
+        if (hit != fetched.end())
+          fmaps[i] = fmaps[(*hit).second];
+        else
+          {
+            get_from_db(idx, fmaps[i]);
+            fetched.insert(std::pair<long int, size_t>(idx, i));
+          }
+      }
   }
 
   template class SearchEngine<FaissSE>;
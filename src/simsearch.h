@@ -41,7 +41,15 @@
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #include "caffe/util/db.hpp"
 #pragma GCC diagnostic pop
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <boost/thread/shared_mutex.hpp>
 
 namespace dd
 {
@@ -115,6 +123,95 @@ namespace dd
     static char _enc_char;
   };
 
+  /**
+   * \brief fixed size header of a stored URIData record, followed by the
+   *        bbox floats, the uri and the category bytes
+   */
+  struct URIRecord
+  {
+    uint32_t _uri_len = 0;
+    uint32_t _cat_len = 0;
+    uint32_t _nbbox = 0;
+    float _prob = 0.0;
+  };
+
+  /**
+   * \brief read-only memory mapping of a URIStore, kept alive by readers
+   */
+  class URIStoreMap
+  {
+  public:
+    URIStoreMap(const std::string &offsets_filename,
+                const std::string &records_filename);
+    ~URIStoreMap();
+
+    const uint64_t *_offsets = nullptr; /**< record offset, by id. */
+    long int _size = 0;                 /**< number of records. */
+    const char *_records = nullptr;     /**< packed records. */
+    size_t _offsets_bytes = 0;
+    size_t _records_bytes = 0;
+  };
+
+  /**
+   * \brief append-only id -> URIData table, looked up through memory
+   *        mapped files: an offsets array indexed by id and packed records
+   */
+  class URIStore
+  {
+  public:
+    URIStore()
+    {
+    }
+    ~URIStore();
+
+    void open(const std::string &filename);
+    void close();
+    void remove();
+    bool exists() const;
+
+    void truncate(const long int &size);
+    void put(const long int &idx, const URIData &uri);
+    void commit();
+    bool get(const long int &idx, URIData &uri) const;
+    void remove_uri(const std::string &uri, std::vector<long int> &ids);
+
+    std::shared_ptr<const std::unordered_set<long int>> removed_ids() const
+    {
+      return std::atomic_load(&_removed);
+    }
+    void import_db(const std::string &db_filename,
+                   const std::string &db_backend);
+
+    std::string _filename; /**< store path, without extension. */
+    std::FILE *_foffsets = nullptr;
+    std::FILE *_frecords = nullptr;
+    std::shared_ptr<const URIStoreMap>
+        _map; /**< committed records, swapped atomically. */
+    std::vector<uint64_t> _woffsets; /**< offsets not yet committed. */
+    std::vector<char> _wrecords;     /**< records not yet committed. */
+    uint64_t _records_size = 0;      /**< committed records bytes. */
+    long int _size = 0;              /**< number of records, with pending. */
+    std::FILE *_fremoved = nullptr;
+    std::shared_ptr<const std::unordered_set<long int>>
+        _removed; /**< tombstoned ids, swapped atomically. */
+    std::unordered_map<std::string, std::vector<long int>>
+        _uri_ids; /**< live ids by uri. */
+  };
+
+  /**
+   * \brief restricts similarity search results on their stored metadata
+   */
+  class URIFilter
+  {
+  public:
+    bool accept(const URIData &uri) const
+    {
+      return _cats.empty() || _cats.find(uri._cat) != _cats.end();
+    }
+
+    std::unordered_set<std::string> _cats; /**< accepted categories. */
+  };
+
   template <class TSE> class SearchEngine
   {
   public:
@@ -133,9 +230,22 @@ namespace dd
     void index(const std::vector<URIData> &uris,
                const std::vector<std::vector<double>> &data);
 
+    // batch index, over contiguous row-major vectors of _dim values
+    void index(const std::vector<URIData> &uris,
+               const std::vector<float> &datas);
+
     void search(const std::vector<double> &data, const int &nn,
                 std::vector<URIData> &uris, std::vector<double> &distances);
 
+    // batch search, over contiguous row-major vectors of _dim values
+    void search(const std::vector<float> &datas, const int &nn,
+                std::vector<std::vector<URIData>> &uris,
+                std::vector<std::vector<double>> &distances,
+                const URIFilter &filter = URIFilter());
+
+    // removes every entry indexed under the given uris
+    void remove(const std::vector<std::string> &uris);
+
     const int _dim = 128; /**< indexed vector length. */
     TSE *_tse = nullptr;
     std::mutex _index_mutex; /**< mutex around indexing calls. */
@@ -160,9 +270,19 @@ namespace dd
     void index(const std::vector<URIData> &uris,
                const std::vector<std::vector<double>> &datas);
 
+    void index(const std::vector<URIData> &uris,
+               const std::vector<float> &datas);
+
     void search(const std::vector<double> &vec, const int &nn,
                 std::vector<URIData> &uris, std::vector<double> &distances);
 
+    void search(const std::vector<float> &vecs, const int &nn,
+                std::vector<std::vector<URIData>> &uris,
+                std::vector<std::vector<double>> &distances,
+                const URIFilter &filter = URIFilter());
+
+    void remove(const std::vector<std::string> &uris);
+
     // internal functions
     void build_tree();
 
@@ -186,10 +306,10 @@ namespace dd
         = nullptr;
     int _index_size = 0;
     std::string _model_repo; /**< model directory */
-    const std::string _db_name = "names.bin";
+    const std::string _db_name = "names.bin"; /**< legacy lmdb store. */
     const std::string _db_backend = "lmdb";
-    caffe::db::DB *_db = nullptr;
-    std::unique_ptr<caffe::db::Transaction> _txn;
+    const std::string _store_name = "names";
+    URIStore _store; /**< id -> URIData table. */
     int _count_put = 0;
     int _count_put_max = 1000;
     const std::string _index_name = "index.ann";
@@ -201,6 +321,25 @@ namespace dd
 #endif
 
 #ifdef USE_FAISS
+  /**
+   * \brief immutable flat segment of recently indexed vectors, searched
+   *        alongside the main index until merged into it
+   */
+  class FaissSegment
+  {
+  public:
+    FaissSegment(const int &f, const faiss::MetricType &metric,
+                 const long int &base)
+        : _base(base), _index(f, metric)
+    {
+    }
+
+    long int _base;          /**< id of the first vector in the segment. */
+    faiss::IndexFlat _index; /**< exact index over the segment vectors. */
+  };
+
+  typedef std::vector<std::shared_ptr<const FaissSegment>> FaissDelta;
+
   class FaissSE
   {
   public:
@@ -219,31 +358,81 @@ namespace dd
     void index(const std::vector<URIData> &uris,
                const std::vector<std::vector<double>> &datas);
 
+    void index(const std::vector<URIData> &uris,
+               const std::vector<float> &datas);
+
     void search(const std::vector<double> &vec, const int &nn,
                 std::vector<URIData> &uris, std::vector<double> &distances);
 
+    void search(const std::vector<float> &vecs, const int &nn,
+                std::vector<std::vector<URIData>> &uris,
+                std::vector<std::vector<double>> &distances,
+                const URIFilter &filter = URIFilter());
+
+    void remove(const std::vector<std::string> &uris);
+
     void train();
+    bool trained();
+    void set_nprobe();
+    void publish();
+    void merge();
+    void compact();
+    void compact_main(const std::vector<faiss::Index::idx_t> &ids);
+    bool compactable() const;
+    void search_k(const long int &n, const float *vecs, const int &k,
+                  std::vector<float> &d, std::vector<long int> &labels);
+    void search_train_samples(const long int &n, const float *vecs,
+                              const int &k, std::vector<float> &d,
+                              std::vector<long int> &labels);
+    void add_to_main(const long int &n, const float *data,
+                     const long int &base);
+    faiss::Index *new_index(const std::string &ondisk_filename);
+    std::string shard_name(const std::string &name, const int &k) const;
+    void commit_db();
     void add_to_db(const int &idx, const URIData &fmap);
     void get_from_db(const int &idx, URIData &fmap);
+    void get_from_db(const std::vector<long int> &idxs,
+                     std::vector<URIData> &fmaps);
 
     faiss::Index *_findex = nullptr;
     std::string _index_key;
 
     int _f = 128; /**< indexed vector length. */
-    long int _index_size = 0;
+    std::atomic<long int> _index_size{ 0 };
     std::string _model_repo; /**< model directory */
-    const std::string _db_name = "names.bin";
+    const std::string _db_name = "names.bin"; /**< legacy lmdb store. */
     const std::string _db_backend = "lmdb";
+    const std::string _store_name = "names";
     const std::string _index_name = "index.faiss";
+    const std::string _size_name
+        = "index_size.txt"; /**< number of ids in the saved index. */
     const std::string _il_name = "index_mmap.faiss";
-    caffe::db::DB *_db = nullptr;
-    std::unique_ptr<caffe::db::Transaction> _txn;
+    URIStore _store; /**< id -> URIData table. */
     int _count_put = 0;
     int _count_put_max = 1000;
     int _train_samples_size = 100000;
     bool _ondisk = true;
     int _nprobe = -1;
     std::vector<float> _train_samples;
+    long int _train_base = 0; /**< id of the first training sample. */
+    std::mutex _train_mutex;  /**< guards training samples, appended by
+                                 indexing and scanned by searches until the
+                                 index is trained. */
+
+    int _nshards = 1; /**< number of sub-indexes, searched in parallel. */
+    long int _merge_size
+        = 100000; /**< delta vectors merged into main index at once. */
+    std::vector<float> _pending; /**< indexed vectors not yet searchable. */
+    long int _pending_base = 0;  /**< id of the first pending vector. */
+    std::shared_ptr<const FaissDelta>
+        _delta; /**< searchable segments not yet merged, swapped atomically. */
+    long int _delta_size = 0; /**< number of vectors in delta segments. */
+    std::atomic<int> _applied_nprobe{ -1 };
+    boost::shared_mutex _findex_mutex; /**< held exclusively only while the
+                                          main index is modified. */
+    std::mutex _compact_mutex; /**< excludes merges during compaction. */
+    std::thread _compact_thread;
+    size_t _compacted = 0; /**< removed ids at last compaction. */
 
 #ifdef USE_GPU_FAISS
     bool _gpu = false;
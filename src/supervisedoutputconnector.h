@@ -160,7 +160,7 @@ namespace dd
      */
     void init(const APIData &ad)
     {
-      APIData ad_out = ad.getobj("parameters").getobj("output");
+      const APIData &ad_out = ad.getobj("parameters").getobj("output");
       if (ad_out.has("best"))
         _best = ad_out.get("best").get<int>();
       if (_best == -1)
@@ -174,7 +174,7 @@ namespace dd
     inline void add_results(const std::vector<APIData> &vrad)
     {
       std::unordered_map<std::string, int>::iterator hit;
-      for (APIData ad : vrad)
+      for (const APIData &ad : vrad)
         {
           std::string uri = ad.get("uri").get<std::string>();
           std::string index_uri;
@@ -183,7 +183,7 @@ namespace dd
             index_uri = ad.get("index_uri").get<std::string>();
 #endif
           double loss = ad.get("loss").get<double>();
-          std::vector<double> probs
+          const std::vector<double> &probs
               = ad.get("probs").get<std::vector<double>>();
           std::vector<std::string> cats;
           if (ad.has("cats"))
@@ -447,6 +447,11 @@ namespace dd
 
       std::unordered_set<std::string> indexed_uris;
 #ifdef USE_SIMSEARCH
+      // removal of indexed entries
+      if (ad_in.has("index_remove") && mlm->_se)
+        mlm->_se->remove(
+            ad_in.get("index_remove").get<std::vector<std::string>>());
+
       // index
       if (ad_in.has("index") && ad_in.get("index").get<bool>())
         {
@@ -477,47 +482,31 @@ namespace dd
                 mlm->create_sim_search(index_dim, ad_in);
             }
 
-          // index output content
+          // index output content, features of the whole batch are packed
+          // into a single float32 row-major buffer handed to the index
+          std::vector<URIData> urids;
+          std::vector<float> feats;
           if (!has_roi)
             {
-#ifdef USE_FAISS
-              std::vector<URIData> urids;
-              std::vector<std::vector<double>> probsv;
-#endif
               for (size_t i = 0; i < bcats._vvcats.size(); i++)
                 {
-                  std::vector<double> probs;
                   auto mit = bcats._vvcats.at(i)._cats.begin();
                   while (mit != bcats._vvcats.at(i)._cats.end())
                     {
-                      probs.push_back((*mit).first);
+                      feats.push_back((*mit).first);
                       ++mit;
                     }
-                  URIData urid(bcats._vvcats.at(i)._label);
-#ifdef USE_FAISS
-                  urids.push_back(urid);
-                  probsv.push_back(probs);
-#else
-                  mlm->_se->index(urid, probs);
-#endif
-                  indexed_uris.insert(urid._uri);
+                  urids.emplace_back(bcats._vvcats.at(i)._label);
+                  indexed_uris.insert(urids.back()._uri);
                 }
-#ifdef USE_FAISS
-              mlm->_se->index(urids, probsv);
-#endif
             }
           else // roi
             {
-              int nrois = 0;
               for (size_t i = 0; i < bcats._vvcats.size(); i++)
                 {
                   auto vit = bcats._vvcats.at(i)._vals.begin();
                   auto bit = bcats._vvcats.at(i)._bboxes.begin();
                   auto mit = bcats._vvcats.at(i)._cats.begin();
-#ifdef USE_FAISS
-                  std::vector<URIData> urids;
-                  std::vector<std::vector<double>> datas;
-#endif
                   while (mit != bcats._vvcats.at(i)._cats.end())
                     {
                       std::vector<double> bbox
@@ -527,29 +516,30 @@ namespace dd
                               (*bit).second.get("ymax").get<double>() };
                       double prob = (*mit).first;
                       std::string cat = (*mit).second;
-                      URIData urid(bcats._vvcats.at(i)._label, bbox, prob,
-                                   cat);
-#ifdef USE_FAISS
-                      urids.push_back(urid);
-                      datas.push_back((*vit)
-                                          .second.get("vals")
-                                          .get<std::vector<double>>());
-#else
-                      mlm->_se->index(urid, (*vit)
-                                                .second.get("vals")
-                                                .get<std::vector<double>>());
-#endif
+                      urids.emplace_back(bcats._vvcats.at(i)._label, bbox,
+                                         prob, cat);
+                      const std::vector<double> &rvals
+                          = (*vit)
+                                .second.get("vals")
+                                .get<std::vector<double>>();
+                      feats.insert(feats.end(), rvals.begin(), rvals.end());
+                      indexed_uris.insert(urids.back()._uri);
                       ++mit;
                       ++vit;
                       ++bit;
-                      ++nrois;
-                      indexed_uris.insert(urid._uri);
                     }
-#ifdef USE_FAISS
-                  mlm->_se->index(urids, datas);
-#endif
                 }
             }
+          if (ad_in.has("index_update")
+              && ad_in.get("index_update").get<bool>())
+            {
+              // previous entries of the re-indexed uris are replaced
+              std::vector<std::string> updated_uris(indexed_uris.begin(),
+                                                    indexed_uris.end());
+              mlm->_se->remove(updated_uris);
+            }
+          if (!urids.empty())
+            mlm->_se->index(urids, feats);
         }
 
       // build index
@@ -579,6 +569,14 @@ namespace dd
                 }
             }
 
+          URIFilter search_filter;
+          if (ad_in.has("search_cats"))
+            {
+              std::vector<std::string> search_cats
+                  = ad_in.get("search_cats").get<std::vector<std::string>>();
+              search_filter._cats.insert(search_cats.begin(),
+                                         search_cats.end());
+            }
           int search_nn = _best;
           if (has_roi)
             search_nn = _search_nn;
@@ -588,79 +586,96 @@ namespace dd
           if (ad_in.has("nprobe"))
             mlm->_se->_tse->_nprobe = ad_in.get("nprobe").get<int>();
 #endif
-          if (!has_roi)
+          // all query vectors (one per prediction, or one per roi) are
+          // gathered into a single matrix and searched at once
+          std::vector<float> queries;
+          std::vector<size_t> query_pred; // prediction index of each query
+          for (size_t i = 0; i < bcats._vvcats.size(); i++)
             {
-              for (size_t i = 0; i < bcats._vvcats.size(); i++)
+              if (!has_roi)
                 {
-                  std::vector<double> probs;
                   auto mit = bcats._vvcats.at(i)._cats.begin();
                   while (mit != bcats._vvcats.at(i)._cats.end())
                     {
-                      probs.push_back((*mit).first);
+                      queries.push_back((*mit).first);
                       ++mit;
                     }
-                  std::vector<URIData> nn_uris;
-                  std::vector<double> nn_distances;
-                  mlm->_se->search(probs, search_nn, nn_uris, nn_distances);
-                  for (size_t j = 0; j < nn_uris.size(); j++)
+                  query_pred.push_back(i);
+                }
+              else
+                {
+                  auto vit = bcats._vvcats.at(i)._vals.begin();
+                  auto mit = bcats._vvcats.at(i)._cats.begin();
+                  while (mit
+                         != bcats._vvcats.at(i)
+                                ._cats
+                                .end()) // equivalent to iterating the bboxes
                     {
-                      bcats._vvcats.at(i).add_nn(nn_distances.at(j),
-                                                 nn_uris.at(j));
+                      const std::vector<double> &vals
+                          = (*vit)
+                                .second.get("vals")
+                                .get<std::vector<double>>();
+                      queries.insert(queries.end(), vals.begin(), vals.end());
+                      query_pred.push_back(i);
+                      ++mit;
+                      ++vit;
+                    }
+                }
+            }
+          std::vector<std::vector<URIData>> nn_uris;
+          std::vector<std::vector<double>> nn_distances;
+          if (!query_pred.empty())
+            mlm->_se->search(queries, search_nn, nn_uris, nn_distances,
+                             search_filter);
+
+          if (!has_roi)
+            {
+              for (size_t q = 0; q < query_pred.size(); q++)
+                {
+                  for (size_t j = 0; j < nn_uris.at(q).size(); j++)
+                    {
+                      bcats._vvcats.at(query_pred.at(q))
+                          .add_nn(nn_distances.at(q).at(j),
+                                  nn_uris.at(q).at(j));
                     }
                 }
             }
           else if (has_roi && has_multibox_rois)
             {
+              size_t q = 0;
               for (size_t i = 0; i < bcats._vvcats.size(); i++)
                 {
                   std::unordered_map<std::string, std::pair<double, int>>
                       multibox_nn; // one uri (image) / total distance, count
                   std::unordered_map<std::string,
                                      std::pair<double, int>>::iterator hit;
-                  auto vit = bcats._vvcats.at(i)._vals.begin();
-                  auto mit = bcats._vvcats.at(i)._cats.begin();
-                  while (mit
-                         != bcats._vvcats.at(i)
-                                ._cats
-                                .end()) // equivalent to iterating the bboxes
+                  for (; q < query_pred.size() && query_pred.at(q) == i; q++)
                     {
-                      std::vector<URIData> nn_uris;
-                      std::vector<double> nn_distances;
-                      mlm->_se->search(
-                          (*vit).second.get("vals").get<std::vector<double>>(),
-                          search_nn, nn_uris, nn_distances);
-                      for (size_t j = 0; j < nn_uris.size(); j++)
+                      for (size_t j = 0; j < nn_uris.at(q).size(); j++)
                         {
-                          if ((hit = multibox_nn.find(nn_uris.at(j)._uri))
+                          const URIData &nn_uri = nn_uris.at(q).at(j);
+                          double mb_dist = multibox_distance(
+                              nn_distances.at(q).at(j), nn_uri._prob);
+                          if ((hit = multibox_nn.find(nn_uri._uri))
                               == multibox_nn.end())
                             {
-                              double mb_dist = multibox_distance(
-                                  nn_distances.at(j), nn_uris.at(j)._prob);
                               multibox_nn.insert(
                                   std::pair<std::string,
                                             std::pair<double, int>>(
-                                      nn_uris.at(j)._uri,
+                                      nn_uri._uri,
                                       std::pair<double, int>(mb_dist, 1)));
                             }
                           else
                             {
-                              (*hit).second.first += multibox_distance(
-                                  nn_distances.at(j), nn_uris.at(j)._prob);
+                              (*hit).second.first += mb_dist;
                               (*hit).second.second += 1;
                             }
                         }
-
-                      ++mit;
-                      ++vit;
                     }
                   // final ranking per images and store final results here
                   hit = multibox_nn.begin();
                   while (hit != multibox_nn.end()) // unsorted
                     {
-                      // std::cerr << "adding uri=" << (*hit).first << " /
-                      // dist=" << (*hit).second.first /
-                      // static_cast<double>((*hit).second.second) <<
-                      // std::endl;
                       bcats._vvcats.at(i).add_nn(
                           (*hit).second.first
                               / static_cast<double>((*hit).second.second),
@@ -671,27 +686,17 @@ namespace dd
             }
           else // has_roi
             {
+              size_t q = 0;
               for (size_t i = 0; i < bcats._vvcats.size(); i++)
                 {
                   int bb = 0;
-                  auto vit = bcats._vvcats.at(i)._vals.begin();
-                  auto mit = bcats._vvcats.at(i)._cats.begin();
-                  while (mit
-                         != bcats._vvcats.at(i)
-                                ._cats
-                                .end()) // equivalent to iterating the bboxes
+                  for (; q < query_pred.size() && query_pred.at(q) == i; q++)
                     {
-                      std::vector<URIData> nn_uris;
-                      std::vector<double> nn_distances;
-                      mlm->_se->search(
-                          (*vit).second.get("vals").get<std::vector<double>>(),
-                          search_nn, nn_uris, nn_distances);
-                      ++mit;
-                      ++vit;
-                      for (size_t j = 0; j < nn_uris.size(); j++)
+                      for (size_t j = 0; j < nn_uris.at(q).size(); j++)
                         {
                           bcats._vvcats.at(i).add_bbox_nn(
-                              bb, nn_distances.at(j), nn_uris.at(j));
+                              bb, nn_distances.at(q).at(j),
+                              nn_uris.at(q).at(j));
                         }
                       ++bb;
                     }
@@ -702,12 +707,24 @@ namespace dd
 
       if (has_multibox_rois)
         has_roi = false;
-      if (!timeseries)
-        bcats.to_ad(ad_out, regression, autoencoder, has_bbox, has_roi,
-                    has_mask, timeseries, indexed_uris);
+      const SupervisedOutput &res = timeseries ? *this : bcats;
+      if (ad_out.has("render_predictions"))
+        {
+          // caller only renders predictions to JSON, write them directly
+          ad_out.erase("render_predictions");
+          rapidjson::StringBuffer buffer;
+          rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>,
+                            rapidjson::UTF8<>, rapidjson::CrtAllocator,
+                            rapidjson::kWriteNanAndInfFlag>
+              writer(buffer);
+          res.to_json(writer, regression, autoencoder, has_bbox, has_roi,
+                      has_mask, timeseries, indexed_uris);
+          ad_out.add("predictions_json",
+                     std::string(buffer.GetString(), buffer.GetSize()));
+        }
       else
-        to_ad(ad_out, regression, autoencoder, has_bbox, has_roi, has_mask,
-              timeseries, indexed_uris);
+        res.to_ad(ad_out, regression, autoencoder, has_bbox, has_roi,
+                  has_mask, timeseries, indexed_uris);
     }
 
     struct PredictionAndAnswer
@@ -1245,7 +1262,7 @@ namespace dd
       int batch_size = ad.get("batch_size").get<int>();
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
 
@@ -1346,7 +1363,7 @@ namespace dd
       int batch_size = ad.get("batch_size").get<int>();
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           /* std::cout << "targets: " ; */
@@ -1433,7 +1450,7 @@ namespace dd
 
     static double straight_meas(const APIData &ad)
     {
-      APIData bad = ad.getobj("0");
+      const APIData &bad = ad.getobj("0");
       std::vector<double> acc = bad.get("pred").get<std::vector<double>>();
       if (acc.empty())
         return 0.0;
@@ -1476,7 +1493,7 @@ namespace dd
           double acc = 0.0;
           for (int i = 0; i < batch_size; i++)
             {
-              APIData bad = ad.getobj(std::to_string(i));
+              const APIData &bad = ad.getobj(std::to_string(i));
               std::vector<double> predictions
                   = bad.get("pred").get<std::vector<double>>();
               if (k - 1 >= static_cast<int>(predictions.size()))
@@ -1516,7 +1533,7 @@ namespace dd
       meaniou = 0.0;
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> predictions
               = bad.get("pred").get<std::vector<double>>(); // all best-1
           std::vector<double> targets
@@ -1609,7 +1626,7 @@ namespace dd
       double count_neg = 0.0;
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1655,7 +1672,7 @@ namespace dd
       int batch_size = ad.get("batch_size").get<int>();
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1689,7 +1706,7 @@ namespace dd
       long int total_number = 0;
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1726,7 +1743,7 @@ namespace dd
       long int total_number = 0;
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1757,7 +1774,7 @@ namespace dd
       long int total_number = 0;
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1812,7 +1829,7 @@ namespace dd
 
       for (int i = 0; i < batch_size; ++i)
         {
-          APIData badj = ad.getobj(std::to_string(i));
+          const APIData &badj = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = badj.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1884,7 +1901,7 @@ namespace dd
       double ssres = 0;
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1912,7 +1929,7 @@ namespace dd
 
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1944,7 +1961,7 @@ namespace dd
         delta_scores[k] = 0;
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> targets
               = bad.get("target").get<std::vector<double>>();
           std::vector<double> predictions
@@ -1984,7 +2001,7 @@ namespace dd
       std::vector<std::vector<double>> logits;
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> predictions
               = bad.get("pred").get<std::vector<double>>();
           double target = bad.get("target").get<double>();
@@ -2045,7 +2062,7 @@ namespace dd
       int batch_size = ad.get("batch_size").get<int>();
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> predictions
               = bad.get("pred").get<std::vector<double>>();
           int maxpr = std::distance(
@@ -2117,7 +2134,7 @@ namespace dd
       std::vector<double> confs;
       std::vector<APIData> really_all_logits;
       bool output_logits = false;
-      APIData bad = ad.getobj("0");
+      const APIData &bad = ad.getobj("0");
       int pos_count = ad.get("pos_count").get<int>();
       for (int i = 0; i < pos_count; i++)
         {
@@ -2236,7 +2253,7 @@ namespace dd
       std::map<int, int> APs_count;
 
       // extract tp, fp, labels
-      APIData bad = ad.getobj("0");
+      const APIData &bad = ad.getobj("0");
       int pos_count = ad.get("pos_count").get<int>();
       for (int i = 0; i < pos_count; i++)
         {
@@ -2307,7 +2324,7 @@ namespace dd
       int batch_size = ad.get("batch_size").get<int>();
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           pred1.push_back(bad.get("pred").get<std::vector<double>>().at(1));
           targets.push_back(bad.get("target").get<double>());
         }
@@ -2374,7 +2391,7 @@ namespace dd
       int batch_size = ad.get("batch_size").get<int>();
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> predictions
               = bad.get("pred").get<std::vector<double>>();
           double target = bad.get("target").get<double>();
@@ -2391,7 +2408,7 @@ namespace dd
       int batch_size = ad.get("batch_size").get<int>();
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> predictions
               = bad.get("pred").get<std::vector<double>>();
           int maxpr = std::distance(
@@ -2441,7 +2458,7 @@ namespace dd
 
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           std::vector<double> predictions
               = bad.get("pred").get<std::vector<double>>();
           std::vector<double> target;
@@ -2519,7 +2536,7 @@ namespace dd
       std::vector<double> p(batch_size);
       for (int i = 0; i < batch_size; i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
+          const APIData &bad = ad.getobj(std::to_string(i));
           a.at(i) = bad.get("target").get<double>();
           if (regression)
             p.at(i) = bad.get("pred").get<std::vector<double>>().at(
@@ -2728,6 +2745,172 @@ namespace dd
       out.add("predictions", vpred);
     }
 
+    /**
+     * \brief write supervised output predictions as a JSON array to a
+     *        rapidjson writer, same layout as to_ad but without building
+     *        intermediate data objects
+     * @param writer destination rapidjson writer
+     * @see to_ad for the other parameters
+     */
+    template <typename TWriter>
+    void to_json(TWriter &writer, const bool &regression,
+                 const bool &autoencoder, const bool &has_bbox,
+                 const bool &has_roi, const bool &has_mask,
+                 const bool &timeseries,
+                 const std::unordered_set<std::string> &indexed_uris) const
+    {
+#ifndef USE_SIMSEARCH
+      (void)indexed_uris;
+#endif
+      const char *vkey = "classes";
+      if (timeseries)
+        vkey = "series";
+      else if (regression)
+        vkey = "vector";
+      else if (autoencoder)
+        vkey = "losses";
+      else if (has_roi)
+        vkey = "rois";
+
+      writer.StartArray();
+      for (const sup_result &res : _vvcats)
+        {
+          writer.StartObject();
+          if (res._loss > 0.0) // XXX: not set by Caffe in prediction mode
+            {
+              writer.Key("loss");
+              writer.Double(res._loss);
+            }
+          writer.Key("uri");
+          writer.String(res._label.c_str(), res._label.size());
+#ifdef USE_SIMSEARCH
+          if (!res._index_uri.empty())
+            {
+              writer.Key("index_uri");
+              writer.String(res._index_uri.c_str(), res._index_uri.size());
+            }
+          if (!indexed_uris.empty()
+              && indexed_uris.find(res._label) != indexed_uris.end())
+            {
+              writer.Key("indexed");
+              writer.Bool(true);
+            }
+          if (!has_roi && !res._nns.empty())
+            {
+              writer.Key("nns");
+              writer.StartArray();
+              for (auto nnit = res._nns.begin(); nnit != res._nns.end();
+                   ++nnit)
+                {
+                  writer.StartObject();
+                  writer.Key("uri");
+                  writer.String((*nnit).second._uri.c_str(),
+                                (*nnit).second._uri.size());
+                  writer.Key("dist");
+                  writer.Double((*nnit).first);
+                  writer.EndObject();
+                }
+              writer.EndArray();
+            }
+#endif
+
+          writer.Key(vkey);
+          writer.StartArray();
+          size_t k = 0;
+          auto bit = res._bboxes.begin();
+          auto vit = res._vals.begin();
+          auto maskit = res._masks.begin();
+          for (auto mit = res._cats.begin(); mit != res._cats.end();
+               ++mit, ++k)
+            {
+              writer.StartObject();
+              if (!autoencoder)
+                {
+                  writer.Key("cat");
+                  writer.String((*mit).second.c_str(), (*mit).second.size());
+                }
+              writer.Key(regression ? "val" : autoencoder ? "loss" : "prob");
+              writer.Double((*mit).first);
+              if (has_bbox || has_roi || has_mask)
+                {
+                  writer.Key("bbox");
+                  (*bit).second.toJWriter(writer);
+                  ++bit;
+                }
+              if (has_roi)
+                {
+                  writer.Key("vals");
+                  visitor_rwriter<TWriter> vrw(writer);
+                  vrw((*vit).second.get("vals").get<std::vector<double>>());
+                  ++vit;
+                }
+              if (has_mask)
+                {
+                  writer.Key("mask");
+                  (*maskit).second.toJWriter(writer);
+                  ++maskit;
+                }
+#ifdef USE_SIMSEARCH
+              if (has_roi && k < res._bbox_nns.size())
+                {
+                  writer.Key("nns");
+                  writer.StartArray();
+                  for (auto nnit = res._bbox_nns.at(k).begin();
+                       nnit != res._bbox_nns.at(k).end(); ++nnit)
+                    {
+                      const URIData &nn = (*nnit).second;
+                      writer.StartObject();
+                      writer.Key("uri");
+                      writer.String(nn._uri.c_str(), nn._uri.size());
+                      writer.Key("dist");
+                      writer.Double((*nnit).first);
+                      writer.Key("prob");
+                      writer.Double(nn._prob);
+                      writer.Key("cat");
+                      writer.String(nn._cat.c_str(), nn._cat.size());
+                      writer.Key("bbox");
+                      writer.StartObject();
+                      writer.Key("xmin");
+                      writer.Double(nn._bbox.at(0));
+                      writer.Key("ymin");
+                      writer.Double(nn._bbox.at(1));
+                      writer.Key("xmax");
+                      writer.Double(nn._bbox.at(2));
+                      writer.Key("ymax");
+                      writer.Double(nn._bbox.at(3));
+                      writer.EndObject();
+                      writer.EndObject();
+                    }
+                  writer.EndArray();
+                }
+#endif
+              if (std::next(mit) == res._cats.end())
+                {
+                  writer.Key("last");
+                  writer.Bool(true);
+                }
+              writer.EndObject();
+            }
+          for (auto sit = res._series.begin(); sit != res._series.end();
+               ++sit)
+            {
+              writer.StartObject();
+              writer.Key("out");
+              visitor_rwriter<TWriter> vrw(writer);
+              vrw((*sit).second.get("out").get<std::vector<double>>());
+              if (std::next(sit) == res._series.end())
+                {
+                  writer.Key("last");
+                  writer.Bool(true);
+                }
+              writer.EndObject();
+            }
+          writer.EndArray();
+          writer.EndObject();
+        }
+      writer.EndArray();
+    }
+
     std::unordered_map<std::string, int>
         _vcats;                      /**< batch of results, per uri. */
     std::vector<sup_result> _vvcats; /**< ordered results, per uri. */
@@ -35,28 +35,60 @@ namespace dd
     {
     }
 
+    unsup_result(const std::string &uri, const std::vector<float> &fvals,
+                 const APIData &extra = APIData(),
+                 const std::string &meta_uri = "")
+        : _uri(uri), _fvals(fvals), _extra(extra), _meta_uri(meta_uri)
+    {
+    }
+
     ~unsup_result()
     {
     }
 
+    size_t size() const
+    {
+      return _fvals.empty() ? _vals.size() : _fvals.size();
+    }
+
+    double val(const size_t &i) const
+    {
+      return _fvals.empty() ? _vals.at(i) : _fvals.at(i);
+    }
+
+    /**
+     * \brief appends values to a float32 buffer, e.g. for indexing
+     */
+    void append_to(std::vector<float> &buf) const
+    {
+      if (_fvals.empty())
+        buf.insert(buf.end(), _vals.begin(), _vals.end());
+      else
+        buf.insert(buf.end(), _fvals.begin(), _fvals.end());
+    }
+
     void binarized()
     {
       for (size_t i = 0; i < _vals.size(); i++)
         _vals.at(i) = _vals.at(i) <= 0.0 ? 0.0 : 1.0;
+      for (size_t i = 0; i < _fvals.size(); i++)
+        _fvals.at(i) = _fvals.at(i) <= 0.0f ? 0.0f : 1.0f;
     }
 
     void bool_binarized()
     {
-      for (size_t i = 0; i < _vals.size(); i++)
-        _bvals.push_back(_vals.at(i) <= 0.0 ? false : true);
+      for (size_t i = 0; i < size(); i++)
+        _bvals.push_back(val(i) <= 0.0 ? false : true);
       _vals.clear();
+      _fvals.clear();
     }
 
     void string_binarized()
     {
-      for (size_t i = 0; i < _vals.size(); i++)
-        _str += _vals.at(i) <= 0.0 ? "0" : "1";
+      for (size_t i = 0; i < size(); i++)
+        _str += val(i) <= 0.0 ? "0" : "1";
       _vals.clear();
+      _fvals.clear();
     }
 
 #ifdef USE_SIMSEARCH
@@ -68,6 +100,7 @@ namespace dd
 
     std::string _uri;
     std::vector<double> _vals;
+    std::vector<float> _fvals; /**< float32 values, in place of _vals. */
     std::vector<bool> _bvals;
     std::string _str;
 #ifdef USE_SIMSEARCH
@@ -111,7 +144,7 @@ namespace dd
     void add_results(const std::vector<APIData> &vrad)
     {
       std::unordered_map<std::string, int>::iterator hit;
-      for (APIData ad : vrad)
+      for (const APIData &ad : vrad)
         {
           std::string uri = ad.get("uri").get<std::string>();
           if (!ad.has("vals"))
@@ -120,7 +153,6 @@ namespace dd
                   "unsupervised output needs mllib.extract_layer param");
               return;
             }
-          std::vector<double> vals = ad.get("vals").get<std::vector<double>>();
           if ((hit = _vres.find(uri)) == _vres.end())
             {
               _vres.insert(std::pair<std::string, int>(uri, _vvres.size()));
@@ -134,7 +166,16 @@ namespace dd
                 meta_uri = ad.get("index_uri").get<std::string>();
               else if (ad.has("meta_uri"))
                 meta_uri = ad.get("meta_uri").get<std::string>();
-              _vvres.push_back(unsup_result(uri, vals, extra, meta_uri));
+              // float32 backend outputs are kept as is
+              const ad_variant_type &vals = ad.get("vals");
+              if (vals.is<std::vector<float>>())
+                _vvres.push_back(
+                    unsup_result(uri, vals.get<std::vector<float>>(), extra,
+                                 meta_uri));
+              else
+                _vvres.push_back(
+                    unsup_result(uri, vals.get<std::vector<double>>(), extra,
+                                 meta_uri));
             }
         }
     }
@@ -174,42 +215,48 @@ namespace dd
 
       std::unordered_set<std::string> indexed_uris;
 #ifdef USE_SIMSEARCH
+      // removal of indexed entries
+      if (ad_in.has("index_remove") && mlm->_se)
+        mlm->_se->remove(
+            ad_in.get("index_remove").get<std::vector<std::string>>());
+
       if (ad_in.has("index") && ad_in.get("index").get<bool>())
         {
           // check whether index has been created
           if (!mlm->_se)
             {
               int index_dim
-                  = _vvres.at(0)._vals.size(); // XXX: lookup to the batch's
-                                               // first output, as they should
-                                               // all have the same size
+                  = _vvres.at(0).size(); // XXX: lookup to the batch's
+                                         // first output, as they should
+                                         // all have the same size
               mlm->create_sim_search(index_dim, ad_in);
             }
 
-            // index output content -> vector (XXX: will need to flatten in
-            // case of multiple vectors)
-#ifdef USE_FAISS
+          // index output content, packed as a single float32 row-major
+          // buffer (XXX: will need to flatten in case of multiple vectors)
           std::vector<URIData> urids;
-          std::vector<std::vector<double>> vvals;
-#endif
+          std::vector<float> feats;
+          if (!_vvres.empty())
+            feats.reserve(_vvres.size() * _vvres.at(0).size());
           for (size_t i = 0; i < _vvres.size(); i++)
             {
-              URIData urid;
               if (_vvres.at(i)._meta_uri.empty())
-                urid = URIData(_vvres.at(i)._uri);
+                urids.emplace_back(_vvres.at(i)._uri);
               else
-                urid = URIData(_vvres.at(i)._meta_uri);
-#ifdef USE_FAISS
-              urids.push_back(urid);
-              vvals.push_back(_vvres.at(i)._vals);
-#else
-              mlm->_se->index(urid, _vvres.at(i)._vals);
-#endif
-              indexed_uris.insert(urid._uri);
+                urids.emplace_back(_vvres.at(i)._meta_uri);
+              _vvres.at(i).append_to(feats);
+              indexed_uris.insert(urids.back()._uri);
             }
-#ifdef USE_FAISS
-          mlm->_se->index(urids, vvals);
-#endif
+          if (ad_in.has("index_update")
+              && ad_in.get("index_update").get<bool>())
+            {
+              // previous entries of the re-indexed uris are replaced
+              std::vector<std::string> updated_uris(indexed_uris.begin(),
+                                                    indexed_uris.end());
+              mlm->_se->remove(updated_uris);
+            }
+          if (!urids.empty())
+            mlm->_se->index(urids, feats);
         }
       if (ad_in.has("build_index") && ad_in.get("build_index").get<bool>())
         {
@@ -224,12 +271,20 @@ namespace dd
           if (!mlm->_se)
             {
               int index_dim
-                  = _vvres.at(0)._vals.size(); // XXX: lookup to the batch's
-                                               // first output, as they should
-                                               // all have the same size
+                  = _vvres.at(0).size(); // XXX: lookup to the batch's
+                                         // first output, as they should
+                                         // all have the same size
               mlm->create_sim_search(index_dim, ad_in);
             }
 
+          URIFilter search_filter;
+          if (ad_in.has("search_cats"))
+            {
+              std::vector<std::string> search_cats
+                  = ad_in.get("search_cats").get<std::vector<std::string>>();
+              search_filter._cats.insert(search_cats.begin(),
+                                         search_cats.end());
+            }
           int search_nn = _search_nn;
           if (ad_in.has("search_nn"))
             search_nn = ad_in.get("search_nn").get<int>();
@@ -237,15 +292,21 @@ namespace dd
           if (ad_in.has("nprobe"))
             mlm->_se->_tse->_nprobe = ad_in.get("nprobe").get<int>();
 #endif
+          // whole batch is searched at once
+          std::vector<float> queries;
           for (size_t i = 0; i < _vvres.size(); i++)
+            _vvres.at(i).append_to(queries);
+          std::vector<std::vector<URIData>> nn_uris;
+          std::vector<std::vector<double>> nn_distances;
+          if (!_vvres.empty())
+            mlm->_se->search(queries, search_nn, nn_uris, nn_distances,
+                             search_filter);
+          for (size_t i = 0; i < nn_uris.size(); i++)
             {
-              std::vector<URIData> nn_uris;
-              std::vector<double> nn_distances;
-              mlm->_se->search(_vvres.at(i)._vals, search_nn, nn_uris,
-                               nn_distances);
-              for (size_t j = 0; j < nn_uris.size(); j++)
+              for (size_t j = 0; j < nn_uris.at(i).size(); j++)
                 {
-                  _vvres.at(i).add_nn(nn_distances.at(j), nn_uris.at(j)._uri);
+                  _vvres.at(i).add_nn(nn_distances.at(i).at(j),
+                                      nn_uris.at(i).at(j)._uri);
                 }
             }
         }
@@ -270,6 +331,8 @@ namespace dd
             adpred.add("vals", _vvres.at(i)._bvals);
           else if (_string_binarized)
             adpred.add("vals", _vvres.at(i)._str);
+          else if (!_vvres.at(i)._fvals.empty())
+            adpred.add("vals", _vvres.at(i)._fvals);
           else
             adpred.add("vals", _vvres.at(i)._vals);
           if (_vvres.at(i)._extra.has("imgsize"))
@@ -23,10 +23,27 @@
 #include <curlpp/Easy.hpp>
 #include <curlpp/Options.hpp>
 #include <curlpp/Infos.hpp>
+#include <curl/curl.h>
 
 #ifndef DD_HTTPCLIENT_H
 #define DD_HTTPCLIENT_H
 
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+// curl_multi_poll() and curl_multi_wakeup() appeared in libcurl 7.68, older
+// versions wait with curl_multi_wait() on a wakeup pipe instead
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define DD_CURL_MULTI_POLL
+#endif
+
 namespace dd
 {
 
@@ -87,6 +104,256 @@ namespace dd
     }
   };
 
+  /**
+   * \brief response of an asynchronous fetch
+   */
+  struct http_response
+  {
+    int _code = -1;       /**< HTTP status code. */
+    std::string _content; /**< response body. */
+  };
+
+  /**
+   * \brief asynchronous GET calls, shared by all input connectors.
+   *        Transfers run concurrently on a single thread from a curl multi
+   *        handle, that keeps connections alive and reuses them across
+   *        calls, with a bounded number of connections per host.
+   */
+  class httpfetcher
+  {
+  public:
+    /**
+     * \brief process-wide fetcher
+     */
+    static httpfetcher &instance()
+    {
+      static httpfetcher fetcher;
+      return fetcher;
+    }
+
+    ~httpfetcher()
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      wakeup();
+      _thread.join();
+      for (auto &t : _queued)
+        fail(*t, "fetcher stopped");
+      for (auto &t : _running)
+        {
+          curl_multi_remove_handle(_multi, t->_easy);
+          fail(*t, "fetcher stopped");
+        }
+      curl_multi_cleanup(_multi);
+#ifndef DD_CURL_MULTI_POLL
+      ::close(_wakeup_fds[0]);
+      ::close(_wakeup_fds[1]);
+#endif
+    }
+
+    /**
+     * \brief starts fetching a URL
+     * @param url URL to GET
+     * @param timeout transfer timeout, in seconds
+     * @return response, throws on transfer error
+     */
+    std::future<http_response> fetch(const std::string &url,
+                                     const int &timeout = _default_timeout)
+    {
+      std::unique_ptr<transfer> t(new transfer());
+      std::future<http_response> fut = t->_promise.get_future();
+      if (timeout > _max_timeout)
+        {
+          fail(*t, "timeout value is above max default timeout ("
+                       + std::to_string(_max_timeout) + ")");
+          return fut;
+        }
+      t->_easy = curl_easy_init();
+      if (!t->_easy)
+        {
+          fail(*t, "could not create transfer for " + url);
+          return fut;
+        }
+      curl_easy_setopt(t->_easy, CURLOPT_URL, url.c_str());
+      curl_easy_setopt(t->_easy, CURLOPT_FOLLOWLOCATION, 1L);
+      curl_easy_setopt(t->_easy, CURLOPT_TIMEOUT, static_cast<long>(timeout));
+      curl_easy_setopt(t->_easy, CURLOPT_NOSIGNAL, 1L);
+      curl_easy_setopt(t->_easy, CURLOPT_TCP_KEEPALIVE, 1L);
+      curl_easy_setopt(t->_easy, CURLOPT_WRITEFUNCTION, &httpfetcher::write);
+      curl_easy_setopt(t->_easy, CURLOPT_WRITEDATA, t.get());
+      curl_easy_setopt(t->_easy, CURLOPT_ERRORBUFFER, t->_errbuf);
+      curl_easy_setopt(t->_easy, CURLOPT_PRIVATE, t.get());
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queued.push_back(std::move(t));
+      }
+      wakeup();
+      return fut;
+    }
+
+    static const long _max_host_connections = 8;
+    static const long _max_connections = 64;
+
+  private:
+    /**
+     * \brief a single transfer
+     */
+    struct transfer
+    {
+      ~transfer()
+      {
+        if (_easy)
+          curl_easy_cleanup(_easy);
+      }
+
+      CURL *_easy = nullptr;
+      std::string _content;
+      char _errbuf[CURL_ERROR_SIZE] = { 0 };
+      std::promise<http_response> _promise;
+    };
+
+    httpfetcher()
+    {
+      curl_global_init(CURL_GLOBAL_ALL);
+      _multi = curl_multi_init();
+      curl_multi_setopt(_multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                        _max_host_connections);
+      curl_multi_setopt(_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+                        _max_connections);
+      curl_multi_setopt(_multi, CURLMOPT_MAXCONNECTS, _max_connections);
+      curl_multi_setopt(_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#ifndef DD_CURL_MULTI_POLL
+      if (pipe(_wakeup_fds) != 0)
+        throw std::runtime_error("could not create fetcher wakeup pipe");
+      for (int fd : _wakeup_fds)
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+      _thread = std::thread([this]() { run(); });
+    }
+
+    /**
+     * \brief interrupts the transfers loop wait
+     */
+    void wakeup()
+    {
+#ifdef DD_CURL_MULTI_POLL
+      curl_multi_wakeup(_multi);
+#else
+      // a full pipe already has a pending wakeup
+      char c = 0;
+      if (::write(_wakeup_fds[1], &c, 1) < 0)
+        return;
+#endif
+    }
+
+    /**
+     * \brief waits for transfers activity or a wakeup
+     * @param timeout_ms max wait time, in milliseconds
+     */
+    void wait(const int &timeout_ms)
+    {
+#ifdef DD_CURL_MULTI_POLL
+      curl_multi_poll(_multi, nullptr, 0, timeout_ms, nullptr);
+#else
+      curl_waitfd wfd;
+      wfd.fd = _wakeup_fds[0];
+      wfd.events = CURL_WAIT_POLLIN;
+      wfd.revents = 0;
+      curl_multi_wait(_multi, &wfd, 1, timeout_ms, nullptr);
+      char buf[64];
+      while (::read(_wakeup_fds[0], buf, sizeof(buf)) > 0)
+        ;
+#endif
+    }
+
+    static size_t write(char *ptr, size_t size, size_t nmemb, void *userdata)
+    {
+      static_cast<transfer *>(userdata)->_content.append(ptr, size * nmemb);
+      return size * nmemb;
+    }
+
+    static void fail(transfer &t, const std::string &msg)
+    {
+      t._promise.set_exception(
+          std::make_exception_ptr(std::runtime_error(msg)));
+    }
+
+    /**
+     * \brief transfers loop
+     */
+    void run()
+    {
+      while (true)
+        {
+          {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_stop)
+              break;
+            while (!_queued.empty())
+              {
+                curl_multi_add_handle(_multi, _queued.front()->_easy);
+                _running.push_back(std::move(_queued.front()));
+                _queued.pop_front();
+              }
+          }
+
+          int still_running = 0;
+          curl_multi_perform(_multi, &still_running);
+          CURLMsg *msg = nullptr;
+          int msgs_left = 0;
+          while ((msg = curl_multi_info_read(_multi, &msgs_left)))
+            {
+              if (msg->msg != CURLMSG_DONE)
+                continue;
+              done(msg->easy_handle, msg->data.result);
+            }
+          wait(1000);
+        }
+    }
+
+    /**
+     * \brief completes a transfer
+     */
+    void done(CURL *easy, const CURLcode &result)
+    {
+      transfer *tp = nullptr;
+      curl_easy_getinfo(easy, CURLINFO_PRIVATE, &tp);
+      curl_multi_remove_handle(_multi, easy);
+      auto tit = std::find_if(
+          _running.begin(), _running.end(),
+          [tp](const std::unique_ptr<transfer> &t) { return t.get() == tp; });
+      if (tit == _running.end())
+        return;
+      std::unique_ptr<transfer> t = std::move(*tit);
+      _running.erase(tit);
+
+      if (result != CURLE_OK)
+        {
+          fail(*t, std::string(curl_easy_strerror(result)) + ": "
+                       + t->_errbuf);
+          return;
+        }
+      http_response resp;
+      long code = 0;
+      curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &code);
+      resp._code = static_cast<int>(code);
+      resp._content = std::move(t->_content);
+      t->_promise.set_value(std::move(resp));
+    }
+
+    CURLM *_multi = nullptr;
+    std::thread _thread;
+    std::mutex _mutex;
+    bool _stop = false;
+#ifndef DD_CURL_MULTI_POLL
+    int _wakeup_fds[2] = { -1, -1 }; /**< wakeup pipe, read and write ends. */
+#endif
+    std::deque<std::unique_ptr<transfer>> _queued; /**< not yet started. */
+    std::deque<std::unique_ptr<transfer>> _running; /**< in progress. */
+  };
+
 }
 
 #endif
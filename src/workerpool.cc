@@ -0,0 +1,97 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2021 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "workerpool.h"
+
+#include <algorithm>
+
+namespace dd
+{
+  WorkerPool::WorkerPool(const int &nworkers)
+  {
+    for (int w = 0; w < std::max(1, nworkers); w++)
+      _workers.emplace_back(&WorkerPool::work, this, w);
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _job_cv.notify_all();
+    for (std::thread &t : _workers)
+      t.join();
+  }
+
+  void WorkerPool::run(const int &nworkers,
+                        const std::function<void(const int &)> &job)
+  {
+    std::lock_guard<std::mutex> run_lock(_run_mutex);
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _job = &job;
+      _active = std::max(1, std::min(nworkers, size()));
+      _pending = _active;
+      _errors.assign(_active, nullptr);
+      ++_generation;
+    }
+    _job_cv.notify_all();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [this]() { return _pending == 0; });
+    _job = nullptr;
+    for (std::exception_ptr &e : _errors)
+      if (e)
+        std::rethrow_exception(e);
+  }
+
+  void WorkerPool::work(const int w)
+  {
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+      {
+        _job_cv.wait(lock, [this, &generation]()
+                     { return _stop || _generation != generation; });
+        if (_stop)
+          return;
+        generation = _generation;
+        if (w >= _active)
+          continue;
+
+        const std::function<void(const int &)> *job = _job;
+        lock.unlock();
+        std::exception_ptr error;
+        try
+          {
+            (*job)(w);
+          }
+        catch (...)
+          {
+            error = std::current_exception();
+          }
+        lock.lock();
+        _errors.at(w) = error;
+        if (--_pending == 0)
+          _done_cv.notify_all();
+      }
+  }
+}
@@ -0,0 +1,88 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2021 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dd
+{
+  /**
+   * \brief persistent worker threads, e.g. inference workers of an NCNN
+   *        service or data-parallel training workers of a torch service.
+   *        Workers are kept in between runs, and so is the OpenMP thread
+   *        team each of them uses within layers.
+   */
+  class WorkerPool
+  {
+  public:
+    /**
+     * \brief starts workers
+     * @param nworkers number of workers
+     */
+    WorkerPool(const int &nworkers);
+
+    ~WorkerPool();
+
+    /**
+     * \brief runs job(w) on workers w = 0 .. nworkers - 1 and waits for all
+     *        of them. Runs are serialized, the first job error is rethrown.
+     * @param nworkers number of workers to run the job on, at most size()
+     * @param job job to run, with the worker index as argument
+     */
+    void run(const int &nworkers, const std::function<void(const int &)> &job);
+
+    /**
+     * \brief number of workers
+     */
+    int size() const
+    {
+      return static_cast<int>(_workers.size());
+    }
+
+  private:
+    /**
+     * \brief worker loop, waits for and runs jobs
+     */
+    void work(const int w);
+
+    std::vector<std::thread> _workers;
+    std::mutex _run_mutex; /**< one run at a time. */
+    std::mutex _mutex;
+    std::condition_variable _job_cv;
+    std::condition_variable _done_cv;
+    const std::function<void(const int &)> *_job
+        = nullptr;              /**< current job. */
+    int _active = 0;            /**< number of workers on the current job. */
+    int _pending = 0;           /**< number of workers still on the job. */
+    uint64_t _generation = 0;   /**< job counter. */
+    bool _stop = false;         /**< whether workers have to exit. */
+    std::vector<std::exception_ptr> _errors; /**< job errors per worker. */
+  };
+}
+
+#endif
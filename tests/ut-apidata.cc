@@ -69,6 +69,8 @@ TEST(apidata, to_from_json)
   ad.add("bool", true);
   std::vector<double> vd = { 1.1, 2.2, 3.3 };
   ad.add("vdouble", vd);
+  std::vector<float> vf = { 0.5f, 1.5f };
+  ad.add("vfloat", vf);
   std::vector<std::string> vs = { "one", "two", "three" };
   ad.add("vstring", vs);
   std::vector<APIData> vad;
@@ -94,6 +96,8 @@ TEST(apidata, to_from_json)
   ASSERT_EQ(true, jd["bool"]);
   ASSERT_TRUE(jd["vdouble"].IsArray());
   ASSERT_EQ(1.1, jd["vdouble"][0]);
+  ASSERT_TRUE(jd["vfloat"].IsArray());
+  ASSERT_EQ(1.5, jd["vfloat"][1].GetDouble());
   ASSERT_TRUE(jd["vstring"].IsArray());
   ASSERT_TRUE(jd["vstring"][1].GetString() == std::string("two"));
   ASSERT_TRUE(jd["classes"].IsArray());
@@ -108,6 +112,7 @@ TEST(apidata, to_from_json)
   ASSERT_EQ(true, nad.get("bool").get<bool>());
   ASSERT_EQ(3, nad.get("vdouble").get<std::vector<double>>().size());
   ASSERT_EQ(2.2, nad.get("vdouble").get<std::vector<double>>().at(1));
+  ASSERT_EQ(1.5, nad.get("vfloat").get<std::vector<double>>().at(1));
   ASSERT_EQ(3, nad.get("vstring").get<std::vector<std::string>>().size());
   ASSERT_EQ("two", nad.get("vstring").get<std::vector<std::string>>().at(1));
 
@@ -127,3 +132,29 @@ TEST(apidata, to_from_json)
   ASSERT_TRUE(njd["classes"][0]["cat"].GetString() == std::string("car"));
   ASSERT_EQ(prob1, njd["classes"][0]["prob"].GetDouble());
 }
+
+TEST(apidata, getobj_ref_and_move)
+{
+  APIData ad;
+  APIData tad;
+  tad.add("test", 1);
+  ad.add("tad", tad);
+
+  // accessors return references into the object, not copies
+  const APIData &rtad = ad.getobj("tad");
+  ASSERT_EQ(&rtad, ad.getobj_ptr("tad"));
+  ASSERT_EQ(1, rtad.get("test").get<int>());
+  ASSERT_EQ(&ad.get("tad"), &ad.get("tad"));
+
+  // missing keys yield an empty object
+  ASSERT_EQ(nullptr, ad.getobj_ptr("none"));
+  ASSERT_TRUE(ad.getobj("none").empty());
+
+  // moved values are stored and replace existing keys
+  std::vector<double> probs = { 0.1, 0.2, 0.7 };
+  ad.add("probs", std::move(probs));
+  ASSERT_EQ(3, ad.get("probs").get<std::vector<double>>().size());
+  ad.add("probs", std::vector<double>{ 1.0 });
+  ASSERT_EQ(1, ad.get("probs").get<std::vector<double>>().size());
+  ASSERT_EQ(1.0, ad.get("probs").get<std::vector<double>>().at(0));
+}
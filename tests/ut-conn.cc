@@ -28,6 +28,10 @@
 #include "jsonapi.h"
 #include <gtest/gtest.h>
 #include <iostream>
+#include <atomic>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 using namespace dd;
 
@@ -284,6 +288,173 @@ TEST(outputconn, cmfull)
       "696539702293474e308,2.696539702293474e308,2.696539702293474e308]}]"));
 }
 
+TEST(outputconn, to_json)
+{
+  SupervisedOutput so;
+  std::vector<std::string> cats = { "car", "dog", "cat" };
+  std::vector<double> probs = { 0.9, 0.45, 0.2 };
+  for (int r = 0; r < 2; r++)
+    {
+      SupervisedOutput::sup_result res("img" + std::to_string(r));
+      for (size_t i = 0; i < cats.size(); i++)
+        {
+          APIData bbox;
+          bbox.add("xmin", 10.0 * i);
+          bbox.add("ymin", 5.0 * i);
+          bbox.add("xmax", 10.0 * i + 42.5);
+          bbox.add("ymax", 5.0 * i + 17.25);
+          res.add_cat(probs.at(i) / (r + 1), cats.at(i));
+          res.add_bbox(probs.at(i) / (r + 1), bbox);
+        }
+      so._vvcats.push_back(res);
+    }
+  std::unordered_set<std::string> indexed_uris;
+
+  // reference: data object, then JSON document
+  APIData out;
+  so.to_ad(out, false, false, true, false, false, false, indexed_uris);
+  JDoc jref;
+  jref.SetObject();
+  out.toJDoc(jref);
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>,
+                    rapidjson::UTF8<>, rapidjson::CrtAllocator,
+                    rapidjson::kWriteNanAndInfFlag>
+      writer(buffer);
+  so.to_json(writer, false, false, true, false, false, false, indexed_uris);
+  ASSERT_TRUE(writer.IsComplete());
+  JDoc jd;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(buffer.GetString());
+  ASSERT_FALSE(jd.HasParseError());
+  ASSERT_TRUE(jd.IsArray());
+  ASSERT_EQ(2, jd.Size());
+  ASSERT_TRUE(jd == jref["predictions"]);
+  ASSERT_EQ(std::string("car"), jd[0]["classes"][0]["cat"].GetString());
+  ASSERT_EQ(42.5, jd[0]["classes"][0]["bbox"]["xmax"].GetDouble());
+  ASSERT_TRUE(jd[1]["classes"][2]["last"].GetBool());
+}
+
+// minimal HTTP/1.1 keep-alive server, for fetching tests
+class LocalHTTPServer
+{
+public:
+  LocalHTTPServer(const std::string &body) : _body(body)
+  {
+    _sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    bind(_sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(_sock, reinterpret_cast<sockaddr *>(&addr), &len);
+    _port = ntohs(addr.sin_port);
+    listen(_sock, 64);
+    _thread = std::thread([this]() {
+      int conn = -1;
+      while ((conn = accept(_sock, nullptr, nullptr)) >= 0)
+        {
+          ++_connections;
+          _conns.push_back(conn);
+          _workers.emplace_back([this, conn]() { serve(conn); });
+        }
+    });
+  }
+
+  ~LocalHTTPServer()
+  {
+    shutdown(_sock, SHUT_RDWR);
+    close(_sock);
+    _thread.join();
+    for (int conn : _conns) // kept alive by the client
+      shutdown(conn, SHUT_RDWR);
+    for (auto &w : _workers)
+      w.join();
+  }
+
+  std::string url(const std::string &path) const
+  {
+    return "http://127.0.0.1:" + std::to_string(_port) + path;
+  }
+
+  std::atomic<int> _connections{ 0 };
+  std::atomic<int> _requests{ 0 };
+
+private:
+  void serve(int conn)
+  {
+    std::string in;
+    char buf[4096];
+    ssize_t n = 0;
+    while ((n = recv(conn, buf, sizeof(buf), 0)) > 0)
+      {
+        in.append(buf, n);
+        size_t end = 0;
+        while ((end = in.find("\r\n\r\n")) != std::string::npos)
+          {
+            in.erase(0, end + 4);
+            ++_requests;
+            std::string out = "HTTP/1.1 200 OK\r\nContent-Length: "
+                              + std::to_string(_body.size()) + "\r\n\r\n"
+                              + _body;
+            send(conn, out.data(), out.size(), 0);
+          }
+      }
+    close(conn);
+  }
+
+  std::string _body;
+  int _sock = -1;
+  int _port = 0;
+  std::thread _thread;
+  std::vector<int> _conns;
+  std::vector<std::thread> _workers;
+};
+
+TEST(inputconn, http_fetch)
+{
+  std::vector<unsigned char> png;
+  cv::imencode(".png", cv::Mat(32, 48, CV_8UC3, cv::Scalar(0, 128, 255)),
+               png);
+  LocalHTTPServer server(std::string(png.begin(), png.end()));
+
+  // concurrent fetches share a bounded number of connections
+  std::vector<std::future<http_response>> fetches;
+  for (int i = 0; i < 32; ++i)
+    fetches.push_back(httpfetcher::instance().fetch(
+        server.url("/img" + std::to_string(i) + ".png")));
+  for (auto &f : fetches)
+    {
+      http_response resp = f.get();
+      ASSERT_EQ(200, resp._code);
+      ASSERT_EQ(png.size(), resp._content.size());
+    }
+  ASSERT_EQ(32, server._requests.load());
+  ASSERT_LE(server._connections.load(),
+            static_cast<int>(httpfetcher::_max_host_connections));
+
+  // kept-alive connections are reused
+  int connections = server._connections.load();
+  for (int i = 0; i < 4; ++i)
+    ASSERT_EQ(200, httpfetcher::instance().fetch(server.url("/img.png"))
+                       .get()
+                       ._code);
+  ASSERT_EQ(connections, server._connections.load());
+
+  // image connector over remote images
+  ImgInputFileConn iifc;
+  APIData ad;
+  std::vector<std::string> uris;
+  for (int i = 0; i < 8; ++i)
+    uris.push_back(server.url("/img" + std::to_string(i) + ".png"));
+  ad.add("data", uris);
+  iifc.transform(ad);
+  ASSERT_EQ(8, iifc._images.size());
+  ASSERT_EQ(32, iifc._images_size.at(0).first);
+  ASSERT_EQ(48, iifc._images_size.at(0).second);
+}
+
 TEST(inputconn, img_histogram_bw)
 {
   std::string voc_roi_repo = "../examples/caffe/voc_roi";
@@ -24,7 +24,11 @@
 #include <gtest/gtest.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
 
 using namespace dd;
 
@@ -127,6 +131,20 @@ TEST(jsonapi, service_create)
   jstrt = japi.jrender(jd);
   joutstr = japi.jrender(japi.service_create(sname, jstrt));
   ASSERT_EQ(bad_param_str_false, joutstr);
+
+  // negative predict replicas and queue
+  for (std::string mllib : { "\"replicas\":-1", "\"predict_queue\":-1" })
+    {
+      jstrt = "{\"mllib\":\"caffe\",\"description\":\"my "
+              "classifier\",\"type\":\"supervised\",\"model\":{"
+              "\"repository\":\"here\"},\"parameters\":{\"input\":{"
+              "\"connector\":\"image\"},\"mllib\":{\"nclasses\":2,"
+              + mllib + "}}}";
+      joutstr = japi.jrender(japi.service_create(sname, jstrt));
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(400, jd["status"]["code"]);
+    }
 }
 
 TEST(jsonapi, info)
@@ -201,6 +219,10 @@ TEST(jsonapi, service_status)
   ASSERT_EQ(
       jd["body"]["service_stats"]["total_transform_duration_ms"].GetDouble(),
       0);
+  ASSERT_EQ(jd["body"]["service_stats"]["predict_queue_depth"].GetInt(), 0);
+  ASSERT_EQ(jd["body"]["service_stats"]["predict_queue_max_depth"].GetInt(),
+            0);
+  ASSERT_EQ(jd["body"]["service_stats"]["predict_rejected"].GetInt(), 0);
 
   std::string jpredictstr
       = "{\"service\":\"" + sname
@@ -234,6 +256,35 @@ TEST(jsonapi, service_status)
   ASSERT_GE(
       jd["body"]["service_stats"]["total_transform_duration_ms"].GetDouble(),
       0);
+  ASSERT_TRUE(jd["body"]["service_stats"].HasMember("latency_ms"));
+  ASSERT_EQ(
+      jd["body"]["service_stats"]["latency_ms"]["total"]["count"].GetInt(), 1);
+  ASSERT_GT(
+      jd["body"]["service_stats"]["latency_ms"]["total"]["p99"].GetDouble(),
+      0);
+
+  std::string metrics = japi.service_metrics();
+  ASSERT_TRUE(metrics.find("dd_predict_calls_total{service=\"my_service\","
+                           "status=\"failure\"} 1")
+              != std::string::npos);
+  ASSERT_TRUE(metrics.find("dd_predict_latency_seconds_count{service=\"my_"
+                           "service\",stage=\"total\"} 1")
+              != std::string::npos);
+}
+
+TEST(servicestats, latency_histogram)
+{
+  LatencyHistogram hist;
+  ASSERT_EQ(0, hist.count());
+  ASSERT_EQ(0.0, hist.quantile_ms(0.99));
+  for (int i = 1; i <= 1000; ++i)
+    hist.record(std::chrono::microseconds(i * 100));
+  ASSERT_EQ(1000, hist.count());
+  // buckets have ~6% relative precision
+  ASSERT_NEAR(50.0, hist.quantile_ms(0.5), 50.0 * 0.07);
+  ASSERT_NEAR(99.0, hist.quantile_ms(0.99), 99.0 * 0.07);
+  ASSERT_GE(hist.quantile_ms(0.999), 99.9);
+  ASSERT_LE(hist.quantile_ms(0.999), 100.0 * 1.07);
 }
 
 TEST(jsonapi, service_purge)
@@ -262,3 +313,127 @@ TEST(jsonapi, service_purge)
   bool exists = fileops::file_exists("here", isdir);
   ASSERT_EQ(exists, false);
 }
+
+TEST(jsonapi, binary_frames)
+{
+  std::string bin("\x89PNG\0\r\n", 7);
+  std::vector<std::string> frames
+      = { "{\"service\":\"my_service\"}", bin, "", std::string(300, 'x') };
+  std::string body = JsonAPI::write_frames(frames);
+  ASSERT_EQ(4 * 4 + frames[0].size() + 7 + 300, body.size());
+  ASSERT_EQ(static_cast<char>(44), body[4 + frames[0].size() + 4 + 7 + 4]);
+  ASSERT_EQ(static_cast<char>(1), body[4 + frames[0].size() + 4 + 7 + 5]);
+
+  std::vector<std::string> rframes;
+  ASSERT_TRUE(JsonAPI::read_frames(body, rframes));
+  ASSERT_EQ(frames, rframes);
+
+  // truncated length and payload
+  rframes.clear();
+  ASSERT_FALSE(JsonAPI::read_frames(body.substr(0, 2), rframes));
+  rframes.clear();
+  ASSERT_FALSE(JsonAPI::read_frames(body.substr(0, body.size() - 1), rframes));
+}
+
+TEST(jsonapi, service_predict_binary_frames)
+{
+  // create and train service
+  JsonAPI japi;
+  std::string sname = "my_service";
+  std::string mnist_repo = "../examples/caffe/mnist/";
+  std::string jstr
+      = "{\"mllib\":\"caffe\",\"description\":\"my "
+        "extractor\",\"type\":\"unsupervised\",\"model\":{\"repository\":\""
+        + mnist_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\"},\"mllib\":{"
+          "\"nclasses\":10}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+  std::string jtrainstr
+      = "{\"service\":\"" + sname
+        + "\",\"async\":false,\"parameters\":{\"mllib\":{\"gpu\":true,"
+          "\"solver\":{\"iterations\":10,\"snapshot_prefix\":\""
+        + mnist_repo + "/mylenet\"}}}}";
+  joutstr = japi.jrender(japi.service_train(jtrainstr));
+  JDoc jd;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(201, jd["status"]["code"].GetInt());
+
+  // reference vals from a JSON predict on the image files
+  std::string params
+      = "\"parameters\":{\"input\":{\"bw\":true,\"width\":28,\"height\":"
+        "28},\"mllib\":{\"extract_layer\":\"ip2\"}}";
+  std::vector<std::string> files
+      = { mnist_repo + "sample_digit.png", mnist_repo + "sample_digit2.png" };
+  std::string jpredictstr = "{\"service\":\"" + sname + "\"," + params
+                            + ",\"data\":[\"" + files[0] + "\",\"" + files[1]
+                            + "\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  std::map<std::string, std::vector<double>> ref_vals;
+  for (rapidjson::SizeType p = 0; p < jd["body"]["predictions"].Size(); ++p)
+    {
+      const JVal &pred = jd["body"]["predictions"][p];
+      std::vector<double> vals;
+      for (rapidjson::SizeType i = 0; i < pred["vals"].Size(); ++i)
+        vals.push_back(pred["vals"][i].GetDouble());
+      ref_vals[pred["uri"].GetString()] = vals;
+    }
+  ASSERT_EQ(2, ref_vals.size());
+
+  // same images sent as binary frames, frame 0 being the call
+  std::vector<std::string> data_frames;
+  for (const std::string &f : files)
+    {
+      std::ifstream ifs(f, std::ios::binary);
+      std::stringstream sstr;
+      sstr << ifs.rdbuf();
+      data_frames.push_back(sstr.str());
+    }
+  std::vector<std::string> out_frames;
+  jpredictstr = "{\"service\":\"" + sname + "\"," + params + "}";
+  JDoc janswer = japi.service_predict(jpredictstr, nullptr, &data_frames,
+                                      &out_frames);
+  joutstr = japi.jrender(janswer);
+  std::cout << "joutstr frames=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_EQ(2, jd["body"]["predictions"].Size());
+  ASSERT_EQ(2, out_frames.size());
+  for (rapidjson::SizeType p = 0; p < jd["body"]["predictions"].Size(); ++p)
+    {
+      const JVal &pred = jd["body"]["predictions"][p];
+      // frames are named after their index in the request body
+      std::string uri = pred["uri"].GetString();
+      ASSERT_TRUE(uri == "frame_1" || uri == "frame_2");
+      const std::vector<double> &vals
+          = ref_vals[files[uri == "frame_1" ? 0 : 1]];
+      ASSERT_FALSE(pred.HasMember("vals"));
+      int f = pred["vals_frame"].GetInt();
+      ASSERT_TRUE(f == 1 || f == 2);
+
+      // little-endian float32 vals
+      const std::string &frame = out_frames[f - 1];
+      ASSERT_EQ(vals.size() * sizeof(float), frame.size());
+      for (size_t i = 0; i < vals.size(); ++i)
+        {
+          uint32_t bits = 0;
+          for (int b = 0; b < 4; ++b)
+            bits |= static_cast<uint32_t>(
+                        static_cast<unsigned char>(frame[4 * i + b]))
+                    << (8 * b);
+          float val = 0.0;
+          std::memcpy(&val, &bits, sizeof(float));
+          ASSERT_NEAR(vals[i], val, 1e-5);
+        }
+    }
+
+  // remove service and trained model files
+  jstr = "{\"clear\":\"lib\"}";
+  joutstr = japi.jrender(japi.service_delete(sname, jstr));
+  ASSERT_EQ(ok_str, joutstr);
+}
@@ -24,6 +24,7 @@
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <iostream>
+#include <map>
 
 using namespace dd;
 
@@ -177,6 +178,70 @@ TEST(ncnnapi, service_predict_classification)
   ASSERT_TRUE(jd["body"]["predictions"][0]["classes"].Size() == 1000);
 }
 
+TEST(ncnnapi, service_predict_classification_batch)
+{
+  // create service, samples of a call are spread over inference workers
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"ncnn\",\"description\":\"squeezenet\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + squeezenet_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"mean\":[128,128,128]},"
+          "\"mllib\":{\"nclasses\":1000,\"threads\":4}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  std::vector<std::string> files
+      = { squeezenet_ssd_repo + "face.jpg", ocr_repo + "word_ocr.jpg",
+          "../examples/caffe/mnist/sample_digit.png",
+          "../examples/caffe/voc_roi/000010_bw.jpg",
+          "../examples/caffe/mnist/sample_digit2.png" };
+  std::string jpredict
+      = "{\"service\":\"imgserv\",\"parameters\":{\"input\":{\"height\":224,"
+        "\"width\":224},\"output\":{\"best\":1}},\"data\":[\"";
+  JDoc jd;
+
+  // one sample per call
+  std::map<std::string, std::pair<std::string, double>> single;
+  for (const std::string &f : files)
+    {
+      joutstr
+          = japi.jrender(japi.service_predict(jpredict + f + "\"]}"));
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_EQ(1, jd["body"]["predictions"].Size());
+      single[f] = std::make_pair(
+          jd["body"]["predictions"][0]["classes"][0]["cat"].GetString(),
+          jd["body"]["predictions"][0]["classes"][0]["prob"].GetDouble());
+    }
+
+  // all samples in one call, each output must stay with its own input
+  std::string jpredictstr = jpredict;
+  for (size_t i = 0; i < files.size(); ++i)
+    jpredictstr += (i == 0 ? "" : "\",\"") + files[i];
+  jpredictstr += "\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_EQ(files.size(), jd["body"]["predictions"].Size());
+  for (rapidjson::SizeType i = 0; i < jd["body"]["predictions"].Size(); ++i)
+    {
+      const JVal &pred = jd["body"]["predictions"][i];
+      auto sit = single.find(pred["uri"].GetString());
+      ASSERT_TRUE(sit != single.end());
+      ASSERT_EQ((*sit).second.first, pred["classes"][0]["cat"].GetString());
+      ASSERT_NEAR((*sit).second.second,
+                  pred["classes"][0]["prob"].GetDouble(), 1e-4);
+      single.erase(sit);
+    }
+  ASSERT_TRUE(single.empty());
+}
+
 #ifdef USE_CAFFE
 TEST(ncnnapi, service_lstm)
 {
@@ -19,7 +19,9 @@
  * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <gtest/gtest.h>
 
 #include "oatpp-test/UnitTest.hpp"
@@ -562,11 +564,111 @@ void test_predict(std::shared_ptr<DedeApiTestClient> client)
   std::cout << "jstr=" << message.get()->std_str() << std::endl;
   ASSERT_EQ(response->getStatusCode(), 200);
 
+  // predict stream, one response frame per data element
+  std::vector<std::string> digits;
+  for (std::string digit : { "sample_digit.png", "sample_digit2.png" })
+    {
+      std::ifstream ifs(mnist_repo + digit, std::ios::binary);
+      std::stringstream sstr;
+      sstr << ifs.rdbuf();
+      digits.push_back(sstr.str());
+    }
+  std::string stream_call
+      = "{\"service\":\"" + serv
+        + "\",\"parameters\":{\"mllib\":{\"gpu\":true},\"input\":{\"bw\":true,"
+          "\"width\":28,\"height\":28},\"output\":{\"best\":1}}}";
+  std::string body = dd::JsonAPI::write_frames(
+      { stream_call, digits[0], digits[1], digits[0], digits[1] });
+  response = client->post_predict_stream(
+      1, oatpp::String(body.data(), body.size(), true));
+  ASSERT_EQ(response->getStatusCode(), 200);
+  message = response->readBodyToString();
+  ASSERT_TRUE(message != nullptr);
+  std::vector<std::string> out_frames;
+  ASSERT_TRUE(dd::JsonAPI::read_frames(message.get()->std_str(), out_frames));
+  ASSERT_EQ(4, out_frames.size());
+  std::vector<std::string> cats;
+  for (size_t f = 0; f < out_frames.size(); ++f)
+    {
+      std::cout << "frame=" << out_frames[f] << std::endl;
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(out_frames[f].c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_EQ(1, jd["body"]["predictions"].Size());
+      ASSERT_EQ("frame_" + std::to_string(f + 1),
+                jd["body"]["predictions"][0]["uri"].GetString());
+      cats.push_back(
+          jd["body"]["predictions"][0]["classes"][0]["cat"].GetString());
+    }
+  ASSERT_EQ(cats[0], cats[2]);
+  ASSERT_EQ(cats[1], cats[3]);
+
+  // predict stream with a truncated last frame
+  body = dd::JsonAPI::write_frames({ stream_call, digits[0], digits[1] });
+  body.pop_back();
+  response = client->post_predict_stream(
+      1, oatpp::String(body.data(), body.size(), true));
+  ASSERT_EQ(response->getStatusCode(), 200);
+  message = response->readBodyToString();
+  ASSERT_TRUE(message != nullptr);
+  out_frames.clear();
+  ASSERT_TRUE(dd::JsonAPI::read_frames(message.get()->std_str(), out_frames));
+  ASSERT_EQ(2, out_frames.size());
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(out_frames[0].c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_EQ("frame_1", jd["body"]["predictions"][0]["uri"]);
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(out_frames[1].c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(400, jd["status"]["code"]);
+  ASSERT_EQ(std::string("malformed binary frames"),
+            jd["status"]["dd_msg"].GetString());
+
   // remove services and trained model files
   response = client->delete_services(serv.c_str(), "lib");
   ASSERT_EQ(response->getStatusCode(), 200);
 }
 
+TEST(oatpp_predict_stream, frame_sink)
+{
+  std::vector<std::string> frames;
+  dd::http::FrameSink sink([&frames](std::string &&frame) {
+    frames.push_back(std::move(frame));
+    return true;
+  });
+  std::string body = dd::JsonAPI::write_frames(
+      { "{\"service\":\"s\"}", "", std::string(300, 'x'), "abc" });
+
+  // frames arriving together
+  ASSERT_TRUE(sink.append(body.data(), body.size()));
+  ASSERT_EQ(4, frames.size());
+  ASSERT_EQ("{\"service\":\"s\"}", frames[0]);
+  ASSERT_TRUE(frames[1].empty());
+  ASSERT_EQ(std::string(300, 'x'), frames[2]);
+  ASSERT_EQ("abc", frames[3]);
+  ASSERT_FALSE(sink.truncated());
+
+  // frames and lengths split across reads
+  frames.clear();
+  for (size_t i = 0; i < body.size(); i += 3)
+    ASSERT_TRUE(
+        sink.append(body.data() + i, std::min<size_t>(3, body.size() - i)));
+  ASSERT_EQ(4, frames.size());
+  ASSERT_EQ(std::string(300, 'x'), frames[2]);
+  ASSERT_EQ("abc", frames[3]);
+  ASSERT_FALSE(sink.truncated());
+
+  // truncated trailing frame
+  frames.clear();
+  ASSERT_TRUE(sink.append(body.data(), body.size() - 1));
+  ASSERT_EQ(3, frames.size());
+  ASSERT_TRUE(sink.truncated());
+
+  // refused frames stop the transfer
+  dd::http::FrameSink closed_sink([](std::string &&) { return false; });
+  ASSERT_FALSE(closed_sink.append(body.data(), body.size()));
+}
+
 #define OATPP_DEDE_TEST(FUNC)                                                 \
   TEST(oatpp_jsonapi, FUNC)                                                   \
   {                                                                           \
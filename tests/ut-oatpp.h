@@ -116,6 +116,9 @@ class DedeApiTestClient : public oatpp::web::client::ApiClient
            QUERY(Int16, job))
   API_CALL("POST", "/predict", post_predict,
            BODY_STRING(oatpp::String, predict_data))
+  API_CALL("POST", "/predict/stream", post_predict_stream,
+           QUERY(Int32, max_batch_size),
+           BODY_STRING(oatpp::String, predict_frames))
 };
 
 typedef std::function<void(std::shared_ptr<DedeApiTestClient>)>
@@ -21,6 +21,7 @@
 
 #include "simsearch.h"
 #include "jsonapi.h"
+#include "utils/fileops.hpp"
 #include <gtest/gtest.h>
 #include <iostream>
 
@@ -38,6 +39,61 @@ static std::string mnist_repo = "../examples/caffe/mnist/";
 static std::string iterations_mnist = "2";
 static std::string voc_repo = "../examples/caffe/voc_roi/voc_roi/";
 
+TEST(simsearch, uri_store)
+{
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  URIStore store;
+  store.open(model_repo + "/names");
+  store.put(0, URIData("test0"));
+  store.put(2, URIData("test2", { 1.0, 2.0, 3.0, 4.0 }, 0.5, "cat"));
+  URIData uri;
+  ASSERT_FALSE(store.get(0, uri)); // not committed yet
+  store.commit();
+  ASSERT_TRUE(store.get(0, uri));
+  ASSERT_EQ("test0", uri._uri);
+  ASSERT_TRUE(uri._bbox.empty());
+  ASSERT_TRUE(store.get(1, uri)); // gap
+  ASSERT_EQ("", uri._uri);
+  ASSERT_TRUE(store.get(2, uri));
+  ASSERT_EQ("test2", uri._uri);
+  ASSERT_EQ(4, uri._bbox.size());
+  ASSERT_EQ(4.0, uri._bbox.at(3));
+  ASSERT_EQ(0.5, uri._prob);
+  ASSERT_EQ("cat", uri._cat);
+  ASSERT_FALSE(store.get(3, uri));
+  ASSERT_THROW(store.put(1, URIData("test1")), SimIndexException);
+
+  // reopened
+  store.close();
+  URIStore store2;
+  store2.open(model_repo + "/names");
+  ASSERT_EQ(3, store2._size);
+  ASSERT_TRUE(store2.get(2, uri));
+  ASSERT_EQ("test2", uri._uri);
+
+  // truncated to the ids of a saved index, dropped ids can be put again
+  std::vector<long int> ids;
+  store2.remove_uri("test2", ids);
+  store2.truncate(1);
+  ASSERT_EQ(1, store2._size);
+  ASSERT_FALSE(store2.get(1, uri));
+  store2.put(1, URIData("test1"));
+  store2.put(2, URIData("test2"));
+  store2.commit();
+  ASSERT_TRUE(store2.get(2, uri));
+  ASSERT_EQ("test2", uri._uri);
+  ASSERT_TRUE(store2.removed_ids()->empty());
+  store2.close();
+  store2.open(model_repo + "/names");
+  ASSERT_EQ(3, store2._size);
+  ASSERT_TRUE(store2.removed_ids()->empty());
+  ASSERT_TRUE(store2.get(1, uri));
+  ASSERT_EQ("test1", uri._uri);
+  store2.remove();
+  rmdir(model_repo.c_str());
+}
+
 TEST(faissse, index_search)
 {
   std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
@@ -100,6 +156,190 @@ TEST(faissse, index_search_incr)
   rmdir(model_repo.c_str());
 }
 
+TEST(faissse, index_search_batch)
+{
+  std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
+  std::vector<double> vec2 = { 0.0, 1.0, 0.0, 0.0 };
+  std::vector<double> vec3 = { 1.0, 0.0, 1.0, 0.0 };
+
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  FaissSE fse(t, model_repo);
+  fse.create_index();
+  fse.index(URIData("test1"), vec1);
+  fse.index(URIData("test2"), vec2);
+  fse.index(URIData("test3"), vec3);
+  fse.update_index();
+
+  // two queries in a single call
+  std::vector<float> queries(vec1.begin(), vec1.end());
+  queries.insert(queries.end(), vec2.begin(), vec2.end());
+  std::vector<std::vector<URIData>> uris;
+  std::vector<std::vector<double>> distances;
+  fse.search(queries, 3, uris, distances);
+  ASSERT_EQ(2, uris.size());
+  ASSERT_EQ(2, distances.size());
+  ASSERT_EQ(3, uris.at(0).size());
+  ASSERT_EQ("test1", uris.at(0).at(0)._uri);
+  ASSERT_EQ(0.0, distances.at(0).at(0));
+  ASSERT_EQ("test2", uris.at(1).at(0)._uri);
+  ASSERT_EQ(0.0, distances.at(1).at(0));
+
+  // batch results match single queries
+  std::vector<URIData> suris;
+  std::vector<double> sdistances;
+  fse.search(vec2, 3, suris, sdistances);
+  ASSERT_EQ(suris.size(), uris.at(1).size());
+  for (size_t i = 0; i < suris.size(); i++)
+    {
+      ASSERT_EQ(suris.at(i)._uri, uris.at(1).at(i)._uri);
+      ASSERT_EQ(sdistances.at(i), distances.at(1).at(i));
+    }
+  fse.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(faissse, index_search_shards)
+{
+  std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
+  std::vector<double> vec2 = { 0.0, 1.0, 0.0, 0.0 };
+  std::vector<double> vec3 = { 1.0, 0.0, 1.0, 0.0 };
+  std::vector<double> vec4 = { 0.0, 0.0, 5.0, 5.0 };
+
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  FaissSE fse(t, model_repo);
+  fse._nshards = 2;
+  fse._count_put_max = 2; // publishes a delta segment every two vectors
+  fse._merge_size = 4;
+  fse.create_index();
+  fse.index(URIData("test1"), vec1);
+  fse.index(URIData("test2"), vec2);
+  fse.index(URIData("test3"), vec3);
+
+  // searchable from the delta before any merge
+  std::vector<URIData> uris;
+  std::vector<double> distances;
+  fse.search(vec2, 3, uris, distances);
+  ASSERT_EQ(2, uris.size());
+  ASSERT_EQ("test2", uris.at(0)._uri);
+  ASSERT_EQ(0, fse._findex->ntotal);
+
+  // merged into the shards
+  fse.index(URIData("test4"), vec4);
+  ASSERT_EQ(4, fse._findex->ntotal);
+  uris.clear();
+  distances.clear();
+  fse.search(vec4, 3, uris, distances);
+  ASSERT_EQ(3, uris.size());
+  ASSERT_EQ("test4", uris.at(0)._uri);
+  ASSERT_EQ(0.0, distances.at(0));
+
+  // removed, then compacted away shard by shard
+  fse.remove({ "test3" });
+  fse.update_index();
+  fse._compact_thread.join();
+  ASSERT_EQ(3, fse._findex->ntotal);
+  uris.clear();
+  distances.clear();
+  fse.search(vec3, 4, uris, distances);
+  ASSERT_EQ(3, uris.size());
+  for (const URIData &uri : uris)
+    ASSERT_NE("test3", uri._uri);
+
+  // saved as one file per shard
+  fse.update_index();
+  ASSERT_TRUE(fileops::file_exists(model_repo + "/index_0.faiss"));
+  ASSERT_TRUE(fileops::file_exists(model_repo + "/index_1.faiss"));
+  fse.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(faissse, search_untrained)
+{
+  std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
+  std::vector<double> vec2 = { 0.0, 1.0, 0.0, 0.0 };
+  std::vector<double> vec3 = { 1.0, 0.0, 1.0, 0.0 };
+
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  FaissSE fse(t, model_repo);
+  fse._index_key = "IVF2,Flat";
+  fse._ondisk = false;
+  fse._count_put_max = 1;
+  fse.create_index();
+  fse.index(URIData("test1"), vec1);
+  fse.index(URIData("test2"), vec2);
+  fse.index(URIData("test3"), vec3);
+
+  // training samples are scanned, searches do not train the index
+  std::vector<URIData> uris;
+  std::vector<double> distances;
+  fse.search(vec2, 2, uris, distances);
+  ASSERT_FALSE(fse.trained());
+  ASSERT_EQ(2, uris.size());
+  ASSERT_EQ("test2", uris.at(0)._uri);
+  ASSERT_EQ(0.0, distances.at(0));
+  fse.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(faissse, index_remove_filter)
+{
+  std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
+  std::vector<double> vec2 = { 0.9, 0.1, 0.0, 0.0 };
+  std::vector<double> vec3 = { 0.0, 1.0, 0.0, 0.0 };
+
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  FaissSE fse(t, model_repo);
+  fse.create_index();
+  fse.index(URIData("test1", { 0, 0, 1, 1 }, 0.9, "dog"), vec1);
+  fse.index(URIData("test2", { 0, 0, 1, 1 }, 0.9, "cat"), vec2);
+  fse.index(URIData("test3", { 0, 0, 1, 1 }, 0.9, "cat"), vec3);
+  fse.update_index();
+
+  // filtered by category
+  std::vector<float> query(vec1.begin(), vec1.end());
+  std::vector<std::vector<URIData>> uris;
+  std::vector<std::vector<double>> distances;
+  URIFilter filter;
+  filter._cats.insert("cat");
+  fse.search(query, 1, uris, distances, filter);
+  ASSERT_EQ(1, uris.at(0).size());
+  ASSERT_EQ("test2", uris.at(0).at(0)._uri);
+
+  // removed, then compacted away
+  fse.remove({ "test2" });
+  fse.search(query, 1, uris, distances, filter);
+  ASSERT_EQ(1, uris.at(0).size());
+  ASSERT_EQ("test3", uris.at(0).at(0)._uri);
+  fse.update_index();
+  fse._compact_thread.join();
+  ASSERT_EQ(2, fse._findex->ntotal);
+  fse.search(query, 3, uris, distances);
+  ASSERT_EQ(2, uris.at(0).size());
+  ASSERT_EQ("test1", uris.at(0).at(0)._uri);
+  ASSERT_EQ("test3", uris.at(0).at(1)._uri);
+
+  // updated
+  fse.remove({ "test1" });
+  fse.index(URIData("test1", { 0, 0, 1, 1 }, 0.9, "dog"), vec3);
+  fse.update_index();
+  std::vector<URIData> suris;
+  std::vector<double> sdistances;
+  fse.search(vec3, 3, suris, sdistances);
+  ASSERT_EQ(2, suris.size());
+  ASSERT_EQ(0.0, sdistances.at(0));
+  ASSERT_EQ(0.0, sdistances.at(1));
+  fse.remove_index();
+  rmdir(model_repo.c_str());
+}
+
 TEST(simsearch, predict_simsearch_unsup)
 {
   // create service
@@ -25,7 +25,9 @@
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <iostream>
+#include <thread>
 #include "backends/torch/native/templates/nbeats.h"
+#include "backends/torch/torchutils.h"
 #include <torch/torch.h>
 
 using namespace dd;
@@ -113,6 +115,359 @@ TEST(torchapi, service_predict)
               > 0.3);
 }
 
+TEST(torchapi, service_predict_best_and_extract)
+{
+  // create service
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+  std::string data = "\"data\":[\"" + incept_repo + "cat.jpg\",\""
+                     + resnet50_test_image + "\"]}";
+
+  // best classes, sorted, from every row of the batch
+  std::string jpredictstr
+      = "{\"service\":\"imgserv\",\"parameters\":{\"output\":{\"best\":3}},"
+        + data;
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  JDoc jd;
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_EQ(2, jd["body"]["predictions"].Size());
+  for (size_t i = 0; i < 2; ++i)
+    {
+      auto &classes = jd["body"]["predictions"][i]["classes"];
+      ASSERT_EQ(3, classes.Size());
+      ASSERT_TRUE(classes[0]["prob"].GetDouble()
+                  >= classes[1]["prob"].GetDouble());
+      ASSERT_TRUE(classes[1]["prob"].GetDouble()
+                  >= classes[2]["prob"].GetDouble());
+    }
+
+  // best is clamped to the number of classes
+  jpredictstr = "{\"service\":\"imgserv\",\"parameters\":{\"output\":{"
+                "\"best\":5000}},"
+                + data;
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_EQ(2, jd["body"]["predictions"].Size());
+  ASSERT_EQ(1000, jd["body"]["predictions"][0]["classes"].Size());
+  ASSERT_EQ(1000, jd["body"]["predictions"][1]["classes"].Size());
+
+  // extracted output is sliced into one row per sample
+  jpredictstr = "{\"service\":\"imgserv\",\"parameters\":{\"mllib\":{"
+                "\"extract_layer\":\"last\"}},"
+                + data;
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_EQ(2, jd["body"]["predictions"].Size());
+  auto &vals0 = jd["body"]["predictions"][0]["vals"];
+  auto &vals1 = jd["body"]["predictions"][1]["vals"];
+  ASSERT_EQ(1000, vals0.Size());
+  ASSERT_EQ(1000, vals1.Size());
+  bool same = true;
+  for (rapidjson::SizeType j = 0; j < vals0.Size() && same; ++j)
+    same = vals0[j].GetDouble() == vals1[j].GetDouble();
+  ASSERT_FALSE(same);
+}
+
+TEST(torchapi, service_predict_inference_only)
+{
+  // create service, frozen and warmed up
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+          "\"inference_only\":true,\"warmup\":{\"data\":[\""
+        + incept_repo + "cat.jpg\"],\"batch_size\":[1,2]}}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // predict
+  std::string jpredictstr
+      = "{\"service\":\"imgserv\",\"parameters\":{\"input\":{\"height\":224,"
+        "\"width\":224},\"output\":{\"best\":1}},\"data\":[\""
+        + incept_repo + "cat.jpg\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  JDoc jd;
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  std::string cl1
+      = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
+  ASSERT_TRUE(cl1 == "n02123045 tabby, tabby cat");
+  ASSERT_TRUE(jd["body"]["predictions"][0]["classes"][0]["prob"].GetDouble()
+              > 0.3);
+
+  // training is refused
+  std::string jtrainstr
+      = "{\"service\":\"imgserv\",\"async\":false,\"parameters\":{"
+        "\"mllib\":{\"solver\":{\"iterations\":1}}},\"data\":[\""
+        + incept_repo + "\"]}";
+  joutstr = japi.jrender(japi.service_train(jtrainstr));
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(400, jd["status"]["code"]);
+}
+
+TEST(torchapi, service_predict_quantized_static)
+{
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039}}}";
+  std::string jstr_quantized
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+          "\"quantize\":\"static\",\"calibration\":{\"data\":[\""
+        + incept_repo + "cat.jpg\",\"" + resnet50_test_image
+        + "\"],\"batch_size\":2}}}}";
+  std::string jpredictstr
+      = "{\"service\":\"imgserv\",\"parameters\":{\"output\":{\"best\":"
+        "1000}},\"data\":[\""
+        + incept_repo + "cat.jpg\"]}";
+  std::string jdelstr = "{\"clear\":\"mem\"}";
+
+  // calibrated model is saved next to the traced one
+  auto quantized_files = [&]() {
+    std::unordered_set<std::string> lfiles, qfiles;
+    fileops::list_directory(incept_repo, true, false, false, lfiles);
+    for (const std::string &f : lfiles)
+      if (f.size() > 4 && f.compare(f.size() - 4, 4, ".qpt") == 0)
+        qfiles.insert(f);
+    return qfiles;
+  };
+  for (const std::string &f : quantized_files())
+    remove(f.c_str());
+
+  // fp32 reference
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  JDoc jd;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  rapidjson::SizeType nclasses
+      = jd["body"]["predictions"][0]["classes"].Size();
+  std::string cl1
+      = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
+  ASSERT_EQ(1000, nclasses);
+  joutstr = japi.jrender(japi.service_delete(sname, jdelstr));
+  ASSERT_EQ(ok_str, joutstr);
+
+  // calibrated, then converted and saved, then reloaded without
+  // calibration
+  for (int i = 0; i < 2; ++i)
+    {
+      std::string jcreatestr = jstr_quantized;
+      if (i > 0)
+        jcreatestr = "{\"mllib\":\"torch\",\"description\":\"resnet-50\","
+                     "\"type\":\"supervised\",\"model\":{\"repository\":\""
+                     + incept_repo
+                     + "\"},\"parameters\":{\"input\":{\"connector\":"
+                       "\"image\",\"height\":224,\"width\":224,\"rgb\":true,"
+                       "\"scale\":0.0039},\"mllib\":{\"quantize\":"
+                       "\"static\"}}}";
+      joutstr = japi.jrender(japi.service_create(sname, jcreatestr));
+      ASSERT_EQ(created_str, joutstr);
+      ASSERT_EQ(1, quantized_files().size());
+      joutstr = japi.jrender(japi.service_predict(jpredictstr));
+      std::cout << "joutstr=" << joutstr << std::endl;
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      auto &classes = jd["body"]["predictions"][0]["classes"];
+      ASSERT_EQ(nclasses, classes.Size());
+      bool found = false;
+      for (rapidjson::SizeType c = 0; c < 5 && !found; ++c)
+        found = cl1 == classes[c]["cat"].GetString();
+      ASSERT_TRUE(found);
+      joutstr = japi.jrender(japi.service_delete(sname, jdelstr));
+      ASSERT_EQ(ok_str, joutstr);
+    }
+  for (const std::string &f : quantized_files())
+    remove(f.c_str());
+}
+
+TEST(torchapi, service_predict_batching)
+{
+  // create service
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+          "\"batching\":{\"max_batch_size\":4,\"max_wait_us\":100000}}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // concurrent predict calls, merged into batches server-side
+  std::string jpredictstr
+      = "{\"service\":\"imgserv\",\"parameters\":{\"input\":{\"height\":224,"
+        "\"width\":224},\"output\":{\"best\":1}},\"data\":[\""
+        + incept_repo + "cat.jpg\"]}";
+  std::vector<std::string> joutstrs(8);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < joutstrs.size(); ++t)
+    threads.push_back(std::thread([&japi, &jpredictstr, &joutstrs, t]() {
+      joutstrs.at(t) = japi.jrender(japi.service_predict(jpredictstr));
+    }));
+  for (auto &th : threads)
+    th.join();
+
+  for (auto &jout : joutstrs)
+    {
+      JDoc jd;
+      std::cout << "joutstr=" << jout << std::endl;
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(jout.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_TRUE(jd["body"]["predictions"].IsArray());
+      ASSERT_EQ(1, jd["body"]["predictions"].Size());
+      ASSERT_EQ(incept_repo + "cat.jpg",
+                jd["body"]["predictions"][0]["uri"].GetString());
+      std::string cl1
+          = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
+      ASSERT_TRUE(cl1 == "n02123045 tabby, tabby cat");
+    }
+}
+
+TEST(torchapi, service_predict_batching_dir)
+{
+  // create service
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+          "\"batching\":{\"max_batch_size\":4,\"max_wait_us\":100000}}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // a directory is run on its own, with one prediction per file
+  std::unordered_set<std::string> lfiles;
+  fileops::list_directory(resnet50_test_cats_data, true, false, false,
+                          lfiles);
+  std::string jpredictstr
+      = "{\"service\":\"imgserv\",\"parameters\":{\"input\":{\"height\":224,"
+        "\"width\":224},\"output\":{\"best\":1}},\"data\":[\""
+        + resnet50_test_cats_data + "\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  JDoc jd;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_EQ(lfiles.size(), jd["body"]["predictions"].Size());
+
+  // later single calls still get merged into batches
+  jpredictstr
+      = "{\"service\":\"imgserv\",\"parameters\":{\"input\":{\"height\":224,"
+        "\"width\":224},\"output\":{\"best\":1}},\"data\":[\""
+        + incept_repo + "cat.jpg\"]}";
+  std::vector<std::string> joutstrs(8);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < joutstrs.size(); ++t)
+    threads.push_back(std::thread([&japi, &jpredictstr, &joutstrs, t]() {
+      joutstrs.at(t) = japi.jrender(japi.service_predict(jpredictstr));
+    }));
+  for (auto &th : threads)
+    th.join();
+  for (auto &jout : joutstrs)
+    {
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(jout.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_EQ(1, jd["body"]["predictions"].Size());
+      ASSERT_EQ(incept_repo + "cat.jpg",
+                jd["body"]["predictions"][0]["uri"].GetString());
+    }
+
+  joutstr = japi.jrender(japi.service_status(sname));
+  jd.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_LT(jd["body"]["service_stats"]["predict_count"].GetInt(),
+            1 + static_cast<int>(joutstrs.size()));
+}
+
+TEST(torchapi, service_predict_batching_txt)
+{
+  // create service
+  JsonAPI japi;
+  std::string sname = "txtserv";
+  std::string jstr = "{\"mllib\":\"torch\",\"description\":\"bert\",\"type\":"
+                     "\"supervised\",\"model\":{\"repository\":\""
+                     + bert_classif_repo
+                     + "\"},\"parameters\":{\"input\":{\"connector\":\"txt\","
+                       "\"ordered_words\":true,"
+                       "\"wordpiece_tokens\":true,\"punctuation_tokens\":true,"
+                       "\"sequence\":512},\"mllib\":{\"batching\":{"
+                       "\"max_batch_size\":4,\"max_wait_us\":100000}}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // the txt connector does not report ids back, every call must still get
+  // its prediction
+  std::string jpredictstr
+      = "{\"service\":\"txtserv\",\"parameters\":{\"output\":{\"best\":1}},"
+        "\"data\":["
+        "\"Get the official USA poly ringtone or colour flag on your mobile "
+        "for tonights game! Text TONE or FLAG to 84199. Optout txt ENG STOP "
+        "Box39822 W111WX £1.50\"]}";
+  std::vector<std::string> joutstrs(4);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < joutstrs.size(); ++t)
+    threads.push_back(std::thread([&japi, &jpredictstr, &joutstrs, t]() {
+      joutstrs.at(t) = japi.jrender(japi.service_predict(jpredictstr));
+    }));
+  for (auto &th : threads)
+    th.join();
+
+  for (auto &jout : joutstrs)
+    {
+      JDoc jd;
+      std::cout << "joutstr=" << jout << std::endl;
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(jout.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_TRUE(jd["body"]["predictions"].IsArray());
+      ASSERT_EQ(1, jd["body"]["predictions"].Size());
+      std::string cl1
+          = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
+      ASSERT_TRUE(cl1 == "spam");
+    }
+}
+
 TEST(torchapi, service_predict_txt_classification)
 {
   // create service
@@ -149,6 +504,42 @@ TEST(torchapi, service_predict_txt_classification)
               > 0.7);
 }
 
+TEST(torchapi, service_predict_txt_classification_quantized)
+{
+  // create service, with int8 linear layers
+  JsonAPI japi;
+  std::string sname = "txtserv";
+  std::string jstr = "{\"mllib\":\"torch\",\"description\":\"bert\",\"type\":"
+                     "\"supervised\",\"model\":{\"repository\":\""
+                     + bert_classif_repo
+                     + "\"},\"parameters\":{\"input\":{\"connector\":\"txt\","
+                       "\"ordered_words\":true,"
+                       "\"wordpiece_tokens\":true,\"punctuation_tokens\":true,"
+                       "\"sequence\":512},\"mllib\":{\"quantize\":"
+                       "\"dynamic\"}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // predict
+  std::string jpredictstr
+      = "{\"service\":\"txtserv\",\"parameters\":{\"output\":{\"best\":1}},"
+        "\"data\":["
+        "\"Get the official USA poly ringtone or colour flag on your mobile "
+        "for tonights game! Text TONE or FLAG to 84199. Optout txt ENG STOP "
+        "Box39822 W111WX £1.50\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  JDoc jd;
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  std::string cl1
+      = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
+  ASSERT_TRUE(cl1 == "spam");
+  ASSERT_TRUE(jd["body"]["predictions"][0]["classes"][0]["prob"].GetDouble()
+              > 0.7);
+}
+
 TEST(inputconn, txt_tokenize_ordered_words)
 {
   std::string str = "everything runs fine, right?";
@@ -173,6 +564,34 @@ TEST(inputconn, txt_tokenize_ordered_words)
   ASSERT_EQ(tokens, towe._v);
 }
 
+TEST(torchapi, tensor_record)
+{
+  std::vector<torch::Tensor> tensors{
+    torch::rand({ 3, 5 }), torch::arange(7, torch::kLong),
+    torch::randint(255, { 2, 3, 3 }, torch::kUInt8), torch::tensor(1.5)
+  };
+  std::string record;
+  torch_utils::write_tensor_record(tensors, record);
+  ASSERT_TRUE(torch_utils::is_tensor_record(record));
+
+  std::vector<torch::Tensor> rtensors
+      = torch_utils::read_tensor_record(record);
+  ASSERT_EQ(tensors.size(), rtensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i)
+    {
+      ASSERT_EQ(tensors[i].scalar_type(), rtensors[i].scalar_type());
+      ASSERT_TRUE(torch::equal(tensors[i], rtensors[i]));
+    }
+
+  // legacy torch::save records
+  std::ostringstream stream;
+  torch::save(tensors, stream);
+  ASSERT_FALSE(torch_utils::is_tensor_record(stream.str()));
+  rtensors = torch_utils::read_tensor_record(stream.str());
+  ASSERT_EQ(tensors.size(), rtensors.size());
+  ASSERT_TRUE(torch::equal(tensors[1], rtensors[1]));
+}
+
 TEST(torchapi, load_weights_native_model)
 {
   APIData template_params;
@@ -321,6 +740,53 @@ TEST(torchapi, service_train_images_split)
   fileops::remove_dir(resnet50_train_repo + "test_0.lmdb");
 }
 
+TEST(torchapi, db_prefetch_order)
+{
+  auto logger = DD_SPDLOG_LOGGER("test");
+  std::string dbname = "prefetch_order";
+  int nsamples = 37;
+
+  TorchDataset writer;
+  writer.set_logger(logger);
+  writer.set_db_params(true, "lmdb", dbname);
+  for (int i = 0; i < nsamples; ++i)
+    writer.add_batch({ torch::full({ 3 }, i) }, { torch::full({ 1 }, i) });
+  writer.db_finalize();
+
+  // serial reads, then prefetched reads with the same shuffle seed
+  std::vector<torch::Tensor> datas, targets;
+  for (int workers : { 0, 3 })
+    {
+      TorchDataset dataset;
+      dataset.set_logger(logger);
+      dataset.set_db_file(dbname + ".lmdb");
+      dataset.set_seed(12345);
+      dataset.set_prefetch(workers, 2);
+      dataset.reset(true);
+
+      std::vector<torch::Tensor> bdatas, btargets;
+      c10::optional<TorchBatch> batch;
+      while ((batch = dataset.get_batch({ 5 })))
+        {
+          bdatas.push_back(batch->data.at(0));
+          btargets.push_back(batch->target.at(0));
+        }
+      ASSERT_EQ((nsamples + 4) / 5, bdatas.size());
+      datas.push_back(torch::cat(bdatas));
+      targets.push_back(torch::cat(btargets));
+    }
+
+  // every sample, once, in the same order
+  ASSERT_EQ(nsamples, datas.at(0).size(0));
+  ASSERT_TRUE(torch::equal(std::get<0>(targets.at(0).flatten().sort()),
+                           torch::arange(nsamples, targets.at(0).options())));
+  ASSERT_TRUE(torch::equal(datas.at(0), datas.at(1)));
+  ASSERT_TRUE(torch::equal(targets.at(0), targets.at(1)));
+
+  fileops::clear_directory(dbname + ".lmdb");
+  fileops::remove_dir(dbname + ".lmdb");
+}
+
 TEST(torchapi, service_train_images)
 {
   setenv("CUBLAS_WORKSPACE_CONFIG", ":4096:8", true);
@@ -1097,6 +1563,41 @@ TEST(torchapi, service_train_csvts_nbeats)
   ASSERT_TRUE(jd["body"]["predictions"][0]["series"].Size() == 50);
   ASSERT_TRUE(jd["body"]["predictions"][0]["series"][0]["out"][0].IsDouble());
 
+  // measure from an inference only service on the trained model
+  std::string sname_io = "nbeats_io";
+  jstr = "{\"mllib\":\"torch\",\"description\":\"nbeats\",\"type\":"
+         "\"supervised\",\"model\":{\"repository\":\""
+         + csvts_nbeats_repo
+         + "\"},\"parameters\":{\"input\":{\"connector\":\"csvts\","
+           "\"ignore\":[\"output\"],\"backcast_timesteps\":50,"
+           "\"forecast_timesteps\":50},\"mllib\":{\"template\":\"nbeats\","
+           "\"template_params\":{\"stackdef\":[\"t2\",\"s4\",\"g3\",\"b3\"]},"
+           "\"loss\":\"L1\",\"inference_only\":true}}}";
+  joutstr = japi.jrender(japi.service_create(sname_io, jstr));
+  ASSERT_EQ(created_str, joutstr);
+  jpredictstr
+      = "{\"service\":\"" + sname_io
+        + "\",\"parameters\":{\"input\":{\"backcast_timesteps\":50,\"forecast_"
+          "timesteps\":50,\"connector\":"
+          "\"csvts\",\"scale\":true,\"ignore\":[\"output\"],\"min_vals\":"
+        + str_min_vals + ",\"max_vals\":" + str_max_vals
+        + "},\"output\":{\"measure\":[\"L1\",\"L2\"]}},\"data\":[\""
+        + csvts_test + "\"]}";
+  for (int i = 0; i < 2; ++i)
+    {
+      // the module stays in eval mode between measure calls
+      joutstr = japi.jrender(japi.service_predict(jpredictstr));
+      std::cout << "joutstr=" << joutstr << std::endl;
+      jd.Parse(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_TRUE(jd["body"]["measure"].HasMember("L1_mean_error"));
+      ASSERT_TRUE(jd["body"]["measure"]["L1_mean_error"].GetDouble() >= 0.0);
+    }
+  jstr = "{\"clear\":\"mem\"}";
+  joutstr = japi.jrender(japi.service_delete(sname_io, jstr));
+  ASSERT_EQ(ok_str, joutstr);
+
   //  remove service
   jstr = "{\"clear\":\"full\"}";
   joutstr = japi.jrender(japi.service_delete(sname, jstr));
@@ -1104,6 +1605,146 @@ TEST(torchapi, service_train_csvts_nbeats)
   rmdir(csvts_nbeats_repo.c_str());
 }
 
+TEST(torchapi, service_train_csvts_nbeats_data_parallel)
+{
+  std::string csvts_data = sinus + "train";
+  std::string csvts_test = sinus + "test";
+  std::string csvts_nbeats_repo = "csvts_nbeats_dp";
+
+  // a single worker training, then two identical trainings on 2 CPU
+  // workers
+  std::vector<int> workers = { 1, 2, 2 };
+  std::vector<double> train_losses;
+  for (int nworkers : workers)
+    {
+      torch::manual_seed(torch_seed);
+      at::globalContext().setDeterministic(true);
+      mkdir(csvts_nbeats_repo.c_str(), 0777);
+
+      JsonAPI japi;
+      std::string sname = "nbeats";
+      std::string jstr
+          = "{\"mllib\":\"torch\",\"description\":\"nbeats\",\"type\":"
+            "\"supervised\",\"model\":{\"repository\":\""
+            + csvts_nbeats_repo
+            + "\"},\"parameters\":{\"input\":{\"connector\":\"csvts\","
+              "\"ignore\":[\"output\"],\"backcast_timesteps\":50,"
+              "\"forecast_timesteps\":50},\"mllib\":{\"template\":\"nbeats\","
+              "\"template_params\":{\"stackdef\":[\"t2\",\"s4\",\"g3\","
+              "\"b3\"]},\"loss\":\"L1\"}}}";
+      std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+      ASSERT_EQ(created_str, joutstr);
+
+      std::string jtrainstr
+          = "{\"service\":\"" + sname
+            + "\",\"async\":false,\"parameters\":{\"input\":{\"seed\":12345,"
+              "\"shuffle\":true,\"separator\":\",\",\"scale\":true,"
+              "\"backcast_timesteps\":50,\"forecast_timesteps\":50,"
+              "\"ignore\":[\"output\"]},\"mllib\":{\"gpu\":false,"
+              "\"data_parallel_workers\":"
+            + std::to_string(nworkers) + ",\"solver\":{\"iterations\":"
+            + iterations_nbeats_cpu
+            + ",\"test_interval\":10,\"base_lr\":0.1,\"test_initialization\":"
+              "false,\"solver_type\":\"ADAM\"},\"net\":{\"batch_size\":4,"
+              "\"test_batch_size\":10}},\"output\":{\"measure\":[\"L1\","
+              "\"L2\"]}},\"data\":[\""
+            + csvts_data + "\",\"" + csvts_test + "\"]}";
+      joutstr = japi.jrender(japi.service_train(jtrainstr));
+      std::cout << "joutstr=" << joutstr << std::endl;
+      JDoc jd;
+      jd.Parse(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(201, jd["status"]["code"].GetInt());
+      ASSERT_TRUE(jd["body"]["measure"].HasMember("train_loss"));
+      train_losses.push_back(jd["body"]["measure"]["train_loss"].GetDouble());
+      ASSERT_TRUE(fabs(train_losses.back()) > 0);
+
+      jstr = "{\"clear\":\"full\"}";
+      joutstr = japi.jrender(japi.service_delete(sname, jstr));
+      ASSERT_EQ(ok_str, joutstr);
+      rmdir(csvts_nbeats_repo.c_str());
+    }
+  // data-parallel trainings are reproducible
+  ASSERT_EQ(train_losses.at(1), train_losses.at(2));
+  // and match the single worker one, up to float summation order
+  ASSERT_NEAR(train_losses.at(0), train_losses.at(1),
+              0.05 * fabs(train_losses.at(0)));
+}
+
+TEST(torchapi, service_train_csvts_nbeats_bf16)
+{
+  torch::manual_seed(torch_seed);
+  at::globalContext().setDeterministic(true);
+
+  JsonAPI japi;
+  std::string sname = "nbeats";
+  std::string csvts_data = sinus + "train";
+  std::string csvts_test = sinus + "test";
+  std::string csvts_nbeats_repo = "csvts_nbeats_bf16";
+  mkdir(csvts_nbeats_repo.c_str(), 0777);
+
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"nbeats\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + csvts_nbeats_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"csvts\","
+          "\"ignore\":[\"output\"],\"backcast_timesteps\":50,"
+          "\"forecast_timesteps\":50},\"mllib\":{\"template\":\"nbeats\","
+          "\"datatype\":\"bf16\",\"template_params\":{\"stackdef\":[\"t2\","
+          "\"s4\",\"g3\",\"b3\"]},\"loss\":\"L1\"}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  std::string jtrainstr
+      = "{\"service\":\"" + sname
+        + "\",\"async\":false,\"parameters\":{\"input\":{\"seed\":12345,"
+          "\"shuffle\":true,\"separator\":\",\",\"scale\":true,"
+          "\"backcast_timesteps\":50,\"forecast_timesteps\":50,"
+          "\"ignore\":[\"output\"]},\"mllib\":{\"gpu\":false,\"solver\":{"
+          "\"iterations\":"
+        + iterations_nbeats_cpu
+        + ",\"test_interval\":10,\"base_lr\":0.1,\"test_initialization\":"
+          "false,\"solver_type\":\"ADAM\"},\"net\":{\"batch_size\":2,"
+          "\"test_batch_size\":10}},\"output\":{\"measure\":[\"L1\","
+          "\"L2\"]}},\"data\":[\""
+        + csvts_data + "\",\"" + csvts_test + "\"]}";
+  joutstr = japi.jrender(japi.service_train(jtrainstr));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  JDoc jd;
+  jd.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(201, jd["status"]["code"].GetInt());
+  ASSERT_TRUE(jd["body"]["measure"].HasMember("train_loss"));
+  double train_loss = jd["body"]["measure"]["train_loss"].GetDouble();
+  ASSERT_TRUE(std::isfinite(train_loss));
+  ASSERT_TRUE(fabs(train_loss) > 0);
+  ASSERT_TRUE(jd["body"]["measure"].HasMember("L1_mean_error"));
+
+  // checkpoints are saved in fp32
+  std::string checkpoint = csvts_nbeats_repo + "/checkpoint-"
+                           + iterations_nbeats_cpu + ".npt";
+  ASSERT_TRUE(fileops::file_exists(checkpoint));
+  torch::jit::script::Module weights = torch::jit::load(checkpoint);
+  for (const torch::Tensor &param : weights.parameters())
+    ASSERT_EQ(torch::kFloat32, param.scalar_type());
+
+  // bf16 cannot be combined with int8 quantization
+  jstr = "{\"clear\":\"full\"}";
+  joutstr = japi.jrender(japi.service_delete(sname, jstr));
+  ASSERT_EQ(ok_str, joutstr);
+  mkdir(csvts_nbeats_repo.c_str(), 0777);
+  jstr = "{\"mllib\":\"torch\",\"description\":\"nbeats\",\"type\":"
+         "\"supervised\",\"model\":{\"repository\":\""
+         + csvts_nbeats_repo
+         + "\"},\"parameters\":{\"input\":{\"connector\":\"csvts\"},"
+           "\"mllib\":{\"template\":\"nbeats\",\"datatype\":\"bf16\","
+           "\"quantize\":\"dynamic\"}}}";
+  joutstr = japi.jrender(japi.service_create(sname, jstr));
+  jd.Parse(joutstr.c_str());
+  ASSERT_EQ(400, jd["status"]["code"].GetInt());
+  rmdir(csvts_nbeats_repo.c_str());
+}
+
 TEST(torchapi, service_train_csvts_nbeats_multiple_testsets)
 {
   torch::manual_seed(torch_seed);